@@ -37,6 +37,7 @@
 #include "../utils/utilities.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -308,11 +309,14 @@ compute_phi(struct thread_state *thread_state, long int blocksize)
 	if (state == NULL) {
 		err(18, __func__, "state arg is NULL");
 	}
-	if (state->epsilon == NULL) {
-		err(18, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(18, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(18, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(18, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(18, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (blocksize == 0) {
 		return 0.0;
@@ -366,27 +370,48 @@ compute_phi(struct thread_state *thread_state, long int blocksize)
 	 *
 	 * NOTE: i % n is used to avoid appending blocksize-1 bits in the end (as indicated in the paper)
 	 */
-	for (dec = 0, i = 0; i < n + blocksize; i++) {
+	if (state->byteEpsilon == true) {
+		for (dec = 0, i = 0; i < n + blocksize; i++) {
+
+			/*
+			 * Get the decimal representation of the current block.
+			 * This line of code works by shifting the decimal representation of the
+			 * previous number left by 1 bit, adding to it the following bit of epsilon,
+			 * and then discarding the left-most bit by doing an AND with the mask (in fact,
+			 * the mask is used to keep only the right-most blocksize bits of the number).
+			 */
+			dec = ((dec << 1) + (int) state->epsilon[thread_state->thread_id][i % n]) & mask;
+
+			/*
+			 * If we have already counted the first (blocksize - 1) bits of epsilon,
+			 * count the occurrence of the current block in its corresponding counter.
+			 *
+			 * NOTE: this check is important because during the first (blocksize - 1) iterations
+			 * of this loop, dec will be the decimal representation of blocks of length
+			 * which is smaller than blocksize.
+			 */
+			if (i >= blocksize) {
+				state->apen_C[thread_state->thread_id][dec]++;
+			}
+		}
+	} else {
 
 		/*
-		 * Get the decimal representation of the current block.
-		 * This line of code works by shifting the decimal representation of the
-		 * previous number left by 1 bit, adding to it the following bit of epsilon,
-		 * and then discarding the left-most bit by doing an AND with the mask (in fact,
-		 * the mask is used to keep only the right-most blocksize bits of the number).
+		 * Extract each block that lies within the sequence straight from the packed bit stream
 		 */
-		dec = ((dec << 1) + (int) state->epsilon[thread_state->thread_id][i % n]) & mask;
+		for (i = blocksize; i < n; i++) {
+			dec = (long int) packedBits(state->packedEpsilon[thread_state->thread_id], i - blocksize + 1, (int) blocksize);
+			state->apen_C[thread_state->thread_id][dec]++;
+		}
 
 		/*
-		 * If we have already counted the first (blocksize - 1) bits of epsilon,
-		 * count the occurrence of the current block in its corresponding counter.
-		 *
-		 * NOTE: this check is important because during the first (blocksize - 1) iterations
-		 * of this loop, dec will be the decimal representation of blocks of length
-		 * which is smaller than blocksize.
+		 * Form the last blocksize blocks, that wrap around the end of the sequence, one bit at a time as above
 		 */
-		if (i >= blocksize) {
-			state->apen_C[thread_state->thread_id][dec]++;
+		for (dec = 0, i = n - blocksize + 1; i < n + blocksize; i++) {
+			dec = ((dec << 1) + PACKED_BIT(state->packedEpsilon[thread_state->thread_id], i % n)) & mask;
+			if (i >= n) {
+				state->apen_C[thread_state->thread_id][dec]++;
+			}
 		}
 	}
 
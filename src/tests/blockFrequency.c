@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -197,11 +198,14 @@ BlockFrequency_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(21, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(21, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(21, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(21, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(21, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
 	/*
@@ -219,12 +223,16 @@ BlockFrequency_iterate(struct thread_state *thread_state)
 
 		/*
 		 * Step 2: determine the proportion of ones in each M-bit block
+		 *
+		 * A block need not start or end at a word boundary, countOnes() masks the words at its ends.
 		 */
-		blockSum = 0;
-		for (j = 0; j < M; j++) {
-			if (state->epsilon[thread_state->thread_id][j + i * M]) {
-				blockSum++;
+		if (state->byteEpsilon == true) {
+			blockSum = 0;
+			for (j = 0; j < M; j++) {
+				blockSum += state->epsilon[thread_state->thread_id][j + i * M];
 			}
+		} else {
+			blockSum = countOnes(state->packedEpsilon[thread_state->thread_id], i * M, M);
 		}
 		pi = (double) blockSum / (double) M;
 
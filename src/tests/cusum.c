@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -166,6 +167,7 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 	long int S;			// Variable used to store the forward partial sums
 	long int S_max;			// Maximum forward partial sum
 	long int S_min;			// Minimum forward partial sum
+	struct random_walk walk;	// Walk of the packed bit stream
 	double p_value_forward;		// p_value for forward test
 	double p_value_backward;	// p_value for backward test
 	long int k;
@@ -184,11 +186,14 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(31, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(31, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(31, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(31, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(31, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->cSetup != true) {
 		err(31, __func__, "test constants not setup prior to calling %s for %s[%d]",
@@ -220,10 +225,20 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 	S = 0;
 	S_max = 0;
 	S_min = 0;
-	for (k = 0; k < n; k++) {
-		(state->epsilon[thread_state->thread_id][k] != 0) ? S++ : S--;
-		S_max = MAX(S, S_max);
-		S_min = MIN(S, S_min);
+	if (state->byteEpsilon == true) {
+		for (k = 0; k < n; k++) {
+			(state->epsilon[thread_state->thread_id][k] != 0) ? S++ : S--;
+			S_max = MAX(S, S_max);
+			S_min = MIN(S, S_min);
+		}
+	} else {
+		walk.S = 0;
+		walk.max = 0;
+		walk.min = 0;
+		randomWalk(state->packedEpsilon[thread_state->thread_id], 0, n, &walk);
+		S = walk.S;
+		S_max = walk.max;
+		S_min = walk.min;
 	}
 
 	/*
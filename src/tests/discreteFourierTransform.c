@@ -30,14 +30,17 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <complex.h>
+#include <unistd.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 #if defined(LEGACY_FFT)
 #include "../utils/dfft.h"
@@ -63,12 +66,46 @@ struct DiscreteFourierTransform_private_stats {
  */
 static const enum test test_num = TEST_DFT;	// This test number
 
+/*
+ * +1 and -1 values of the 4 bits of each nibble, most significant bit first, in double and for -D in float
+ */
+static const double nibble_X[16][4] = {
+	{-1.0, -1.0, -1.0, -1.0}, {-1.0, -1.0, -1.0, 1.0}, {-1.0, -1.0, 1.0, -1.0}, {-1.0, -1.0, 1.0, 1.0},
+	{-1.0, 1.0, -1.0, -1.0}, {-1.0, 1.0, -1.0, 1.0}, {-1.0, 1.0, 1.0, -1.0}, {-1.0, 1.0, 1.0, 1.0},
+	{1.0, -1.0, -1.0, -1.0}, {1.0, -1.0, -1.0, 1.0}, {1.0, -1.0, 1.0, -1.0}, {1.0, -1.0, 1.0, 1.0},
+	{1.0, 1.0, -1.0, -1.0}, {1.0, 1.0, -1.0, 1.0}, {1.0, 1.0, 1.0, -1.0}, {1.0, 1.0, 1.0, 1.0},
+};
+#if !defined(LEGACY_FFT)
+static const float nibble_Xf[16][4] = {
+	{-1.0f, -1.0f, -1.0f, -1.0f}, {-1.0f, -1.0f, -1.0f, 1.0f}, {-1.0f, -1.0f, 1.0f, -1.0f}, {-1.0f, -1.0f, 1.0f, 1.0f},
+	{-1.0f, 1.0f, -1.0f, -1.0f}, {-1.0f, 1.0f, -1.0f, 1.0f}, {-1.0f, 1.0f, 1.0f, -1.0f}, {-1.0f, 1.0f, 1.0f, 1.0f},
+	{1.0f, -1.0f, -1.0f, -1.0f}, {1.0f, -1.0f, -1.0f, 1.0f}, {1.0f, -1.0f, 1.0f, -1.0f}, {1.0f, -1.0f, 1.0f, 1.0f},
+	{1.0f, 1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, -1.0f, 1.0f}, {1.0f, 1.0f, 1.0f, -1.0f}, {1.0f, 1.0f, 1.0f, 1.0f},
+};
+#endif /* LEGACY_FFT */
+
 
 /*
  * Static variables declarations
  */
 static double sqrtn4_095_005;			// Square root of (n / 4.0 * 0.95 * 0.05)
 static double sqrt_log20_n;			// Square root of ln(20) * n
+static double peak_bound2;			// Smallest squared magnitude whose sqrt() is not below sqrt_log20_n
+static const double tpi = 6.28318530717958647692528676655900577;	// 2 * pi
+static long int scratch_n1;			// -X: rows of the n / 2 = scratch_n1 * scratch_n2 complex values transformed
+static long int scratch_n2;			// -X: columns of the n / 2 complex values transformed
+static long int scratch_batch;			// -X: rows transformed at a time
+static long int scratch_width;			// -X: column pairs in a full tile of the scratch file
+static size_t scratch_data;			// -X: doubles of fft_X before the transform work space
+#if !defined(LEGACY_FFT)
+static long int batch_count;			// Bit streams each thread transforms together, 1 if each is done alone
+static long int batch_stride;			// Doubles between the bit streams of a batch in fft_X
+static double single_bound;			// -D: bound on the error of a single precision DFT output
+static double single_lo2;			// -D: squared single precision magnitudes below this are below sqrt_log20_n
+static double single_hi2;			// -D: squared single precision magnitudes from this on are not below it
+static long int single_direct_bins;		// -D: most uncertain magnitudes computed one at a time
+static long int single_out_offset;		// -D: floats in fft_X before the single precision output
+#endif /* LEGACY_FFT */
 
 
 /*
@@ -78,6 +115,25 @@ static bool DiscreteFourierTransform_print_stat(FILE * stream, struct state *sta
 						struct DiscreteFourierTransform_private_stats *stat, double p_value);
 static bool DiscreteFourierTransform_print_p_value(FILE * stream, double p_value);
 static void DiscreteFourierTransform_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
+static void DiscreteFourierTransform_X(struct state *state, long int thread_id, double *X);
+static long int DiscreteFourierTransform_peaks(const double *out, long int count);
+static long int DiscreteFourierTransform_team(struct state *state, long int queued);
+static long int DiscreteFourierTransform_N_1(struct state *state, long int thread_id);
+static void DiscreteFourierTransform_record(struct thread_state *thread_state, long int iteration, long int N_1);
+#if !defined(LEGACY_FFT)
+static void DiscreteFourierTransform_batch(struct thread_state *thread_state);
+static void DiscreteFourierTransform_transform(struct thread_state *thread_state, long int finish);
+#endif /* LEGACY_FFT */
+static long int DiscreteFourierTransform_scratch_rows(long int n);
+static void DiscreteFourierTransform_scratch_init(struct state *state);
+static void DiscreteFourierTransform_scratch_io(FILE * stream, bool out, double *buf, long int offset, long int count);
+static void DiscreteFourierTransform_scratch_forward(struct state *state, bool row, double *x, double *work);
+static long int DiscreteFourierTransform_scratch_count(const double *z, const double *mz, long int k2, const double *roots);
+static long int DiscreteFourierTransform_scratch_N_1(struct state *state, long int thread_id);
+#if !defined(LEGACY_FFT)
+static double DiscreteFourierTransform_direct_m(const float *x, const double *roots, long int n, long int k);
+static long int DiscreteFourierTransform_single_N_1(struct state *state, long int thread_id);
+#endif /* LEGACY_FFT */
 
 
 /*
@@ -95,6 +151,20 @@ DiscreteFourierTransform_init(struct state *state)
 {
 	long int n;		// Length of a single bit stream
 	long int i;
+#if !defined(LEGACY_FFT)
+	char *wisdom = NULL;	// FFTW wisdom file, NULL when no wisdom is used
+	char *defaultWisdom = NULL;	// workDir/fftw.wisdom when there is no -W wisdom
+	char *singleWisdom = NULL;	// -D: FFTW wisdom file of the single precision plan
+	unsigned int flags;	// FFTW planner flags
+	size_t len;		// Number of doubles in each fft_X buffer
+	long int team;		// Number of threads sharing a transform
+	double u;		// Unit roundoff of float
+	double eta;		// Bound on the error of one radix-2 butterfly and its twiddle factor
+	double stages;		// Number of radix-2 stages of the transform
+	double angle;		// Angle of a unit root
+	int rank_n;		// n as the transform rank length of fftw_plan_many_dft_r2c()
+	fftw_complex *batch_out;	// Output of the batch plan
+#endif /* LEGACY_FFT */
 
 	/*
 	 * Check preconditions (firewall)
@@ -126,100 +196,1181 @@ DiscreteFourierTransform_init(struct state *state)
 		state->testVector[test_num] = false;
 		return;
 	}
+	if (state->scratchDir != NULL && DiscreteFourierTransform_scratch_rows(n) < 2) {
+		warn(__func__, "-X requires an even bitcount(n) whose half has a factor > 1: %ld, "
+		     "test %s[%d] will be transformed in memory", n, state->testNames[test_num], test_num);
+		free(state->scratchDir);
+		state->scratchDir = NULL;
+	}
+
+	/*
+	 * Create working sub-directory if forming files such as results.txt and stats.txt
+	 */
+	if (state->resultstxtFlag == true) {
+		state->subDir[test_num] = precheckSubdir(state, state->testNames[test_num]);
+		dbg(DBG_HIGH, "test %s[%d] will use subdir: %s", state->testNames[test_num], test_num, state->subDir[test_num]);
+	}
+
+	/*
+	 * Compute constants needed for the test
+	 */
+	sqrtn4_095_005 = sqrt((double) state->tp.n / 4.0 * 0.95 * 0.05);
+	sqrt_log20_n = sqrt(log(20.0) * (double) state->tp.n);	// 2.995732274 * n
+
+	/*
+	 * As sqrt() is correctly rounded, and so monotonic, a magnitude is below sqrt_log20_n exactly
+	 * when its square is below peak_bound2, so the peaks are counted without a sqrt() per output
+	 */
+	peak_bound2 = sqrt_log20_n * sqrt_log20_n;
+	while (sqrt(peak_bound2) >= sqrt_log20_n) {
+		peak_bound2 = nextafter(peak_bound2, 0.0);
+	}
+	while (sqrt(peak_bound2) < sqrt_log20_n) {
+		peak_bound2 = nextafter(peak_bound2, HUGE_VAL);
+	}
+#if !defined(LEGACY_FFT)
+	/*
+	 * The single precision error bound grows like n * log2(n).  At 4096 bits about a third of the bit
+	 * streams have an uncertain magnitude, at 8192 bits most do, and from 16384 bits nearly all, so above
+	 * MAX_LENGTH_SINGLE_FFT bits the single precision transform would only add to the double precision one.
+	 */
+	if (state->singleFFT == true && n > MAX_LENGTH_SINGLE_FFT) {
+		warn(__func__, "-D requires bitcount(n): %ld <= %d, test %s[%d] will be transformed in place in double precision",
+		     n, MAX_LENGTH_SINGLE_FFT, state->testNames[test_num], test_num);
+		state->singleFFT = false;
+		state->inPlaceFFT = true;
+	}
+	if (state->singleFFT == true) {
+		/*
+		 * Bound the error of a single precision DFT output
+		 *
+		 * By Higham, "Accuracy and Stability of Numerical Algorithms", 2nd ed., Theorem 24.2, the
+		 * computed output y of a radix-2 FFT of x satisfies ||y - Fx|| <= ||Fx|| * s * eta / (1 - s * eta),
+		 * with s = log2(n) stages and eta = mu + gamma4 * (sqrt(2) + mu), mu being the error of the
+		 * twiddle factors.  With the +1 and -1 values of x, ||Fx|| = sqrt(n) * ||x|| = n, and no single
+		 * output has a larger error than the whole output.  The bound is doubled to cover the mixed radix
+		 * and odd length algorithms of fftwf.
+		 */
+		u = FLT_EPSILON / 2.0;
+		eta = u + (4.0 * u / (1.0 - 4.0 * u)) * (state->c.sqrt2 + u);
+		stages = ceil(log2((double) n));
+		single_bound = 2.0 * (double) n * stages * eta / (1.0 - stages * eta);
+		single_lo2 = (sqrt_log20_n > single_bound) ?
+			(sqrt_log20_n - single_bound) * (sqrt_log20_n - single_bound) : -1.0;
+		single_hi2 = (sqrt_log20_n + single_bound) * (sqrt_log20_n + single_bound);
+
+		/*
+		 * A direct magnitude costs about 4 * n flops and a double precision transform about 2.5 * n * log2(n)
+		 */
+		single_direct_bins = (long int) (stages * 2.5 / 4.0);
+
+		/*
+		 * The single precision output follows the input, aligned to the 64 bytes fftwf may want.
+		 * The double precision transform of the uncertain bit streams is done in place.
+		 */
+		single_out_offset = (n + 15) / 16 * 16;
+		state->inPlaceFFT = true;
+		dbg(DBG_LOW, "-D single precision DFT outputs are within %f of exact, uncertain within [%f, %f)",
+		    single_bound, (single_lo2 < 0.0) ? 0.0 : sqrt(single_lo2), sqrt(single_hi2));
+
+		/*
+		 * Unit roots exp(-2 * pi * i * k / n) of the direct magnitudes
+		 */
+		state->fft_roots = malloc((size_t) (2 * n) * sizeof(state->fft_roots[0]));
+		if (state->fft_roots == NULL) {
+			errp(40, __func__, "cannot malloc of %ld elements of %ld bytes each for state->fft_roots",
+			     2 * n, sizeof(state->fft_roots[0]));
+		}
+		for (i = 0; i < n; i++) {
+			angle = -tpi * (double) i / (double) n;
+			state->fft_roots[2 * i] = cos(angle);
+			state->fft_roots[2 * i + 1] = sin(angle);
+		}
+	}
+#endif /* LEGACY_FFT */
+
+	/*
+	 * Allocate arrays that will be used by the DFT libraries, for each thread
+	 */
+	state->fft_X = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_X));
+	if (state->fft_X == NULL) {
+		errp(40, __func__, "cannot malloc for fft_X: %ld elements of %ld bytes each", state->numberOfThreads,
+		     sizeof(*state->fft_X));
+	}
+#if defined(LEGACY_FFT)
+	/*
+	 * The factorization and twiddle factors of n are computed once and shared by all threads
+	 */
+	if (state->scratchDir == NULL) {
+		state->fft_plan = dfft_plan_create(n);
+	}
+	state->fft_work = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_work));
+	if (state->fft_work == NULL) {
+		errp(40, __func__, "cannot malloc for fft_work: %ld elements of %ld bytes each", state->numberOfThreads,
+		     sizeof(*state->fft_work));
+	}
+#else /* LEGACY_FFT */
+	state->fftw_out = malloc((size_t) state->numberOfThreads * sizeof(*state->fftw_out));
+	if (state->fftw_out == NULL) {
+		errp(40, __func__, "cannot malloc for fftw_out: %ld elements of %ld bytes each", state->numberOfThreads,
+		     sizeof(*state->fftw_out));
+	}
+
+	/*
+	 * At small bitcounts, each thread transforms up to BATCH_FFT bit streams together with one plan,
+	 * so that many short transforms are not bound by the cost of each call.  A batch holds at most
+	 * BATCH_LENGTH_FFT bits, and no more bit streams than a thread gets.  The bit streams of a batch
+	 * are batch_stride doubles apart, a multiple of 8 that keeps each of them aligned alike.
+	 */
+	batch_count = 1;
+	if (state->scratchDir == NULL && state->singleFFT == false && 2 * n <= BATCH_LENGTH_FFT &&
+	    state->numberOfThreads > 0) {
+		batch_count = MIN(MIN(BATCH_FFT, BATCH_LENGTH_FFT / n),
+				  (state->tp.numOfBitStreams + state->numberOfThreads - 1) / state->numberOfThreads);
+	}
+	if (batch_count > 1) {
+		batch_stride = (2 * (n / 2 + 1) + 7) / 8 * 8;
+		state->fft_batched = calloc((size_t) state->numberOfThreads, sizeof(state->fft_batched[0]));
+		if (state->fft_batched == NULL) {
+			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_batched",
+			     state->numberOfThreads, sizeof(state->fft_batched[0]));
+		}
+		state->fft_iteration = calloc((size_t) (state->numberOfThreads * batch_count), sizeof(state->fft_iteration[0]));
+		if (state->fft_iteration == NULL) {
+			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_iteration",
+			     state->numberOfThreads * batch_count, sizeof(state->fft_iteration[0]));
+		}
+	} else if (state->singleFFT == true) {
+		batch_stride = 2 * (n / 2 + 1) + 8;
+	} else if (state->inPlaceFFT == true) {
+		batch_stride = 2 * (n / 2 + 1);
+	} else {
+		batch_stride = n;
+	}
+#endif /* LEGACY_FFT */
+
+	/*
+	 * With -X, the transform is done in buffers of a bounded size instead of arrays of n values
+	 */
+	if (state->scratchDir != NULL) {
+		DiscreteFourierTransform_scratch_init(state);
+	}
+
+	for (i = 0; i < state->numberOfThreads; i++) {
+		if (state->scratchDir != NULL) {
+#if defined(LEGACY_FFT)
+			state->fft_work[i] = NULL;
+#else /* LEGACY_FFT */
+			state->fftw_out[i] = NULL;
+#endif /* LEGACY_FFT */
+			continue;
+		}
+#if defined(LEGACY_FFT)
+		/*
+		 * dfft_forward() uses 2 more doubles than n to form the last output in place
+		 */
+		state->fft_X[i] = calloc((size_t) (n + 2), sizeof(state->fft_X[i][0]));
+		if (state->fft_X[i] == NULL) {
+			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_X[%ld]",
+			     n + 2, sizeof(state->fft_X[i][0]), i);
+		}
+#else /* LEGACY_FFT */
+		/*
+		 * fftw_alloc_real() aligns every thread's array the way the shared plan expects
+		 *
+		 * With -H, the transform is done in place in fft_X, which needs 2 * (n / 2 + 1) doubles.
+		 * With -D, fft_X also holds the single precision input and output.
+		 */
+		len = (size_t) (batch_stride * batch_count);
+		state->fft_X[i] = fftw_alloc_real(len);
+		if (state->fft_X[i] == NULL) {
+			errp(40, __func__, "cannot fftw_alloc_real of %lu elements of %ld bytes each for state->fft_X[%ld]",
+			     len, sizeof(state->fft_X[i][0]), i);
+		}
+#endif /* LEGACY_FFT */
+#if defined(LEGACY_FFT)
+		state->fft_work[i] = calloc(state->fft_plan->work_len, sizeof(state->fft_work[i][0]));
+		if (state->fft_work[i] == NULL) {
+			errp(40, __func__, "cannot calloc of %lu elements of %ld bytes each for state->fft_work[%ld]",
+			     state->fft_plan->work_len, sizeof(state->fft_work[i][0]), i);
+		}
+#else /* LEGACY_FFT */
+		if (state->inPlaceFFT == true) {
+			state->fftw_out[i] = NULL;
+			continue;
+		}
+		len = (batch_count > 1) ? (size_t) (batch_stride / 2 * batch_count) : (size_t) (n / 2 + 1);
+		state->fftw_out[i] = fftw_alloc_complex(len);
+		if (state->fftw_out[i] == NULL) {
+			errp(40, __func__, "cannot fftw_alloc_complex of %lu elements of %ld bytes each for state->fftw_out[%ld]",
+			     len, sizeof(fftw_complex), i);
+		}
+#endif /* LEGACY_FFT */
+	}
+
+#if !defined(LEGACY_FFT)
+	/*
+	 * When fewer iterations are left than cores, each transform is shared by up to state->fftThreads
+	 * threads, see DiscreteFourierTransform_team().  The FFTW threads must be set up before planning.
+	 */
+	if (state->fftThreads > 1) {
+		if (fftw_init_threads() == 0) {
+			err(40, __func__, "fftw_init_threads failed");
+		}
+	}
+
+	/*
+	 * Load the FFTW wisdom of earlier runs, so that a measured plan need not be measured again
+	 */
+	if (state->wisdomPath != NULL) {
+		wisdom = state->wisdomPath;
+	} else if (state->fftEffort != FFT_ESTIMATE) {
+		defaultWisdom = filePathName(state->workDir, DEFAULT_WISDOM_FILE);
+		wisdom = defaultWisdom;
+	}
+	if (wisdom != NULL) {
+		if (fftw_import_wisdom_from_filename(wisdom) != 0) {
+			dbg(DBG_LOW, "imported FFTW wisdom from %s", wisdom);
+		} else {
+			dbg(DBG_LOW, "no FFTW wisdom could be imported from %s", wisdom);
+		}
+	}
+	if (wisdom != NULL && state->singleFFT == true) {
+		/*
+		 * fftwf keeps its own wisdom, so it is kept in its own file
+		 */
+		singleWisdom = malloc(strlen(wisdom) + sizeof(SINGLE_WISDOM_SUFFIX));
+		if (singleWisdom == NULL) {
+			errp(40, __func__, "cannot malloc %lu bytes for the single precision wisdom path",
+			     strlen(wisdom) + sizeof(SINGLE_WISDOM_SUFFIX));
+		}
+		strcpy(singleWisdom, wisdom);
+		strcat(singleWisdom, SINGLE_WISDOM_SUFFIX);
+		if (fftwf_import_wisdom_from_filename(singleWisdom) != 0) {
+			dbg(DBG_LOW, "imported FFTW single precision wisdom from %s", singleWisdom);
+		} else {
+			dbg(DBG_LOW, "no FFTW single precision wisdom could be imported from %s", singleWisdom);
+		}
+	}
+
+	/*
+	 * Plan the transform once for all threads, for each number of threads that can share it
+	 *
+	 * Each thread executes a plan on its own arrays with fftw_execute_dft_r2c().  As the arrays are
+	 * allocated alike, they have the alignment the plans were made for.  Planning with a measure
+	 * overwrites the arrays, which is harmless before any bit stream is loaded.
+	 */
+	switch (state->fftEffort) {
+	case FFT_MEASURE:
+		flags = FFTW_MEASURE;
+		break;
+	case FFT_PATIENT:
+		flags = FFTW_PATIENT;
+		break;
+	case FFT_EXHAUSTIVE:
+		flags = FFTW_EXHAUSTIVE;
+		break;
+	case FFT_ESTIMATE:
+	default:
+		flags = FFTW_ESTIMATE;
+		break;
+	}
+	if (state->scratchDir != NULL) {
+		/*
+		 * With -X, rows and columns are transformed in place wherever they are in fft_X.
+		 * They are too short to be shared among threads.
+		 */
+		if (state->fftThreads > 1) {
+			fftw_plan_with_nthreads(1);
+		}
+		state->fftw_row_p = fftw_plan_dft_1d((int) scratch_n2, (fftw_complex *) state->fft_X[0],
+						     (fftw_complex *) state->fft_X[0], FFTW_FORWARD, flags | FFTW_UNALIGNED);
+		if (state->fftw_row_p == NULL) {
+			err(40, __func__, "fftw_plan_dft_1d failed for -X rows of %ld values with -E %c", scratch_n2,
+			    (char) state->fftEffort);
+		}
+		state->fftw_col_p = fftw_plan_dft_1d((int) scratch_n1, (fftw_complex *) state->fft_X[0],
+						     (fftw_complex *) state->fft_X[0], FFTW_FORWARD, flags | FFTW_UNALIGNED);
+		if (state->fftw_col_p == NULL) {
+			err(40, __func__, "fftw_plan_dft_1d failed for -X columns of %ld values with -E %c", scratch_n1,
+			    (char) state->fftEffort);
+		}
+	} else {
+		/*
+		 * state->fftw_p[team] is the plan for team threads, NULL when no team of that size occurs
+		 */
+		state->fftw_p = calloc((size_t) (state->fftThreads + 1), sizeof(state->fftw_p[0]));
+		if (state->fftw_p == NULL) {
+			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fftw_p",
+			     state->fftThreads + 1, sizeof(state->fftw_p[0]));
+		}
+		for (team = 1; team <= state->fftThreads; team++) {
+			if (state->fftThreads / (state->fftThreads / team) != team) {
+				continue;
+			}
+			if (state->fftThreads > 1) {
+				fftw_plan_with_nthreads((int) team);
+			}
+			if (state->inPlaceFFT == true) {
+				state->fftw_p[team] = fftw_plan_dft_r2c_1d((int) n, state->fft_X[0],
+									   (fftw_complex *) state->fft_X[0], flags);
+			} else {
+				state->fftw_p[team] = fftw_plan_dft_r2c_1d((int) n, state->fft_X[0], state->fftw_out[0], flags);
+			}
+			if (state->fftw_p[team] == NULL) {
+				err(40, __func__, "fftw_plan_dft_r2c_1d failed for n: %ld with %ld threads and -E %c", n, team,
+				    (char) state->fftEffort);
+			}
+		}
+
+		/*
+		 * A batch is transformed by the thread whose bit streams it holds
+		 */
+		if (batch_count > 1) {
+			if (state->fftThreads > 1) {
+				fftw_plan_with_nthreads(1);
+			}
+			rank_n = (int) n;
+			batch_out = (state->inPlaceFFT == true) ? (fftw_complex *) state->fft_X[0] : state->fftw_out[0];
+			state->fftw_batch_p = fftw_plan_many_dft_r2c(1, &rank_n, (int) batch_count, state->fft_X[0], NULL, 1,
+								     (int) batch_stride, batch_out, NULL, 1,
+								     (int) (batch_stride / 2), flags);
+			if (state->fftw_batch_p == NULL) {
+				err(40, __func__, "fftw_plan_many_dft_r2c failed for %ld transforms of n: %ld with -E %c",
+				    batch_count, n, (char) state->fftEffort);
+			}
+		}
+
+		/*
+		 * The single precision transform is short enough to be done by one thread, so fftwf needs no threads
+		 */
+		if (state->singleFFT == true) {
+			state->fftwf_p = fftwf_plan_dft_r2c_1d((int) n, (float *) state->fft_X[0],
+							       (fftwf_complex *) ((float *) state->fft_X[0] + single_out_offset),
+							       flags);
+			if (state->fftwf_p == NULL) {
+				err(40, __func__, "fftwf_plan_dft_r2c_1d failed for n: %ld with -E %c", n,
+				    (char) state->fftEffort);
+			}
+		}
+	}
+
+	/*
+	 * Save the wisdom of a measured plan for later runs
+	 */
+	if (wisdom != NULL) {
+		if (state->fftEffort != FFT_ESTIMATE) {
+			if (fftw_export_wisdom_to_filename(wisdom) == 0) {
+				warn(__func__, "cannot write FFTW wisdom to %s", wisdom);
+			} else {
+				dbg(DBG_LOW, "saved FFTW wisdom to %s", wisdom);
+			}
+		}
+	}
+	if (singleWisdom != NULL) {
+		if (state->fftEffort != FFT_ESTIMATE) {
+			if (fftwf_export_wisdom_to_filename(singleWisdom) == 0) {
+				warn(__func__, "cannot write FFTW single precision wisdom to %s", singleWisdom);
+			} else {
+				dbg(DBG_LOW, "saved FFTW single precision wisdom to %s", singleWisdom);
+			}
+		}
+		free(singleWisdom);
+		singleWisdom = NULL;
+	}
+	if (defaultWisdom != NULL) {
+		free(defaultWisdom);
+		defaultWisdom = NULL;
+	}
+#endif /* LEGACY_FFT */
+
+	/*
+	 * Allocate dynamic arrays
+	 */
+	if (state->resultstxtFlag == true) {
+		state->stats[test_num] = create_dyn_array(sizeof(struct DiscreteFourierTransform_private_stats),
+							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+	}
+	state->p_val[test_num] = create_dyn_array(sizeof(double),
+						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+
+	/*
+	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
+	 * NOTE: If we are not partitioning the p_values, no data*.txt filenames are needed
+	 */
+	state->datatxt_fmt[test_num] = data_filename_format(state->partitionCount[test_num]);
+	dbg(DBG_HIGH, "%s[%d] will form data*.txt filenames with the following format: %s",
+	    state->testNames[test_num], test_num, state->datatxt_fmt[test_num]);
+
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_X - initialize X with the +1 and -1 values of a bit stream
+ *
+ * given:
+ *      state           // run state to test under
+ *      thread_id       // thread whose bit stream is used
+ *      X               // where to store the n values
+ *
+ * Packed bits are converted a nibble at a time, by copying its 4 values from a table.
+ */
+static void
+DiscreteFourierTransform_X(struct state *state, long int thread_id, double *X)
+{
+	long int n;			// Length of a single bit stream
+	const WORD64 *w;		// Packed bit stream
+	WORD64 word;			// Word of the packed bit stream
+	long int i;
+	int b;
+
+	n = state->tp.n;
+	if (state->byteEpsilon == true) {
+		for (i = 0; i < n; i++) {
+			X[i] = 2 * (int) state->epsilon[thread_id][i] - 1;
+		}
+		return;
+	}
+
+	w = state->packedEpsilon[thread_id];
+	for (i = 0; i + BITS_N_WORD64 <= n; i += BITS_N_WORD64) {
+		word = w[i / BITS_N_WORD64];
+		for (b = 0; b < BITS_N_WORD64; b += 4) {
+			memcpy(&X[i + b], nibble_X[(word >> (BITS_N_WORD64 - 4 - b)) & 0xf], sizeof(nibble_X[0]));
+		}
+	}
+	for (; i < n; i++) {
+		X[i] = 2 * PACKED_BIT(w, i) - 1;
+	}
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_peaks - count the DFT outputs whose magnitude is below sqrt_log20_n
+ *
+ * given:
+ *      out             // DFT outputs, as pairs of real and imaginary parts
+ *      count           // number of outputs
+ *
+ * returns:
+ *      number of outputs whose magnitude is below sqrt_log20_n
+ *
+ * Steps 3 and 6 are done in one pass without a branch, on the squared magnitudes.
+ */
+static long int
+DiscreteFourierTransform_peaks(const double *out, long int count)
+{
+	long int N_1 = 0;		// Observed number of peaks below the threshold
+	long int i;
+
+	for (i = 0; i < count; i++) {
+		N_1 += (out[2 * i] * out[2 * i] + out[2 * i + 1] * out[2 * i + 1] < peak_bound2);
+	}
+	return N_1;
+}
+
+
+/*
+ * DiscreteFourierTransform_team - number of threads to share the transform of an iteration
+ *
+ * given:
+ *      state           // run state to test under
+ *      queued          // bit streams of the caller transformed after this one, one at a time
+ *
+ * returns:
+ *      state->fftThreads divided among the iterations left, at least 1
+ *
+ * The iterations left include those being done and those whose bit streams wait in a batch, so as
+ * iterations run out, the cores of the threads left without a bit stream go to the transforms still
+ * running, while threads that each hold a batch transform it alone.  The queued bit streams of the
+ * caller do not take cores of their own.  The result is one of the team sizes planned for in
+ * DiscreteFourierTransform_init().
+ */
+static long int
+DiscreteFourierTransform_team(struct state *state, long int queued)
+{
+	long int left;		// Number of iterations not completed yet
+
+	left = iterationsLeft(state) - queued;
+	if (left <= 0 || left >= state->fftThreads) {
+		return 1;
+	}
+	return state->fftThreads / left;
+}
+
+
+/*
+ * DiscreteFourierTransform_N_1 - transform a bit stream in double precision and count its peaks
+ *
+ * given:
+ *      state           // run state to test under
+ *      thread_id       // thread whose bit stream and DFT arrays are used
+ *
+ * returns:
+ *      number of the first n / 2 DFT magnitudes that are below sqrt_log20_n
+ */
+static long int
+DiscreteFourierTransform_N_1(struct state *state, long int thread_id)
+{
+	long int n;			// Length of a single bit stream
+	double *X = NULL;		// Adjusted sequence with +1 and -1 bits
+#if defined(LEGACY_FFT)
+	double *out;			// Output of the DFT, as pairs of real and imaginary parts
+#else /* LEGACY_FFT */
+	fftw_complex *out;		// Output of the DFT
+	fftw_plan p;			// Plan of the fastest way to compute the DFT, shared by all threads
+#endif /* LEGACY_FFT */
+
+	n = state->tp.n;
+	X = state->fft_X[thread_id];
+#if !defined(LEGACY_FFT)
+	out = (state->inPlaceFFT == true) ? (fftw_complex *) X : state->fftw_out[thread_id];
+	p = state->fftw_p[DiscreteFourierTransform_team(state, 0)];
+#endif /* LEGACY_FFT */
+
+	/*
+	 * Step 1: initialize X for this iteration
+	 */
+	DiscreteFourierTransform_X(state, thread_id, X);
+
+	/*
+	 * Step 2: apply discrete Fourier transform on X.
+	 *
+	 * Because the input array are purely real numbers (X is an array of +1 and -1),
+	 * the DFT output satisfies the "Hermitian" redundancy.
+	 * As a consequence, both the options (legacy dfft and fttw) save only the first
+	 * (n / 2 + 1) non-redundant values of the DFT output.
+	 */
+#if defined(LEGACY_FFT)
+	/*
+	 * The built-in transform uses the plan made once for n and the work array of this thread.
+	 * It leaves the n / 2 + 1 complex outputs in X or in the work array, as pairs of real and
+	 * imaginary parts.  When fewer iterations are left than cores, the transform is shared by
+	 * the threads left without a bit stream.
+	 */
+	out = dfft_forward(state->fft_plan, X, state->fft_work[thread_id], DiscreteFourierTransform_team(state, 0));
+
+	/*
+	 * Steps 3 and 6: compute the modulus (absolute value) of the first n / 2 elements of the DFT output,
+	 * and count those below the threshold
+	 *
+	 * NOTE: Before the built-in transform replaced FFTPACK, this code took the modulus of the FFTPACK
+	 *	 output [a, b, bI, c, cI, ...] from the pairs (a, b), (bI, c), ... instead of (b, bI), (c, cI), ...
+	 *	 as NIST v2.1.2 did, so the legacy build counted wrong peaks.
+	 */
+	return DiscreteFourierTransform_peaks(out, n / 2);
+#else /* LEGACY_FFT */
+	/*
+	 * The fftw library does the transform out-of-place.
+	 * As a consequence, the computed complex frequencies will be saved in the out array
+	 * of size n / 2 + 1.  With -H, out is X itself and the transform is done in place.
+	 *
+	 * The plan is shared by all threads, so it is executed on the arrays of this thread.
+	 */
+	fftw_execute_dft_r2c(p, X, out);
+
+	/*
+	 * Steps 3 and 6: compute the modulus (absolute value) of the first n / 2 elements of the DFT output,
+	 * and count those below the threshold
+	 */
+	return DiscreteFourierTransform_peaks((const double *) out, n / 2);
+#endif /* LEGACY_FFT */
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_rows - number of rows of the out-of-core transform of -X
+ *
+ * given:
+ *      n               // length of a single bit stream
+ *
+ * returns:
+ *      The largest factor of n / 2 that is not above its square root,
+ *      or a value < 2 if n is odd or n / 2 has no factor > 1, i.e., -X cannot transform n bits
+ */
+static long int
+DiscreteFourierTransform_scratch_rows(long int n)
+{
+	long int h;		// Number of complex values transformed
+	long int rows;
+
+	if ((n % 2) != 0) {
+		return 0;
+	}
+	h = n / 2;
+	for (rows = (long int) sqrt((double) h); rows > 1 && (h % rows) != 0; rows--) {
+	}
+	return rows;
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_init - set up the out-of-core transform of -X
+ *
+ * given:
+ *      state           // run state to test under
+ *
+ * The n / 2 complex values z[j] = x[2 * j] + i * x[2 * j + 1] of the +1 and -1 values x of a bit stream
+ * are transformed by the four step algorithm: as z[j1 + scratch_n1 * j2], they form scratch_n1 rows of
+ * scratch_n2 columns.  Each row is transformed over j2 and multiplied by twiddle factors, and each
+ * column of the result is then transformed over j1, which gives output k2 + scratch_n2 * k1 of the
+ * transform of z in row k1 of column k2.
+ *
+ * The transformed rows are kept in a scratch file of each thread, as tiles of scratch_width column
+ * pairs: column k2 is paired with column scratch_n2 - k2, whose outputs are needed with those of
+ * column k2 to split the transform of z into the transform of x.  So the rows are written, and the
+ * tiles read back, by contiguous stretches of the file, and only fft_X, a buffer of SCRATCH_MEMORY
+ * bytes or the size of a few rows and columns if that is more, is kept in memory for each thread.
+ *
+ * The scratch files are removed as soon as they are open, so that they do not outlive the run.
+ *
+ * This function does not return on error.
+ */
+static void
+DiscreteFourierTransform_scratch_init(struct state *state)
+{
+	long int n;		// Length of a single bit stream
+	long int h;		// Number of complex values transformed
+	long int folds;		// Number of column pairs
+	long int budget;	// Doubles of memory each thread may use
+	long int work = 0;	// Doubles of transform work space
+	size_t len;		// Doubles in each fft_X buffer
+	char name[BUFSIZ + 1];	// Name of a scratch file under scratchDir
+	char *path;		// Path of a scratch file
+	double angle;
+	long int k;
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(40, __func__, "state arg is NULL");
+	}
+	if (state->scratchDir == NULL) {
+		err(40, __func__, "state->scratchDir is NULL");
+	}
+
+	/*
+	 * Split n / 2 into rows and columns as evenly as its factors allow
+	 */
+	n = state->tp.n;
+	h = n / 2;
+	scratch_n1 = DiscreteFourierTransform_scratch_rows(n);
+	if (scratch_n1 < 2) {
+		err(40, __func__, "-X requires an even bitcount(n) whose half has a factor > 1: %ld", n);
+	}
+	scratch_n2 = h / scratch_n1;
+	folds = scratch_n2 / 2 + 1;
+	precheckPath(state, state->scratchDir);
+
+	/*
+	 * Plan the row and column transforms of the built-in transform,
+	 * the fftw plans are made with the others by DiscreteFourierTransform_init()
+	 */
+#if defined(LEGACY_FFT)
+	state->fft_row_plan = dfft_cplan_create(scratch_n2);
+	state->fft_col_plan = dfft_cplan_create(scratch_n1);
+	work = (long int) MAX(state->fft_row_plan->work_len, state->fft_col_plan->work_len);
+#endif /* LEGACY_FFT */
+
+	/*
+	 * Fit as many column pairs in a tile, and as many rows in a batch, as the memory allows
+	 *
+	 * Rows are transformed in a batch of 2 * scratch_batch * scratch_n2 doubles, followed by the part
+	 * of a tile they go to, and a tile of 4 * scratch_n1 * scratch_width doubles is followed by the
+	 * two columns of 2 * scratch_n1 doubles each that are transformed from it.
+	 */
+	budget = SCRATCH_MEMORY / (long int) sizeof(double);
+	scratch_width = (budget - work - 4 * scratch_n1) / (4 * scratch_n1);
+	scratch_width = MAX(1, MIN(scratch_width, folds));
+	scratch_batch = (budget - work) / (2 * scratch_n2 + 4 * scratch_width);
+	scratch_batch = MAX(1, MIN(scratch_batch, scratch_n1));
+	scratch_data = (size_t) MAX(2 * scratch_batch * scratch_n2 + 4 * scratch_batch * scratch_width,
+				    4 * scratch_n1 * scratch_width + 4 * scratch_n1);
+	len = scratch_data + (size_t) work;
+	if (len > (size_t) budget) {
+		warn(__func__, "-X needs %lu bytes per thread for rows of %ld values, more than %ld",
+		     len * sizeof(double), scratch_n2, SCRATCH_MEMORY);
+	}
+	dbg(DBG_LOW, "-X transforms %ld rows of %ld values, %ld rows at a time, and tiles of %ld column pairs",
+	    scratch_n1, scratch_n2, scratch_batch, scratch_width);
+	dbg(DBG_LOW, "-X uses %lu bytes of memory and a scratch file of %ld bytes per thread",
+	    len * sizeof(double), 4 * scratch_n1 * folds * (long int) sizeof(double));
+
+	/*
+	 * Unit roots exp(-2 * pi * i * scratch_n2 * k1 / n) of the output rows
+	 */
+	state->fft_roots = malloc((size_t) (2 * scratch_n1) * sizeof(state->fft_roots[0]));
+	if (state->fft_roots == NULL) {
+		errp(40, __func__, "cannot malloc of %ld elements of %ld bytes each for state->fft_roots",
+		     2 * scratch_n1, sizeof(state->fft_roots[0]));
+	}
+	for (k = 0; k < scratch_n1; k++) {
+		angle = -tpi * (double) k / (double) (2 * scratch_n1);
+		state->fft_roots[2 * k] = cos(angle);
+		state->fft_roots[2 * k + 1] = sin(angle);
+	}
+
+	/*
+	 * Allocate the buffer and open the scratch file of each thread
+	 */
+	state->fft_scratch = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_scratch));
+	if (state->fft_scratch == NULL) {
+		errp(40, __func__, "cannot malloc for fft_scratch: %ld elements of %ld bytes each", state->numberOfThreads,
+		     sizeof(*state->fft_scratch));
+	}
+	for (i = 0; i < state->numberOfThreads; i++) {
+#if defined(LEGACY_FFT)
+		state->fft_X[i] = malloc(len * sizeof(state->fft_X[i][0]));
+		if (state->fft_X[i] == NULL) {
+			errp(40, __func__, "cannot malloc of %lu elements of %ld bytes each for state->fft_X[%ld]",
+			     len, sizeof(state->fft_X[i][0]), i);
+		}
+#else /* LEGACY_FFT */
+		state->fft_X[i] = fftw_alloc_real(len);
+		if (state->fft_X[i] == NULL) {
+			errp(40, __func__, "cannot fftw_alloc_real of %lu elements of %ld bytes each for state->fft_X[%ld]",
+			     len, sizeof(state->fft_X[i][0]), i);
+		}
+#endif /* LEGACY_FFT */
+		snprintf(name, BUFSIZ, "sts_dft.%ld.%ld", (long int) getpid(), i);
+		name[BUFSIZ] = '\0';	// paranoia
+		path = filePathName(state->scratchDir, name);
+		errno = 0;	// paranoia
+		state->fft_scratch[i] = fopen(path, "w+b");
+		if (state->fft_scratch[i] == NULL) {
+			errp(40, __func__, "cannot open -X scratch file %s", path);
+		}
+		if (remove(path) != 0) {
+			warn(__func__, "cannot remove -X scratch file %s, it will remain after the run", path);
+		}
+		dbg(DBG_HIGH, "thread %ld will use -X scratch file %s", i, path);
+		free(path);
+	}
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_io - write or read complex values at an offset in a scratch file
+ *
+ * given:
+ *      stream          // scratch file
+ *      out             // true -> write buf to stream, false -> read buf from stream
+ *      buf             // count complex values, as pairs of doubles
+ *      offset          // offset in stream, in complex values
+ *      count           // number of complex values
+ *
+ * This function does not return on error.
+ */
+static void
+DiscreteFourierTransform_scratch_io(FILE * stream, bool out, double *buf, long int offset, long int count)
+{
+	size_t done;		// Number of complex values written or read
+
+	errno = 0;		// paranoia
+	if (fseek(stream, offset * 2 * (long int) sizeof(double), SEEK_SET) != 0) {
+		errp(41, __func__, "cannot seek to complex value %ld of a -X scratch file", offset);
+	}
+	errno = 0;		// paranoia
+	if (out == true) {
+		done = fwrite(buf, 2 * sizeof(double), (size_t) count, stream);
+	} else {
+		done = fread(buf, 2 * sizeof(double), (size_t) count, stream);
+	}
+	if (done != (size_t) count) {
+		errp(41, __func__, "%s %lu of %ld complex values at %ld of a -X scratch file", (out == true) ? "wrote" : "read",
+		     done, count, offset);
+	}
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_forward - transform a row or a column in place
+ *
+ * given:
+ *      state           // run state to test under
+ *      row             // true -> transform scratch_n2 complex values, false -> scratch_n1 of them
+ *      x               // complex values to transform, as pairs of doubles
+ *      work            // transform work space of the thread
+ */
+static void
+DiscreteFourierTransform_scratch_forward(struct state *state, bool row, double *x, double *work)
+{
+#if defined(LEGACY_FFT)
+	const struct dfft_cplan *plan;	// Plan of the transform
+	double *out;			// Where the transform left its output
+
+	plan = (row == true) ? state->fft_row_plan : state->fft_col_plan;
+	out = dfft_cforward(plan, x, work);
+	if (out != x) {
+		memcpy(x, out, (size_t) (2 * plan->len) * sizeof(x[0]));
+	}
+#else /* LEGACY_FFT */
+	fftw_execute_dft((row == true) ? state->fftw_row_p : state->fftw_col_p, (fftw_complex *) x, (fftw_complex *) x);
+#endif /* LEGACY_FFT */
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_count - count the peaks below the threshold in a transformed column
+ *
+ * given:
+ *      z               // column k2 of the transform Z of the n / 2 complex values z, as pairs of doubles
+ *      mz              // column (scratch_n2 - k2) mod scratch_n2 of Z
+ *      k2              // column index
+ *      roots           // exp(-2 * pi * i * scratch_n2 * k1 / n) for each row k1
+ *
+ * returns:
+ *      number of outputs k = k2 + scratch_n2 * k1 of the transform of the n bits whose magnitude
+ *      is below sqrt_log20_n
+ *
+ * As the built-in transform does, output k of the transform of the bits is E[k] + W[k] * O[k], with
+ * E[k] = (Z[k] + conj(Z[h - k])) / 2, O[k] = (Z[k] - conj(Z[h - k])) / (2 * i) and W[k] = exp(-2 * pi * i * k / n).
+ * Here h - k is in column (scratch_n2 - k2) mod scratch_n2 at row scratch_n1 - 1 - k1, or at row
+ * (scratch_n1 - k1) mod scratch_n1 for k2 = 0.
+ */
+static long int
+DiscreteFourierTransform_scratch_count(const double *z, const double *mz, long int k2, const double *roots)
+{
+	long int n1 = scratch_n1;
+	double ur;		// Real part of exp(-2 * pi * i * k2 / n)
+	double ui;		// Imaginary part of exp(-2 * pi * i * k2 / n)
+	double angle;
+	long int count = 0;	// Number of magnitudes below the threshold
+	long int k1;
+	long int m;		// Row of h - k in mz
+
+	angle = -tpi * (double) k2 / (double) (2 * scratch_n1 * scratch_n2);
+	ur = cos(angle);
+	ui = sin(angle);
+	for (k1 = 0; k1 < n1; k1++) {
+		double zr = z[2 * k1];
+		double zi = z[2 * k1 + 1];
+		double er;	// E[k], then output k
+		double ei;
+		double or;	// O[k]
+		double oi;
+		double wr;	// W[k]
+		double wi;
+
+		m = (k2 == 0) ? (n1 - k1) % n1 : n1 - 1 - k1;
+		er = 0.5 * (zr + mz[2 * m]);
+		ei = 0.5 * (zi - mz[2 * m + 1]);
+		or = 0.5 * (zi + mz[2 * m + 1]);
+		oi = 0.5 * (mz[2 * m] - zr);
+		wr = ur * roots[2 * k1] - ui * roots[2 * k1 + 1];
+		wi = ur * roots[2 * k1 + 1] + ui * roots[2 * k1];
+		er += or * wr - oi * wi;
+		ei += or * wi + oi * wr;
+		count += (er * er + ei * ei < peak_bound2);
+	}
+	return count;
+}
+
+
+/*
+ * DiscreteFourierTransform_scratch_N_1 - transform a bit stream out of core and count its peaks
+ *
+ * given:
+ *      state           // run state to test under
+ *      thread_id       // thread whose bit stream, buffer and scratch file are used
+ *
+ * returns:
+ *      number of the first n / 2 DFT magnitudes that are below sqrt_log20_n
+ *
+ * See DiscreteFourierTransform_scratch_init() for how the transform is done.  The magnitudes are
+ * counted tile by tile, so the spectrum is never held in memory as a whole.
+ */
+static long int
+DiscreteFourierTransform_scratch_N_1(struct state *state, long int thread_id)
+{
+#   define SCRATCH_RESEED (64)		// Twiddle factors between exact ones
+	long int n1 = scratch_n1;
+	long int n2 = scratch_n2;
+	long int folds;			// Number of column pairs
+	double *buf;			// Buffer of this thread
+	double *work;			// Transform work space, after the data in buf
+	double *row;			// Row being transformed
+	double *stage;			// Part of a tile from the rows of a batch
+	double *c0;			// Column k2
+	double *c1;			// Column scratch_n2 - k2
+	FILE *scratch;			// Scratch file of this thread
+	const WORD64 *w;		// Packed bit stream
+	const BitSequence *e;		// Byte per bit bit stream of -B
+	long int N_1 = 0;		// Observed number of peaks below the threshold
+	long int r0;			// First row of a batch
+	long int rows;			// Rows in a batch
+	long int f0;			// First column pair of a tile
+	long int pairs;			// Column pairs in a tile
+	long int bit;			// Bit of z[r0 + n1 * j2]
+	double wr;			// Real part of a twiddle factor
+	double wi;			// Imaginary part of a twiddle factor
+	double sr;			// Real part of the twiddle factor step
+	double si;			// Imaginary part of the twiddle factor step
+	double t;
+	long int j1;
+	long int j2;
+	long int k2;
+	long int b;
+	long int f;
+
+	folds = n2 / 2 + 1;
+	buf = state->fft_X[thread_id];
+	work = buf + scratch_data;
+	scratch = state->fft_scratch[thread_id];
+	w = state->packedEpsilon[thread_id];
+	e = (state->byteEpsilon == true) ? state->epsilon[thread_id] : NULL;
+
+	/*
+	 * Transform the rows a batch at a time
+	 */
+	for (r0 = 0; r0 < n1; r0 += scratch_batch) {
+		rows = MIN(scratch_batch, n1 - r0);
+		stage = buf + 2 * rows * n2;
+
+		/*
+		 * Step 1 for the rows of the batch: z[j1 + n1 * j2] = x[2 * j] + i * x[2 * j + 1]
+		 */
+		for (j2 = 0; j2 < n2; j2++) {
+			bit = 2 * (r0 + n1 * j2);
+			if (e != NULL) {
+				for (b = 0; b < rows; b++) {
+					buf[2 * (b * n2 + j2)] = 2 * (int) e[bit + 2 * b] - 1;
+					buf[2 * (b * n2 + j2) + 1] = 2 * (int) e[bit + 2 * b + 1] - 1;
+				}
+			} else {
+				for (b = 0; b < rows; b++) {
+					buf[2 * (b * n2 + j2)] = 2 * (int) PACKED_BIT(w, bit + 2 * b) - 1;
+					buf[2 * (b * n2 + j2) + 1] = 2 * (int) PACKED_BIT(w, bit + 2 * b + 1) - 1;
+				}
+			}
+		}
+
+		/*
+		 * Transform each row and multiply its output k2 by exp(-2 * pi * i * j1 * k2 / (n / 2))
+		 *
+		 * The twiddle factor is advanced by a complex multiplication and recomputed from cos()
+		 * and sin() every SCRATCH_RESEED outputs, so its rounding errors cannot build up.
+		 */
+		for (b = 0; b < rows; b++) {
+			row = buf + 2 * b * n2;
+			j1 = r0 + b;
+			DiscreteFourierTransform_scratch_forward(state, true, row, work);
+			if (j1 == 0) {
+				continue;
+			}
+			sr = cos(-tpi * (double) j1 / (double) (n1 * n2));
+			si = sin(-tpi * (double) j1 / (double) (n1 * n2));
+			wr = 1.0;
+			wi = 0.0;
+			for (k2 = 0; k2 < n2; k2++) {
+				if ((k2 % SCRATCH_RESEED) == 0) {
+					wr = cos(-tpi * (double) (j1 * k2) / (double) (n1 * n2));
+					wi = sin(-tpi * (double) (j1 * k2) / (double) (n1 * n2));
+				}
+				t = row[2 * k2] * wr - row[2 * k2 + 1] * wi;
+				row[2 * k2 + 1] = row[2 * k2] * wi + row[2 * k2 + 1] * wr;
+				row[2 * k2] = t;
+				t = wr * sr - wi * si;
+				wi = wr * si + wi * sr;
+				wr = t;
+			}
+		}
+
+		/*
+		 * Write the rows of the batch to each tile, column k2 next to column (n2 - k2) mod n2
+		 */
+		for (f0 = 0; f0 < folds; f0 += scratch_width) {
+			pairs = MIN(scratch_width, folds - f0);
+			for (b = 0; b < rows; b++) {
+				row = buf + 2 * b * n2;
+				for (f = 0; f < pairs; f++) {
+					k2 = f0 + f;
+					stage[4 * (b * pairs + f)] = row[2 * k2];
+					stage[4 * (b * pairs + f) + 1] = row[2 * k2 + 1];
+					k2 = (n2 - k2) % n2;
+					stage[4 * (b * pairs + f) + 2] = row[2 * k2];
+					stage[4 * (b * pairs + f) + 3] = row[2 * k2 + 1];
+				}
+			}
+			DiscreteFourierTransform_scratch_io(scratch, true, stage, 2 * n1 * f0 + 2 * r0 * pairs, 2 * rows * pairs);
+		}
+	}
+
+	/*
+	 * Steps 2, 3 and 6 for the columns: transform the column pairs of each tile and count their peaks
+	 */
+	c0 = buf + 4 * n1 * scratch_width;
+	c1 = c0 + 2 * n1;
+	for (f0 = 0; f0 < folds; f0 += scratch_width) {
+		pairs = MIN(scratch_width, folds - f0);
+		DiscreteFourierTransform_scratch_io(scratch, false, buf, 2 * n1 * f0, 2 * n1 * pairs);
+		for (f = 0; f < pairs; f++) {
+			k2 = f0 + f;
+			for (j1 = 0; j1 < n1; j1++) {
+				c0[2 * j1] = buf[4 * (j1 * pairs + f)];
+				c0[2 * j1 + 1] = buf[4 * (j1 * pairs + f) + 1];
+			}
+			DiscreteFourierTransform_scratch_forward(state, false, c0, work);
+
+			/*
+			 * Columns 0 and n2 / 2 are paired with themselves
+			 */
+			if (k2 == 0 || 2 * k2 == n2) {
+				N_1 += DiscreteFourierTransform_scratch_count(c0, c0, k2, state->fft_roots);
+				continue;
+			}
+			for (j1 = 0; j1 < n1; j1++) {
+				c1[2 * j1] = buf[4 * (j1 * pairs + f) + 2];
+				c1[2 * j1 + 1] = buf[4 * (j1 * pairs + f) + 3];
+			}
+			DiscreteFourierTransform_scratch_forward(state, false, c1, work);
+			N_1 += DiscreteFourierTransform_scratch_count(c0, c1, k2, state->fft_roots);
+			N_1 += DiscreteFourierTransform_scratch_count(c1, c0, n2 - k2, state->fft_roots);
+		}
+	}
+	return N_1;
+#   undef SCRATCH_RESEED
+}
 
-	/*
-	 * Create working sub-directory if forming files such as results.txt and stats.txt
-	 */
-	if (state->resultstxtFlag == true) {
-		state->subDir[test_num] = precheckSubdir(state, state->testNames[test_num]);
-		dbg(DBG_HIGH, "test %s[%d] will use subdir: %s", state->testNames[test_num], test_num, state->subDir[test_num]);
+
+#if !defined(LEGACY_FFT)
+/*
+ * DiscreteFourierTransform_direct_m - compute one DFT magnitude of a bit stream directly in double precision
+ *
+ * given:
+ *      x               // bit stream as +1 and -1 values
+ *      roots           // unit roots exp(-2 * pi * i * j / n), as pairs of real and imaginary parts
+ *      n               // length of the bit stream
+ *      k               // index of the DFT output whose magnitude is computed
+ *
+ * returns:
+ *      |sum over j of x[j] * exp(-2 * pi * i * j * k / n)|
+ *
+ * The unit root of each bit is looked up at (j * k) mod n, so the sum has no branch on the bits
+ * and its rounding errors do not build up from one bit to the next.
+ */
+static double
+DiscreteFourierTransform_direct_m(const float *x, const double *roots, long int n, long int k)
+{
+	double re = 0.0;		// Real part of the sum
+	double im = 0.0;		// Imaginary part of the sum
+	long int phase = 0;		// (j * k) mod n
+	long int j;
+
+	for (j = 0; j < n; j++) {
+		re += (double) x[j] * roots[2 * phase];
+		im += (double) x[j] * roots[2 * phase + 1];
+		phase += k;
+		phase = (phase >= n) ? phase - n : phase;
 	}
+	return sqrt(re * re + im * im);
+}
 
-	/*
-	 * Compute constants needed for the test
-	 */
-	sqrtn4_095_005 = sqrt((double) state->tp.n / 4.0 * 0.95 * 0.05);
-	sqrt_log20_n = sqrt(log(20.0) * (double) state->tp.n);	// 2.995732274 * n
+
+/*
+ * DiscreteFourierTransform_single_N_1 - count the peaks of a bit stream from a single precision transform
+ *
+ * given:
+ *      state           // run state to test under
+ *      thread_id       // thread whose bit stream and DFT buffer are used
+ *
+ * returns:
+ *      number of the first n / 2 DFT magnitudes that are below sqrt_log20_n
+ *
+ * The bit stream is transformed with fftwf.  A magnitude that is more than single_bound away from
+ * sqrt_log20_n is on the same side of it as the exact magnitude, so it is counted as is.  The few
+ * magnitudes closer than that are computed again in double precision, one at a time when there are
+ * at most single_direct_bins of them, else by transforming the whole bit stream in double precision.
+ *
+ * Both transforms use the fft_X buffer of the thread: the float input is followed by the float
+ * output, and the double transform is done in place.
+ */
+static long int
+DiscreteFourierTransform_single_N_1(struct state *state, long int thread_id)
+{
+	long int n;			// Length of a single bit stream
+	float *Xf;			// Adjusted sequence with +1 and -1 bits, in single precision
+	fftwf_complex *outf;		// Output of the single precision DFT
+	double *X;			// Adjusted sequence with +1 and -1 bits, in double precision
+	fftw_complex *out;		// Output of the double precision DFT, in place of X
+	const WORD64 *w;		// Packed bit stream
+	double m2;			// Squared magnitude of a single precision DFT output
+	long int N_1 = 0;		// Observed number of peaks below the threshold
+	long int uncertain = 0;		// Number of magnitudes too close to the threshold to count in single precision
+	WORD64 word;			// Word of the packed bit stream
+	long int i;
+	int b;
+
+	n = state->tp.n;
+	X = state->fft_X[thread_id];
+	out = (fftw_complex *) X;
+	Xf = (float *) X;
+	outf = (fftwf_complex *) (Xf + single_out_offset);
+	w = state->packedEpsilon[thread_id];
 
 	/*
-	 * Allocate arrays that will be used by the DFT libraries, for each thread
+	 * Steps 1 and 2 in single precision: the +1 and -1 values are exact in float
 	 */
-	state->fft_X = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_X));
-	if (state->fft_X == NULL) {
-		errp(40, __func__, "cannot malloc for fft_X: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->fft_X));
-	}
-#if defined(LEGACY_FFT)
-	state->fft_wsave = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_wsave));
-	if (state->fft_wsave == NULL) {
-		errp(40, __func__, "cannot malloc for fft_wsave: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->fft_wsave));
-	}
-#else /* LEGACY_FFT */
-	state->fftw_out = malloc((size_t) state->numberOfThreads * sizeof(*state->fftw_out));
-	if (state->fftw_out == NULL) {
-		errp(40, __func__, "cannot malloc for fftw_out: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->fftw_out));
-	}
-	state->fftw_p = malloc((size_t) state->numberOfThreads * sizeof(*state->fftw_p));
-	if (state->fftw_p == NULL) {
-		errp(40, __func__, "cannot malloc for fftw_p: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->fftw_p));
-	}
-#endif /* LEGACY_FFT */
-	state->fft_m = malloc((size_t) state->numberOfThreads * sizeof(*state->fft_m));
-	if (state->fft_m == NULL) {
-		errp(40, __func__, "cannot malloc for fft_m: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->fft_m));
-	}
-
-	for (i = 0; i < state->numberOfThreads; i++) {
-		state->fft_X[i] = calloc((size_t) state->tp.n, sizeof(state->fft_X[i][0]));
-		if (state->fft_X[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_X[%ld]",
-			     n, sizeof(state->fft_X[i][0]), i);
+	if (state->byteEpsilon == true) {
+		for (i = 0; i < n; i++) {
+			Xf[i] = (float) (2 * (int) state->epsilon[thread_id][i] - 1);
 		}
-#if defined(LEGACY_FFT)
-		state->fft_wsave[i] = calloc((size_t) 2 * state->tp.n, sizeof(state->fft_wsave[i][0]));
-		if (state->fft_wsave[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_wsave[%ld]",
-			     2 * n, sizeof(state->fft_wsave[i][0]), i);
-		}
-#else /* LEGACY_FFT */
-		state->fftw_out[i] = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1));
-		if (state->fftw_out[i] == NULL) {
-			errp(40, __func__, "cannot fftw_malloc of %ld elements of %ld bytes each for state->fftw_out[%ld]",
-			     n / 2 + 1, sizeof(fftw_complex), i);
+	} else {
+		for (i = 0; i + BITS_N_WORD64 <= n; i += BITS_N_WORD64) {
+			word = w[i / BITS_N_WORD64];
+			for (b = 0; b < BITS_N_WORD64; b += 4) {
+				memcpy(&Xf[i + b], nibble_Xf[(word >> (BITS_N_WORD64 - 4 - b)) & 0xf], sizeof(nibble_Xf[0]));
+			}
 		}
-		state->fftw_p[i] = fftw_plan_dft_r2c_1d((int) n, state->fft_X[i], state->fftw_out[i], FFTW_ESTIMATE);
-#endif /* LEGACY_FFT */
-		state->fft_m[i] = calloc((size_t) (n / 2 + 1), sizeof(state->fft_m[i][0]));
-		if (state->fft_m[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_m[%ld]",
-			     n / 2 + 1, sizeof(state->fft_m[i][0]), i);
+		for (; i < n; i++) {
+			Xf[i] = (float) (2 * PACKED_BIT(w, i) - 1);
 		}
 	}
+	fftwf_execute_dft_r2c(state->fftwf_p, Xf, outf);
 
 	/*
-	 * Allocate dynamic arrays
+	 * Steps 3 and 6 on squared magnitudes: the products of floats are exact in double
 	 */
-	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct DiscreteFourierTransform_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+	for (i = 0; i < n / 2; i++) {
+		m2 = (double) crealf(outf[i]) * (double) crealf(outf[i]) + (double) cimagf(outf[i]) * (double) cimagf(outf[i]);
+		N_1 += (m2 < single_lo2);
+		uncertain += (m2 >= single_lo2) & (m2 < single_hi2);
+	}
+	if (uncertain == 0) {
+		return N_1;
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
 
 	/*
-	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
-	 * NOTE: If we are not partitioning the p_values, no data*.txt filenames are needed
+	 * Decide the few uncertain magnitudes one at a time, from the input that fftwf left as it was
 	 */
-	state->datatxt_fmt[test_num] = data_filename_format(state->partitionCount[test_num]);
-	dbg(DBG_HIGH, "%s[%d] will form data*.txt filenames with the following format: %s",
-	    state->testNames[test_num], test_num, state->datatxt_fmt[test_num]);
+	if (uncertain <= single_direct_bins) {
+		for (i = 0; i < n / 2; i++) {
+			m2 = (double) crealf(outf[i]) * (double) crealf(outf[i]) +
+			     (double) cimagf(outf[i]) * (double) cimagf(outf[i]);
+			if (m2 >= single_lo2 && m2 < single_hi2 &&
+			    DiscreteFourierTransform_direct_m(Xf, state->fft_roots, n, i) < sqrt_log20_n) {
+				N_1++;
+			}
+		}
+		return N_1;
+	}
 
-	return;
+	/*
+	 * Too many uncertain magnitudes: transform the bit stream again in double precision
+	 */
+	dbg(DBG_HIGH, "%ld single precision magnitudes are uncertain, transforming again in double precision", uncertain);
+	DiscreteFourierTransform_X(state, thread_id, X);
+	fftw_execute_dft_r2c(state->fftw_p[DiscreteFourierTransform_team(state, 0)], X, out);
+	return DiscreteFourierTransform_peaks((const double *) out, n / 2);
 }
+#endif /* LEGACY_FFT */
 
 
 /*
@@ -235,19 +1386,7 @@ DiscreteFourierTransform_init(struct state *state)
 void
 DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 {
-	struct DiscreteFourierTransform_private_stats stat;	// Stats for this iteration
-	long int n;			// Length of a single bit stream
-	double p_value;			// p_value iteration test result(s)
-	double *X = NULL;		// Adjusted sequence with +1 and -1 bits
-	double *m = NULL;		// Magnitude of the DFT
-	long int i;
-#if defined(LEGACY_FFT)
-	double *wsave = NULL;		// Work array used by __ogg_fdrffti() and __ogg_fdrfftf()
-	long ifac[WORK_ARRAY_LEN + 1];	// work array used by __ogg_fdrffti() and __ogg_fdrfftf()
-#else /* LEGACY_FFT */
-	fftw_complex *out;		// Output of the DFT
-	fftw_plan p;			// Information on the fastest way to compute the DFT on this machine
-#endif /* LEGACY_FFT */
+	long int N_1;			// Number of peaks below the threshold
 
 	/*
 	 * Check preconditions (firewall)
@@ -263,11 +1402,14 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(41, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(41, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(41, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(41, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(41, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->fft_X == NULL) {
 		err(41, __func__, "state->fft_X is NULL");
@@ -275,124 +1417,97 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 	if (state->fft_X[thread_state->thread_id] == NULL) {
 		err(41, __func__, "state->fft_X[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->fft_m == NULL) {
-		err(41, __func__, "state->fft_m is NULL");
-	}
-	if (state->fft_m[thread_state->thread_id] == NULL) {
-		err(41, __func__, "state->fft_m[%ld] is NULL", thread_state->thread_id);
+	if (state->scratchDir != NULL && (state->fft_scratch == NULL || state->fft_scratch[thread_state->thread_id] == NULL)) {
+		err(41, __func__, "-X was given but state->fft_scratch[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->cSetup != true) {
 		err(41, __func__, "test constants not setup prior to calling %s for %s[%d]",
 		    __func__, state->testNames[test_num], test_num);
 	}
 #if defined(LEGACY_FFT)
-	if (state->fft_wsave == NULL) {
-		err(41, __func__, "state->fft_wsave is NULL");
+	if (state->scratchDir == NULL && state->fft_plan == NULL) {
+		err(41, __func__, "state->fft_plan is NULL");
+	}
+	if (state->fft_work == NULL) {
+		err(41, __func__, "state->fft_work is NULL");
+	}
+	if (state->scratchDir == NULL && state->fft_work[thread_state->thread_id] == NULL) {
+		err(41, __func__, "state->fft_work[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->fft_wsave[thread_state->thread_id] == NULL) {
-		err(41, __func__, "state->fft_wsave[%ld] is NULL", thread_state->thread_id);
+	if (state->scratchDir != NULL && (state->fft_row_plan == NULL || state->fft_col_plan == NULL)) {
+		err(41, __func__, "-X was given but state->fft_row_plan or state->fft_col_plan is NULL");
 	}
 #else
 	if (state->fftw_out == NULL) {
 		err(41, __func__, "state->fftw_out is NULL");
 	}
-	if (state->fftw_out[thread_state->thread_id] == NULL) {
+	if (state->inPlaceFFT == false && state->scratchDir == NULL && state->fftw_out[thread_state->thread_id] == NULL) {
 		err(41, __func__, "state->fftw_out[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->fftw_p == NULL) {
-		err(41, __func__, "state->fftw_p is NULL");
+	if (state->scratchDir == NULL && (state->fftw_p == NULL || state->fftw_p[1] == NULL)) {
+		err(41, __func__, "state->fftw_p or state->fftw_p[1] is NULL");
 	}
-	if (state->fftw_p[thread_state->thread_id] == NULL) {
-		err(41, __func__, "state->fftw_p[%ld] is NULL", thread_state->thread_id);
+	if (state->scratchDir != NULL && (state->fftw_row_p == NULL || state->fftw_col_p == NULL)) {
+		err(41, __func__, "-X was given but state->fftw_row_p or state->fftw_col_p is NULL");
 	}
 #endif /* LEGACY_FFT */
 
-	/*
-	 * Collect parameters from state
-	 */
-	n = state->tp.n;
-	X = state->fft_X[thread_state->thread_id];
-#if defined(LEGACY_FFT)
-	wsave = state->fft_wsave[thread_state->thread_id];
-#else /* LEGACY_FFT */
-	out = state->fftw_out[thread_state->thread_id];
-	p = state->fftw_p[thread_state->thread_id];
-#endif /* LEGACY_FFT */
-	m = state->fft_m[thread_state->thread_id];
+#if !defined(LEGACY_FFT)
+	if (state->singleFFT == true && (state->fftwf_p == NULL || state->fft_roots == NULL)) {
+		err(41, __func__, "-D was given but state->fftwf_p or state->fft_roots is NULL");
+	}
+	if (batch_count > 1 && (state->fftw_batch_p == NULL || state->fft_batched == NULL || state->fft_iteration == NULL)) {
+		err(41, __func__, "state->fftw_batch_p, state->fft_batched or state->fft_iteration is NULL");
+	}
 
 	/*
-	 * Step 1: initialize X for this iteration
+	 * At small bitcounts, the bit stream waits in fft_X to be transformed with the next ones
 	 */
-	for (i = 0; i < n; i++) {
-		if ((int) state->epsilon[thread_state->thread_id][i] == 1) {
-			X[i] = 1;
-		} else if ((int) state->epsilon[thread_state->thread_id][i] == 0) {
-			X[i] = -1;
-		} else {
-			err(41, __func__, "found a bit different than 1 or 0 in the sequence");
-		}
+	if (batch_count > 1) {
+		DiscreteFourierTransform_batch(thread_state);
+		return;
 	}
+#endif /* LEGACY_FFT */
 
 	/*
-	 * Step 2: apply discrete Fourier transform on X.
-	 *
-	 * Because the input array are purely real numbers (X is an array of +1 and -1),
-	 * the DFT output satisfies the "Hermitian" redundancy.
-	 * As a consequence, both the options (legacy dfft and fttw) save only the first
-	 * (n / 2 + 1) non-redundant values of the DFT output.
-	 */
-#if defined(LEGACY_FFT)
-	/*
-	 * The dfft (legacy option) does the transform in-place.
-	 * As a consequence, the values of X will be replaces with frequencies.
-	 *
-	 * After the function returns, X will look like (saying that values followed by I are the imaginary parts):
-	 * 	[a, b, bI, c, cI, ..., l, lI] when n is odd
-	 *	[a, b, bI, c, cI, ..., l, lI, m] when n is even
-	 */
-	__ogg_fdrffti(n, wsave, ifac);
-	__ogg_fdrfftf(n, X, wsave, ifac);
-#else /* LEGACY_FFT */
-	/*
-	 * The fftw library does the transform out-of-place.
-	 * As a consequence, the computed complex frequencies will be saved in the out array
-	 * of size n / 2 + 1.
+	 * Steps 1 thru 3 and 6: transform the bit stream and count the peaks below the threshold
 	 */
-	fftw_execute(p);
+	if (state->scratchDir != NULL) {
+		N_1 = DiscreteFourierTransform_scratch_N_1(state, thread_state->thread_id);
+#if !defined(LEGACY_FFT)
+	} else if (state->singleFFT == true) {
+		N_1 = DiscreteFourierTransform_single_N_1(state, thread_state->thread_id);
 #endif /* LEGACY_FFT */
+	} else {
+		N_1 = DiscreteFourierTransform_N_1(state, thread_state->thread_id);
+	}
+	DiscreteFourierTransform_record(thread_state, thread_state->iteration_being_done, N_1);
 
-#if defined(LEGACY_FFT)
-	/*
-	 * Step 3a: compute modulus (absolute value) of the first element of the DFT output.
-	 * This first element is always real, and has no imaginary part.
-	 */
-	m[0] = fabs(X[0]);
+	return;
+}
 
-	/*
-	 * Step 3b: compute the modulus of the following n/2 elements of the DFT output.
-	 * These elements are always complex, so we have to consider both real and imaginary value.
-	 */
-	long int j;
-	for (i = 0, j = 1; i < n - 1; i += 2, j++) {
-		m[j] = sqrt((X[i] * X[i]) + (X[i + 1] * X[i + 1]));
-	}
+
+/*
+ * DiscreteFourierTransform_record - compute and record the result of an iteration from its peak count
+ *
+ * given:
+ *      thread_state    // thread that transformed the bit stream
+ *      iteration       // iteration of the bit stream
+ *      N_1             // number of the first n / 2 DFT magnitudes that are below sqrt_log20_n
+ */
+static void
+DiscreteFourierTransform_record(struct thread_state *thread_state, long int iteration, long int N_1)
+{
+	struct state *state = thread_state->global_state;
+	struct DiscreteFourierTransform_private_stats stat;	// Stats for this iteration
+	long int n;			// Length of a single bit stream
+	double p_value;			// p_value iteration test result(s)
 
 	/*
-	 * Step 3c: if n is even, consider the remaining additional element at the end of the DFT output.
-	 * This last element is always real, and has no imaginary part.
-	 */
-	if ((n % 2) == 0) {
-		m[i+1] = fabs(X[n-1]);
-	}
-#else /* LEGACY_FFT */
-	/*
-	 * Step 3: compute modulus (absolute value) of the first (n / 2 + 1) elements (in our case
-	 * all the ones that we have) of the DFT output.
+	 * Collect parameters from state
 	 */
-	for (i = 0; i < n / 2 + 1; i++) {
-		m[i] = cabs(out[i]);
-	}
-#endif /* LEGACY_FFT */
+	n = state->tp.n;
+	stat.N_1 = N_1;
 
 	/*
 	 * Step 5: compute N0
@@ -400,16 +1515,6 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 	 */
 	stat.N_0 = (double) 0.95 * n / 2.0;
 
-	/*
-	 * Step 6: compute N1
-	 */
-	stat.N_1 = 0;
-	for (i = 0; i < n / 2; i++) {
-		if (m[i] < sqrt_log20_n) {
-			stat.N_1++;
-		}
-	}
-
 	/*
 	 * Step 7: compute the test statistic
 	 */
@@ -436,12 +1541,12 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 		state->failure[test_num]++;	// Bogus p_value < 0.0 treated as a failure
 		stat.success = false;		// FAILURE
 		warn(__func__, "iteration %ld of test %s[%d] produced bogus p_value: %f < 0.0\n",
-		     thread_state->iteration_being_done + 1, state->testNames[test_num], test_num, p_value);
+		     iteration + 1, state->testNames[test_num], test_num, p_value);
 	} else if (isGreaterThanOne(p_value)) {
 		state->failure[test_num]++;	// Bogus p_value > 1.0 treated as a failure
 		stat.success = false;		// FAILURE
 		warn(__func__, "iteration %ld of test %s[%d] produced bogus p_value: %f > 1.0\n",
-		     thread_state->iteration_being_done + 1, state->testNames[test_num], test_num, p_value);
+		     iteration + 1, state->testNames[test_num], test_num, p_value);
 	} else if (p_value < state->tp.alpha) {
 		state->valid_p_val[test_num]++;	// Valid p_value in [0.0, 1.0] range
 		state->failure[test_num]++;	// Valid p_value but too low is a failure
@@ -471,6 +1576,137 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 }
 
 
+/*
+ * DiscreteFourierTransform_flush - transform the bit streams waiting in the batch of a thread
+ *
+ * given:
+ *      thread_state    // thread whose batch is transformed
+ *
+ * This function is called when the thread has no more bit streams, so a partial batch is not left
+ * behind.  The iterations of the batch are finished once their results are recorded.
+ */
+void
+DiscreteFourierTransform_flush(struct thread_state *thread_state)
+{
+#if !defined(LEGACY_FFT)
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(48, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(48, __func__, "state arg is NULL");
+	}
+	if (state->testVector[test_num] != true) {
+		dbg(DBG_LOW, "flush function[%d] %s called when test vector was false", test_num, __func__);
+		return;
+	}
+	if (batch_count <= 1) {
+		return;
+	}
+	if (state->fft_batched == NULL || state->fft_iteration == NULL || state->fftw_batch_p == NULL) {
+		err(48, __func__, "state->fft_batched, state->fft_iteration or state->fftw_batch_p is NULL");
+	}
+	DiscreteFourierTransform_transform(thread_state, state->fft_batched[thread_state->thread_id]);
+#endif /* LEGACY_FFT */
+
+	return;
+}
+
+
+#if !defined(LEGACY_FFT)
+/*
+ * DiscreteFourierTransform_batch - add the bit stream of a thread to its batch
+ *
+ * given:
+ *      thread_state    // thread whose bit stream is added
+ *
+ * The bit stream is converted into the next free place of fft_X, and its iteration is deferred until
+ * its result is recorded.  Once the batch holds batch_count bit streams, they are transformed together
+ * and their results recorded in the order they came.  The iteration being done is then left for the
+ * caller to finish, after the tests that follow this one.
+ */
+static void
+DiscreteFourierTransform_batch(struct thread_state *thread_state)
+{
+	struct state *state = thread_state->global_state;
+	long int thread_id = thread_state->thread_id;
+	long int batched;	// Number of bit streams of this thread waiting in fft_X
+
+	batched = state->fft_batched[thread_id];
+	DiscreteFourierTransform_X(state, thread_id, state->fft_X[thread_id] + batched * batch_stride);
+	state->fft_iteration[thread_id * batch_count + batched] = thread_state->iteration_being_done;
+	state->fft_batched[thread_id] = batched + 1;
+	if (batched + 1 < batch_count) {
+		thread_state->deferred = true;
+	} else {
+		DiscreteFourierTransform_transform(thread_state, batched);
+	}
+
+	return;
+}
+
+
+/*
+ * DiscreteFourierTransform_transform - transform the batch of a thread and record its results
+ *
+ * given:
+ *      thread_state    // thread whose batch is transformed
+ *      finish          // number of the first bit streams of the batch whose iterations are finished here
+ *
+ * A full batch is transformed by the batch plan, unless threads left without a bit stream may share
+ * the transforms: then, as for a partial batch, each bit stream is transformed by the plan for the
+ * threads that share it.
+ */
+static void
+DiscreteFourierTransform_transform(struct thread_state *thread_state, long int finish)
+{
+	struct state *state = thread_state->global_state;
+	long int n;			// Length of a single bit stream
+	long int batched;		// Number of bit streams of this thread waiting in fft_X
+	long int team;			// Number of threads sharing a transform
+	long int iteration;		// Iteration of a bit stream of the batch
+	double *X;			// Bit streams of the batch, as +1 and -1 values
+	fftw_complex *out;		// Output of the DFT of the bit streams
+	long int i;
+
+	batched = state->fft_batched[thread_state->thread_id];
+	if (batched <= 0) {
+		return;
+	}
+
+	/*
+	 * Steps 2, 3 and 6 for each bit stream of the batch
+	 */
+	n = state->tp.n;
+	X = state->fft_X[thread_state->thread_id];
+	out = (state->inPlaceFFT == true) ? (fftw_complex *) X : state->fftw_out[thread_state->thread_id];
+	team = DiscreteFourierTransform_team(state, batched - 1);
+	if (batched == batch_count && team == 1) {
+		fftw_execute_dft_r2c(state->fftw_batch_p, X, out);
+	} else {
+		for (i = 0; i < batched; i++) {
+			fftw_execute_dft_r2c(state->fftw_p[team], X + i * batch_stride, out + i * (batch_stride / 2));
+		}
+	}
+	state->fft_batched[thread_state->thread_id] = 0;
+	for (i = 0; i < batched; i++) {
+		iteration = state->fft_iteration[thread_state->thread_id * batch_count + i];
+		DiscreteFourierTransform_record(thread_state, iteration,
+						DiscreteFourierTransform_peaks((const double *) (out + i * (batch_stride / 2)),
+									       n / 2));
+		if (i < finish) {
+			finishIteration(thread_state, iteration);
+		}
+	}
+
+	return;
+}
+#endif /* LEGACY_FFT */
+
+
 /*
  * DiscreteFourierTransform_print_stat - print private_stats information to the end of an open file
  *
@@ -1176,53 +2412,94 @@ DiscreteFourierTransform_destroy(struct state *state)
 
 	for (i = 0; i < state->numberOfThreads; i++) {
 		if (state->fft_X[i] != NULL) {
+#if defined(LEGACY_FFT)
 			free(state->fft_X[i]);
+#else /* LEGACY_FFT */
+			fftw_free(state->fft_X[i]);
+#endif /* LEGACY_FFT */
 			state->fft_X[i] = NULL;
 		}
 #if defined(LEGACY_FFT)
-		if (state->fft_wsave[i] != NULL) {
-			free(state->fft_wsave[i]);
-			state->fft_wsave[i] = NULL;
+		if (state->fft_work[i] != NULL) {
+			free(state->fft_work[i]);
+			state->fft_work[i] = NULL;
 		}
 #else /* LEGACY_FFT */
 		if (state->fftw_out[i] != NULL) {
 			fftw_free(state->fftw_out[i]);
 			state->fftw_out[i] = NULL;
 		}
-		if (state->fftw_p[i] != NULL) {
-			fftw_destroy_plan(state->fftw_p[i]);
-			state->fftw_p[i] = NULL;
-		}
 #endif /* LEGACY_FFT */
-		if (state->fft_m[i] != NULL) {
-			free(state->fft_m[i]);
-			state->fft_m[i] = NULL;
-		}
 	}
 
 	if (state->fft_X != NULL) {
 		free(state->fft_X);
 		state->fft_X = NULL;
 	}
-#if defined(LEGACY_FFT)
-	if (state->fft_wsave != NULL) {
-		free(state->fft_wsave);
-		state->fft_wsave = NULL;
+	if (state->fft_scratch != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			if (state->fft_scratch[i] != NULL) {
+				fclose(state->fft_scratch[i]);
+				state->fft_scratch[i] = NULL;
+			}
+		}
+		free(state->fft_scratch);
+		state->fft_scratch = NULL;
+	}
+	if (state->fft_roots != NULL) {
+		free(state->fft_roots);
+		state->fft_roots = NULL;
 	}
+#if defined(LEGACY_FFT)
+	if (state->fft_work != NULL) {
+		free(state->fft_work);
+		state->fft_work = NULL;
+	}
+	dfft_plan_destroy(state->fft_plan);
+	state->fft_plan = NULL;
+	dfft_cplan_destroy(state->fft_row_plan);
+	state->fft_row_plan = NULL;
+	dfft_cplan_destroy(state->fft_col_plan);
+	state->fft_col_plan = NULL;
 #else /* LEGACY_FFT */
 	if (state->fftw_out != NULL) {
 		free(state->fftw_out);
 		state->fftw_out = NULL;
 	}
 	if (state->fftw_p != NULL) {
+		for (i = 1; i <= state->fftThreads; i++) {
+			if (state->fftw_p[i] != NULL) {
+				fftw_destroy_plan(state->fftw_p[i]);
+			}
+		}
 		free(state->fftw_p);
 		state->fftw_p = NULL;
 	}
-#endif /* LEGACY_FFT */
-	if (state->fft_m != NULL) {
-		free(state->fft_m);
-		state->fft_m = NULL;
+	if (state->fftw_row_p != NULL) {
+		fftw_destroy_plan(state->fftw_row_p);
+		state->fftw_row_p = NULL;
+	}
+	if (state->fftw_col_p != NULL) {
+		fftw_destroy_plan(state->fftw_col_p);
+		state->fftw_col_p = NULL;
+	}
+	if (state->fftwf_p != NULL) {
+		fftwf_destroy_plan(state->fftwf_p);
+		state->fftwf_p = NULL;
 	}
+	if (state->fftw_batch_p != NULL) {
+		fftw_destroy_plan(state->fftw_batch_p);
+		state->fftw_batch_p = NULL;
+	}
+	if (state->fft_batched != NULL) {
+		free(state->fft_batched);
+		state->fft_batched = NULL;
+	}
+	if (state->fft_iteration != NULL) {
+		free(state->fft_iteration);
+		state->fft_iteration = NULL;
+	}
+#endif /* LEGACY_FFT */
 
 	return;
 }
@@ -36,6 +36,7 @@
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 #include "../utils/cephes.h"
 
 
@@ -154,6 +155,7 @@ Frequency_iterate(struct thread_state *thread_state)
 	double f;		// Term in the p-value formula
 	double s_obs;		// Test statistic
 	double p_value;		// p_value iteration test result(s)
+	long int ones;		// Number of 1 bits in the bit stream
 	long int i;
 
 	/*
@@ -171,11 +173,14 @@ Frequency_iterate(struct thread_state *thread_state)
 		    test_num);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(71, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(71, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(71, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(71, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(71, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->cSetup != true) {
 		err(71, __func__, "test constants not setup prior to calling %s for %s[%d]",
@@ -188,18 +193,19 @@ Frequency_iterate(struct thread_state *thread_state)
 	n = state->tp.n;
 
 	/*
-	 * Step 1: compute S_n
+	 * Step 1: compute S_n = 2 * (number of 1 bits) - n
+	 *
+	 * The readers only store 0 and 1 bits, so the bits need no validation here.
 	 */
-	stat.S_n = 0;
-	for (i = 0; i < n; i++) {
-		if ((int) state->epsilon[thread_state->thread_id][i] == 1) {
-			stat.S_n++;
-		} else if ((int) state->epsilon[thread_state->thread_id][i] == 0) {
-			stat.S_n--;
-		} else {
-			err(41, __func__, "found a bit different than 1 or 0 in the sequence");
+	if (state->byteEpsilon == true) {
+		ones = 0;
+		for (i = 0; i < n; i++) {
+			ones += state->epsilon[thread_state->thread_id][i];
 		}
+	} else {
+		ones = countOnes(state->packedEpsilon[thread_state->thread_id], 0, n);
 	}
+	stat.S_n = 2 * ones - n;
 
 	/*
 	 * Step 2: compute the test statistic
@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -245,11 +246,14 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(101, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(101, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(101, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(101, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(101, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->linear_b == NULL) {
 		err(101, __func__, "state->linear_b is NULL");
@@ -313,10 +317,18 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 			/*
 			 * Sub-step 4a: set the discrepancy
 			 */
-			d = (int) state->epsilon[thread_state->thread_id][i * M + j];
-			for (k = 1; k <= L; k++) {
-				d += state->linear_c[thread_state->thread_id][k] *
-						state->epsilon[thread_state->thread_id][i * M + j - k];
+			if (state->byteEpsilon == true) {
+				d = (int) state->epsilon[thread_state->thread_id][i * M + j];
+				for (k = 1; k <= L; k++) {
+					d += state->linear_c[thread_state->thread_id][k] *
+							state->epsilon[thread_state->thread_id][i * M + j - k];
+				}
+			} else {
+				d = PACKED_BIT(state->packedEpsilon[thread_state->thread_id], i * M + j);
+				for (k = 1; k <= L; k++) {
+					d += state->linear_c[thread_state->thread_id][k] *
+							PACKED_BIT(state->packedEpsilon[thread_state->thread_id], i * M + j - k);
+				}
 			}
 
 			d = d % 2;
@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -334,11 +335,14 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(111, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(111, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(111, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(111, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(111, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
 	/*
@@ -381,17 +385,21 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 		/*
 		 * Step 2a: determine maximum 1-bit run length for this block
 		 */
-		v_obs = 0;
-		run = 0;
-		for (j = 0; j < stat.M; j++) {
-			if (state->epsilon[thread_state->thread_id][(i * stat.M) + j] == 1) {
-				run++;
-				if (run > v_obs) {
-					v_obs = run;
+		if (state->byteEpsilon == true) {
+			v_obs = 0;
+			run = 0;
+			for (j = 0; j < stat.M; j++) {
+				if (state->epsilon[thread_state->thread_id][(i * stat.M) + j] == 1) {
+					run++;
+					if (run > v_obs) {
+						v_obs = run;
+					}
+				} else {
+					run = 0;
 				}
-			} else {
-				run = 0;
 			}
+		} else {
+			v_obs = longestOnesRun(state->packedEpsilon[thread_state->thread_id], i * stat.M, stat.M);
 		}
 
 		/*
@@ -37,6 +37,7 @@
 #include "../utils/utilities.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -162,6 +163,7 @@ static const long int numOfTemplates[MAXTEMPLEN + 1] = {
  * Forward static function declarations
  */
 static void appendTemplate(struct state *state, ULONG value, long int m);
+static void countTemplates(struct state *state, long int thread_id, long int M, struct nonover_stats *nonover_stats);
 static bool NonOverlappingTemplateMatchings_print_stat(FILE * stream, struct state *state,
 						       struct NonOverlappingTemplateMatchings_private_stats *stat,
 						       struct dyn_array *nonover_stats, long int nonstat_index);
@@ -186,7 +188,10 @@ NonOverlappingTemplateMatchings_init(struct state *state)
 	long int M;		// Length of each block to be tested
 	long int m;		// Length of a template
 	ULONG max_num;		// Max decimal value of a template
+	ULONG value;		// m bit value of a template
 	ULONG i;
+	long int j;
+	long int k;
 
 	/*
 	 * Check preconditions (firewall)
@@ -307,6 +312,44 @@ NonOverlappingTemplateMatchings_init(struct state *state)
 	}
 	dbg(DBG_HIGH, "Formed an array of %ld non-overlapping templates of %ld bytes each", numOfTemplates[m], m);
 
+	/*
+	 * Index the templates by their m bit value
+	 *
+	 * The packed bit stream is scanned once with a rolling m bit window, and the value of
+	 * the window tells which template, if any, it matches.
+	 */
+	state->nonper_index = malloc((size_t) max_num * sizeof(state->nonper_index[0]));
+	if (state->nonper_index == NULL) {
+		errp(130, __func__, "cannot malloc for nonper_index: %lu elements of %lu bytes each", (unsigned long) max_num,
+		     sizeof(state->nonper_index[0]));
+	}
+	for (i = 0; i < max_num; i++) {
+		state->nonper_index[i] = -1;
+	}
+	for (j = 0; j < numOfTemplates[m]; j++) {
+		value = 0;
+		for (k = 0; k < m; k++) {
+			value = (value << 1) | get_value(state->nonovTemplates, BitSequence, m * j + k);
+		}
+		state->nonper_index[value] = j;
+	}
+
+	/*
+	 * Allocate, for each thread, the first bit where each m bit value may be counted again
+	 */
+	state->nonper_next = malloc((size_t) state->numberOfThreads * sizeof(*state->nonper_next));
+	if (state->nonper_next == NULL) {
+		errp(130, __func__, "cannot malloc for nonper_next: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(*state->nonper_next));
+	}
+	for (i = 0; i < state->numberOfThreads; i++) {
+		state->nonper_next[i] = malloc((size_t) max_num * sizeof(state->nonper_next[i][0]));
+		if (state->nonper_next[i] == NULL) {
+			errp(130, __func__, "cannot malloc of %lu elements of %lu bytes each for state->nonper_next[%lu]",
+			     (unsigned long) max_num, sizeof(state->nonper_next[i][0]), (unsigned long) i);
+		}
+	}
+
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
 	 */
@@ -405,6 +448,78 @@ appendTemplate(struct state *state, ULONG value, long int m)
 }
 
 
+/*
+ * countTemplates - count the non-overlapping occurrences of every template in each block of a packed bit stream
+ *
+ * given:
+ *      state           // run state to test under
+ *      thread_id       // thread whose packed bit stream is scanned
+ *      M               // length of each block
+ *      nonover_stats   // Wj[i] of each template is incremented for each occurrence in block i
+ *
+ * Each bit of the stream is shifted once into a rolling m bit window.  The value of the window
+ * indexes the template it matches, if any, and the first bit where that value may be counted again.
+ * A counted occurrence at bit p pushes that first bit to p + m, which is what rescanning the
+ * block for each template, and skipping m bits after each match, would count.
+ *
+ * NOTE: Bit positions are counted from the start of the stream, so an occurrence counted in one
+ *       block never holds back a count in the next one.
+ */
+static void
+countTemplates(struct state *state, long int thread_id, long int M, struct nonover_stats *nonover_stats)
+{
+	const WORD64 *w;	// Packed bit stream
+	const long int *index;	// Template index of each m bit value, or -1
+	long int *next;		// First bit where each m bit value may be counted again
+	long int m;		// NonOverlapping Template Test - block length
+	WORD64 mask;		// The m low bits of a window
+	WORD64 window;		// Last m bits shifted in, the newest one being the least significant
+	WORD64 word;		// Bits of the current word not shifted into the window yet, most significant first
+	long int end;		// Bit following the end of the current block
+	long int q;		// Bit being shifted into the window
+	long int t;
+	long int i;
+
+	/*
+	 * Collect parameters
+	 */
+	w = state->packedEpsilon[thread_id];
+	index = state->nonper_index;
+	next = state->nonper_next[thread_id];
+	m = state->tp.nonOverlappingTemplateLength;
+	mask = ((WORD64) 1 << m) - 1;
+	memset(next, 0, (size_t) (mask + 1) * sizeof(next[0]));
+
+	/*
+	 * Scan each block once, the window being complete from its m-th bit
+	 */
+	for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
+		q = i * M + m - 1;
+		end = (i + 1) * M;
+		window = packedBits(w, i * M, (int) (m - 1));
+		word = w[q / BITS_N_WORD64] << (q % BITS_N_WORD64);
+		for (; q < end; q++) {
+			if (q % BITS_N_WORD64 == 0) {
+				word = w[q / BITS_N_WORD64];
+			}
+			window = ((window << 1) | (word >> (BITS_N_WORD64 - 1))) & mask;
+			word <<= 1;
+
+			/*
+			 * Count the template that the window holds, unless it overlaps the last one counted
+			 */
+			t = index[window];
+			if (t >= 0 && next[window] <= q - m + 1) {
+				nonover_stats[t].Wj[i]++;
+				next[window] = q + 1;
+			}
+		}
+	}
+
+	return;
+}
+
+
 /*
  * NonOverlappingTemplateMatchings_iterate - iterate one bit stream for Nonoverlapping Template test
  *
@@ -448,11 +563,14 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when testNames was NULL", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(132, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(132, __func__, "state->packedEpsilon is NULL");
+	}
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(132, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(132, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(132, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->nonper_seq == NULL) {
 		err(132, __func__, "state->nonper_seq is NULL");
@@ -460,6 +578,12 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	if (state->nonper_seq[thread_state->thread_id] == NULL) {
 		err(132, __func__, "state->nonper_seq[%ld] is NULL", thread_state->thread_id);
 	}
+	if (state->nonper_index == NULL) {
+		err(132, __func__, "state->nonper_index is NULL");
+	}
+	if (state->nonper_next == NULL || state->nonper_next[thread_state->thread_id] == NULL) {
+		err(132, __func__, "state->nonper_next[%ld] is NULL", thread_state->thread_id);
+	}
 
 	/*
 	 * Collect parameters
@@ -496,84 +620,91 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	 * Initialize array of nonover_stats
 	 */
 	nonover_stats = malloc((size_t) numOfTemplates[m] * sizeof(*nonover_stats));
+	if (nonover_stats == NULL) {
+		errp(132, __func__, "cannot malloc for nonover_stats: %ld elements of %lu bytes each", numOfTemplates[m],
+		     sizeof(*nonover_stats));
+	}
+	for (jj = 0; jj < numOfTemplates[m]; jj++) {
+		memset(nonover_stats[jj].Wj, 0, sizeof(nonover_stats[jj].Wj));
+	}
 
 	/*
-	 * Process all template values
+	 * Step 2: count the number of times that each template occurs within each block
 	 */
-	for (jj = 0; jj < numOfTemplates[m]; jj++) {
-
-		struct nonover_stats nonover_stat;
-
-		/*
-		 * Get the next template from the pool of precomputed ones
-		 */
-		memcpy(state->nonper_seq[thread_state->thread_id], addr_value(state->nonovTemplates, BitSequence, m * jj),
-		       m * sizeof(BitSequence));
-
-		/*
-		 * Zeroize the occurrences counters for this template
-		 */
-		memset(nonover_stat.Wj, 0, sizeof(nonover_stat.Wj));
-
-		/*
-	 	 * Step 2: count the number of times that this template occurs within each block
-	 	 */
-		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
-			W_obs = 0;
+	if (state->byteEpsilon == true) {
+		for (jj = 0; jj < numOfTemplates[m]; jj++) {
 
 			/*
-			 * Count occurrences of the current template in block i
+			 * Get the next template from the pool of precomputed ones
 			 */
-			for (j = 0; j < stat.M - m + 1; j++) {
-				match = true;
+			memcpy(state->nonper_seq[thread_state->thread_id], addr_value(state->nonovTemplates, BitSequence, m * jj),
+			       m * sizeof(BitSequence));
+
+			for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
+				W_obs = 0;
 
 				/*
-				 * Check if all the m bits of the template match the bits being
-				 * considered in the block.
+				 * Count occurrences of the current template in block i
 				 */
-				for (k = 0; k < m; k++) {
-					if (state->nonper_seq[thread_state->thread_id][k] !=
-							state->epsilon[thread_state->thread_id][i * stat.M + j + k]) {
-						match = false;
-						break;
+				for (j = 0; j < stat.M - m + 1; j++) {
+					/*
+					 * Check if all the m bits of the template match the bits being
+					 * considered in the block.
+					 */
+					match = true;
+					for (k = 0; k < m; k++) {
+						if (state->nonper_seq[thread_state->thread_id][k] !=
+								state->epsilon[thread_state->thread_id][i * stat.M + j + k]) {
+							match = false;
+							break;
+						}
+					}
+
+					/*
+					 * If all the bits match, count one occurrence of this template and
+					 * slide the window over m bits.
+					 */
+					if (match == true) {
+						W_obs++;
+						j += m - 1;
 					}
 				}
 
 				/*
-				 * If all the bits match, count one occurrence of this template and
-				 * slide the window over m bits.
+				 * Store the count of occurrences found in this block
 				 */
-				if (match == true) {
-					W_obs++;
-					j += m - 1;
-				}
+				nonover_stats[jj].Wj[i] = W_obs;
 			}
-
-			/*
-			 * Store the count of occurrences found in this block
-			 */
-			nonover_stat.Wj[i] = W_obs;
 		}
+	} else {
+		countTemplates(state, thread_state->thread_id, stat.M, nonover_stats);
+	}
+
+	/*
+	 * Process all template values
+	 */
+	for (jj = 0; jj < numOfTemplates[m]; jj++) {
+
+		struct nonover_stats *nonover_stat = &nonover_stats[jj];
 
 		/*
 		 * Step 4: compute the test statistic
 		 */
-		nonover_stat.chi2 = 0.0;
+		nonover_stat->chi2 = 0.0;
 		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
-			chi2_term = ((double) nonover_stat.Wj[i] - stat.mu) / sqrt(stat.sigma_squared);
-			nonover_stat.chi2 += (chi2_term * chi2_term);
+			chi2_term = ((double) nonover_stat->Wj[i] - stat.mu) / sqrt(stat.sigma_squared);
+			nonover_stat->chi2 += (chi2_term * chi2_term);
 		}
 
 		/*
 		 * Step 5: compute the test p-value
 		 */
-		nonover_stat.p_value = cephes_igamc(BLOCKS_NON_OVERLAPPING / 2.0, nonover_stat.chi2 / 2.0);
+		nonover_stat->p_value = cephes_igamc(BLOCKS_NON_OVERLAPPING / 2.0, nonover_stat->chi2 / 2.0);
 
 		/*
 		 * Store the index of the template just tested in the stats
 		 */
-		nonover_stat.template_index = jj;
-		nonover_stats[jj] = nonover_stat;
+		nonover_stat->template_index = jj;
 	}
 
 	/*
@@ -645,6 +776,7 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	if (thread_state->mutex != NULL) {
 		pthread_mutex_unlock(thread_state->mutex);
 	}
+	free(nonover_stats);
 
 	return;
 }
@@ -1499,6 +1631,17 @@ NonOverlappingTemplateMatchings_destroy(struct state *state)
 		free(state->nonper_seq);
 		state->nonper_seq = NULL;
 	}
+	if (state->nonper_index != NULL) {
+		free(state->nonper_index);
+		state->nonper_index = NULL;
+	}
+	if (state->nonper_next != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			free(state->nonper_next[i]);
+		}
+		free(state->nonper_next);
+		state->nonper_next = NULL;
+	}
 
 	return;
 }
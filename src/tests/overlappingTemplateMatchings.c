@@ -37,6 +37,7 @@
 #include "../utils/utilities.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 #define B_VALUE (1)		// The B template to be matched contains only 1 values
 
@@ -215,6 +216,7 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	long int m;		// Overlapping Template Test - template length
 	long int n;		// Length of a single bit stream
 	bool match;		// 1 ==> template match
+	WORD64 template;	// The template of m B_VALUE bits, right justified
 	double W_obs;		// Counter of the number of occurrences of a template in a block
 	double chi2_term;	// Term whose square is used to compute chi squared for this iteration
 	double p_value;		// p_value iteration test result(s)
@@ -236,11 +238,14 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(141, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(141, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(141, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(141, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(141, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
 	/*
@@ -257,6 +262,11 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	 */
 	memset(stat.v, 0, sizeof(stat.v));
 
+	/*
+	 * Form the template of m B_VALUE bits to compare with the packed bit stream
+	 */
+	template = (~(WORD64) 0) >> (BITS_N_WORD64 - m);
+
 	/*
 	 * Step 2: calculate the number of occurrences of the template in each of the N blocks of length M.
 	 * NOTE: Because the template we are checking is made only of ones, we don't need to
@@ -273,12 +283,17 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 		 * Increase the W_obs counter whenever there is an occurrence of the template in block i
 		 */
 		for (j = 0; j < BLOCK_LENGTH_OVERLAPPING - m + 1; j++) {
-			match = true;
-			for (k = 0; k < m; k++) {
-				if (B_VALUE != state->epsilon[thread_state->thread_id][i * BLOCK_LENGTH_OVERLAPPING + j + k]) {
-					match = false;
-					break;
+			if (state->byteEpsilon == true) {
+				match = true;
+				for (k = 0; k < m; k++) {
+					if (B_VALUE != state->epsilon[thread_state->thread_id][i * BLOCK_LENGTH_OVERLAPPING + j + k]) {
+						match = false;
+						break;
+					}
 				}
+			} else {
+				match = (packedBits(state->packedEpsilon[thread_state->thread_id],
+						    i * BLOCK_LENGTH_OVERLAPPING + j, (int) m) == template) ? true : false;
 			}
 			if (match == true) {
 				W_obs++;
@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -212,11 +213,14 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(161, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(161, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(161, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(161, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(161, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->rnd_excursion_var_stateX == NULL) {
 		err(161, __func__, "state->rnd_excursion_var_stateX is NULL");
@@ -246,20 +250,16 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 2: compute the partial sums of successively larger sub-sequences
 	 */
-	if ((int) state->epsilon[thread_state->thread_id][0] == 1) {
-		S[0] = 1;
-	} else if ((int) state->epsilon[thread_state->thread_id][0] == 0) {
-		S[0] = - 1;
+	if (state->byteEpsilon == false) {
+		S[0] = 2 * PACKED_BIT(state->packedEpsilon[thread_state->thread_id], 0) - 1;
 	} else {
-		err(41, __func__, "found a bit different than 1 or 0 in the sequence");
+		S[0] = 2 * (int) state->epsilon[thread_state->thread_id][0] - 1;
 	}
 	for (j = 1; j < n; j++) {
-		if ((int) state->epsilon[thread_state->thread_id][j] == 1) {
-			S[j] = S[j - 1] + 1;
-		} else if ((int) state->epsilon[thread_state->thread_id][j] == 0) {
-			S[j] = S[j - 1] - 1;
+		if (state->byteEpsilon == false) {
+			S[j] = S[j - 1] + 2 * PACKED_BIT(state->packedEpsilon[thread_state->thread_id], j) - 1;
 		} else {
-			err(41, __func__, "found a bit different than 1 or 0 in the sequence");
+			S[j] = S[j - 1] + 2 * (int) state->epsilon[thread_state->thread_id][j] - 1;
 		}
 
 		/*
@@ -39,6 +39,7 @@
 #include "../utils/matrix.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -47,9 +48,9 @@
 struct Rank_private_stats {
 	bool success;		// Success or failure of iteration test
 	double chi_squared;	// Chi squared for rank frequencies
-	long int F_M;		// Frequency of rank NUMBER_OF_ROWS_RANK fpr this iteration
-	long int F_M_minus_one;	// Frequency of rank NUMBER_OF_ROWS_RANK-1 fpr this iteration
-	long int F_remaining;	// Frequency of rank < NUMBER_OF_ROWS_RANK-1 fpr this iteration
+	long int F_M;		// Frequency of full rank MIN(M, Q) fpr this iteration
+	long int F_M_minus_one;	// Frequency of rank MIN(M, Q)-1 fpr this iteration
+	long int F_remaining;	// Frequency of rank < MIN(M, Q)-1 fpr this iteration
 };
 
 
@@ -62,15 +63,19 @@ static const enum test test_num = TEST_RANK;	// This test number
 /*
  * Static variables declarations
  */
-static double p_32;			// Probability of rank NUMBER_OF_ROWS_RANK
-static double p_31;			// Probability of rank NUMBER_OF_ROWS_RANK - 1
-static double p_30;			// Probability of rank < NUMBER_OF_ROWS_RANK - 1
+static int M;				// Rows per matrix (-P 12=M)
+static int Q;				// Columns per matrix (-P 13=Q)
+static int full_rank;			// Rank of a full rank matrix: MIN(M, Q)
+static double p_32;			// Probability of rank full_rank
+static double p_31;			// Probability of rank full_rank - 1
+static double p_30;			// Probability of rank < full_rank - 1
 static long int matrix_count;		// Total possible matrix for a given bit stream length
 
 
 /*
  * Forward static function declarations
  */
+static double Rank_probability(int r);
 static bool Rank_print_stat(FILE * stream, struct state *state, struct Rank_private_stats *stat, double p_value);
 static bool Rank_print_p_value(FILE * stream, double p_value);
 static void Rank_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
@@ -89,8 +94,6 @@ static void Rank_metric_print(struct state *state, long int sampleCount, long in
 void
 Rank_init(struct state *state)
 {
-	double product;			// Probability product, used when computing values of static variables
-	int r;				// Row count to consider, used when computing values of static variables
 	int i;
 
 	/*
@@ -108,15 +111,30 @@ Rank_init(struct state *state)
 		err(170, __func__, "test constants not setup prior to calling %s for %s[%d]",
 		    __func__, state->testNames[test_num], test_num);
 	}
-	if (((long int) NUMBER_OF_ROWS_RANK * (long int) NUMBER_OF_COLS_RANK) > (long int) LONG_MAX) {	// paranoia
-		err(170, __func__, "NUMBER_OF_ROWS_RANK: %d * NUMBER_OF_COLS_RANK: %d cannot fit into a long int because"
-				"the product is > %ld", NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK, LONG_MAX);
+
+	/*
+	 * Disable test if conditions do not permit this test from being run
+	 */
+	if (state->tp.rankRows < MIN_ROWS_RANK || state->tp.rankCols < MIN_ROWS_RANK) {
+		warn(__func__, "disabling test %s[%d]: requires rows(M): %ld and columns(Q): %ld per matrix >= %d",
+		     state->testNames[test_num], test_num, state->tp.rankRows, state->tp.rankCols, MIN_ROWS_RANK);
+		state->testVector[test_num] = false;
+		return;
+	} else if (state->tp.rankRows > state->tp.n / state->tp.rankCols) {
+		warn(__func__, "disabling test %s[%d]: requires a matrix of rows(M): %ld by columns(Q): %ld "
+		     "to fit into bitcount(n): %ld", state->testNames[test_num], test_num,
+		     state->tp.rankRows, state->tp.rankCols, state->tp.n);
+		state->testVector[test_num] = false;
+		return;
 	}
 
 	/*
 	 * Collect parameters from state
 	 */
-	matrix_count = state->tp.n / (NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK);
+	M = (int) state->tp.rankRows;
+	Q = (int) state->tp.rankCols;
+	full_rank = MIN(M, Q);
+	matrix_count = state->tp.n / ((long int) M * (long int) Q);
 
 	/*
 	 * Disable test if conditions do not permit this test from being run
@@ -129,47 +147,42 @@ Rank_init(struct state *state)
 	}
 
 	/*
-	 * Compute probability of rank NUMBER_OF_ROWS_RANK
+	 * Compute probability of rank full_rank
 	 */
-	r = NUMBER_OF_ROWS_RANK;
-	product = 1.0;
-	for (i = 0; i <= r - 1; i++) {
-		product *= ((1.0 - pow(2.0, i - NUMBER_OF_ROWS_RANK))
-			    * (1.0 - pow(2.0, i - NUMBER_OF_COLS_RANK))) / (1.0 - pow(2.0, i - r));
-	}
-	p_32 = pow(2.0, r * (NUMBER_OF_ROWS_RANK + NUMBER_OF_COLS_RANK - r)
-			- NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK) * product;
+	p_32 = Rank_probability(full_rank);
 	if (p_32 <= 0.0) {	// paranoia
 		err(50, __func__, "bogus p_32 value: %f should be > 0.0", p_32);
 	}
-	if (p_32 >= 1.0) {	// paranoia
-		err(50, __func__, "bogus p_32 value: %f should be < 1.0", p_32);
+	if (p_32 > 1.0) {	// paranoia
+		err(50, __func__, "bogus p_32 value: %f should be <= 1.0", p_32);
 	}
 
 	/*
-	 * Compute probability of rank NUMBER_OF_ROWS_RANK - 1
+	 * Compute probability of rank full_rank - 1
 	 */
-	r = NUMBER_OF_ROWS_RANK - 1;
-	product = 1.0;
-	for (i = 0; i <= r - 1; i++) {
-		product *= ((1.0 - pow(2.0, i - NUMBER_OF_ROWS_RANK))
-			    * (1.0 - pow(2.0, i - NUMBER_OF_COLS_RANK))) / (1.0 - pow(2.0, i - r));
-	}
-	p_31 = pow(2.0, r * (NUMBER_OF_ROWS_RANK + NUMBER_OF_COLS_RANK - r)
-			- NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK) * product;
-	if (p_31 <= 0.0) {	// paranoia
-		err(50, __func__, "bogus p_31 value: %f should be > 0.0", p_31);
+	p_31 = Rank_probability(full_rank - 1);
+	if (p_31 < 0.0) {	// paranoia
+		err(50, __func__, "bogus p_31 value: %f should be >= 0.0", p_31);
 	}
 	if (p_31 >= 1.0) {	// paranoia
 		err(50, __func__, "bogus p_31 value: %f should be < 1.0", p_31);
 	}
 
 	/*
-	 * Compute probability of rank < NUMBER_OF_ROWS_RANK - 1
+	 * Compute probability of rank < full_rank - 1
+	 *
+	 * When M and Q are far apart, p_32 is close to 1.0 and 1.0 - (p_32 + p_31) loses all of its precision,
+	 * so the probabilities of the smaller ranks are summed instead.
 	 */
 	p_30 = 1.0 - (p_32 + p_31);
-	if (p_30 <= 0.0) {	// paranoia
-		err(50, __func__, "bogus p_30 value: %f == (1.0 - p32: %f - p_31: %f) should be > 0.0",
+	if (M != Q) {
+		p_30 = 0.0;
+		for (i = full_rank - 2; i >= 0; i--) {
+			p_30 += Rank_probability(i);
+		}
+	}
+	if (p_30 < 0.0) {	// paranoia
+		err(50, __func__, "bogus p_30 value: %f == (1.0 - p32: %f - p_31: %f) should be >= 0.0",
 		    p_30, p_31, p_32);
 	}
 	if (p_30 >= 1.0) {	// paranoia
@@ -178,15 +191,41 @@ Rank_init(struct state *state)
 	}
 
 	/*
-	 * Allocate the array for the rank test matrices for each thread
+	 * Disable test if a rank class is too unlikely for the chi-squared statistic
 	 */
-	state->rank_matrix = malloc((size_t) state->numberOfThreads * sizeof(*state->rank_matrix));
-	if (state->rank_matrix == NULL) {
-		errp(50, __func__, "cannot malloc for rank_matrix: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->rank_matrix));
+	if (matrix_count * MIN(p_31, p_30) < MIN_EXPECTED_COUNT_RANK) {
+		warn(__func__, "disabling test %s[%d]: %ld matrices of %d by %d bits are expected to have only "
+		     "%g of rank %d and %g of smaller rank, need >= %.1f of each",
+		     state->testNames[test_num], test_num, matrix_count, M, Q, matrix_count * p_31, full_rank - 1,
+		     matrix_count * p_30, MIN_EXPECTED_COUNT_RANK);
+		state->testVector[test_num] = false;
+		return;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		state->rank_matrix[i] = create_matrix(NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK);
+
+	/*
+	 * Allocate the matrix for the rank test for each thread
+	 *
+	 * With -B the matrix has a byte per bit, otherwise the packed bit stream is loaded into words:
+	 * matrices of up to 32 by 32 bits are loaded by countWordRanks() itself, larger ones need a packed matrix.
+	 */
+	if (state->byteEpsilon == true) {
+		state->rank_matrix = malloc((size_t) state->numberOfThreads * sizeof(*state->rank_matrix));
+		if (state->rank_matrix == NULL) {
+			errp(50, __func__, "cannot malloc for rank_matrix: %ld elements of %ld bytes each",
+			     state->numberOfThreads, sizeof(*state->rank_matrix));
+		}
+		for (i = 0; i < state->numberOfThreads; i++) {
+			state->rank_matrix[i] = create_matrix(M, Q);
+		}
+	} else if (M > BITS_N_DBLWORD || Q > BITS_N_DBLWORD) {
+		state->rank_rows = malloc((size_t) state->numberOfThreads * sizeof(*state->rank_rows));
+		if (state->rank_rows == NULL) {
+			errp(50, __func__, "cannot malloc for rank_rows: %ld elements of %ld bytes each",
+			     state->numberOfThreads, sizeof(*state->rank_rows));
+		}
+		for (i = 0; i < state->numberOfThreads; i++) {
+			state->rank_rows[i] = create_packed_matrix(M, Q);
+		}
 	}
 
 	/*
@@ -219,6 +258,30 @@ Rank_init(struct state *state)
 }
 
 
+/*
+ * Rank_probability - probability that a random M by Q binary matrix has rank r
+ *
+ * given:
+ *      r               // rank, 0 <= r <= MIN(M, Q)
+ *
+ * returns:
+ *      2^(r*(Q+M-r)-M*Q) * product over i from 0 to r-1 of (1-2^(i-Q))*(1-2^(i-M))/(1-2^(i-r))
+ *
+ * NOTE: The exponent r*(Q+M-r)-M*Q is -(M-r)*(Q-r), which is computed as a double so that large
+ *       matrices cannot overflow an int.
+ */
+static double
+Rank_probability(int r)
+{
+	double product;		// Probability product
+	int i;
+
+	product = 1.0;
+	for (i = 0; i <= r - 1; i++) {
+		product *= ((1.0 - pow(2.0, i - M)) * (1.0 - pow(2.0, i - Q))) / (1.0 - pow(2.0, i - r));
+	}
+	return pow(2.0, -(double) (M - r) * (double) (Q - r)) * product;
+}
 /*
  * Rank_iterate - iterate one bit stream for Rank test
  *
@@ -235,7 +298,8 @@ Rank_iterate(struct thread_state *thread_state)
 	struct Rank_private_stats stat;	// Stats for this iteration
 	BitSequence **matrix;		// The matrix state->rank_matrix
 	BitSequence *row;		// A row of the matrix state->rank_matrix
-	int R;				// Rank of a given NUMBER_OF_ROWS_RANK by NUMBER_OF_COLS_RANK matrix
+	WORD64 *rows;			// The packed matrix state->rank_rows
+	int R;				// Rank of a given M by Q matrix
 	double p_value;			// p_value iteration test result(s)
 	long int k;
 	long int i;
@@ -254,17 +318,21 @@ Rank_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(171, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(171, __func__, "state->packedEpsilon is NULL");
+	}
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(171, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(171, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(171, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->rank_matrix == NULL) {
-		err(171, __func__, "state->rank_matrix is NULL");
+	if (state->byteEpsilon == true && (state->rank_matrix == NULL || state->rank_matrix[thread_state->thread_id] == NULL)) {
+		err(171, __func__, "-B was given but state->rank_matrix[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->rank_matrix[thread_state->thread_id] == NULL) {
-		err(171, __func__, "state->rank_matrix[%ld] is NULL", thread_state->thread_id);
+	if (state->byteEpsilon == false && (M > BITS_N_DBLWORD || Q > BITS_N_DBLWORD) &&
+	    (state->rank_rows == NULL || state->rank_rows[thread_state->thread_id] == NULL)) {
+		err(171, __func__, "state->rank_rows[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->cSetup != true) {
 		err(171, __func__, "test constants not setup prior to calling %s for %s[%d]",
@@ -274,59 +342,90 @@ Rank_iterate(struct thread_state *thread_state)
 	/*
 	 * Setup test parameters
 	 */
-	matrix = state->rank_matrix[thread_state->thread_id];
 	stat.F_M = 0;
 	stat.F_M_minus_one = 0;
 
-	/*
-	 * Zeroize the Rank test matrix
-	 */
-	for (i = 0; i < NUMBER_OF_ROWS_RANK; ++i) {
+	if (state->byteEpsilon == true) {
 
 		/*
-		 * Find the row
+		 * Zeroize the Rank test matrix
 		 */
-		row = matrix[i];
-		if (row == NULL) {	// paranoia
-			err(171, __func__, "row pointer %ld of rank_matrix is NULL", i);
+		matrix = state->rank_matrix[thread_state->thread_id];
+		for (i = 0; i < M; ++i) {
+
+			/*
+			 * Find the row
+			 */
+			row = matrix[i];
+			if (row == NULL) {	// paranoia
+				err(171, __func__, "row pointer %ld of rank_matrix is NULL", i);
+			}
+
+			/*
+			 * Zeroize the full row
+			 */
+			memset(row, 0, Q * sizeof(row[0]));
 		}
 
 		/*
-		 * Zeroize the full row
+		 * Step 1a: divide the sequence into disjoint blocks of M * Q bits
 		 */
-		memset(row, 0, NUMBER_OF_COLS_RANK * sizeof(row[0]));
-	}
+		for (k = 0; k < matrix_count; k++) {
 
-	/*
-	 * Step 1a: divide the sequence into disjoint blocks of NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK bits
-	 */
-	for (k = 0; k < matrix_count; k++) {
+			/*
+			 * Step 1b: copy bits of each block into a M * Q matrix
+			 */
+			def_matrix(thread_state, M, Q, matrix, k);
+
+			/*
+			 * Step 2: determine the binary rank of each matrix
+			 */
+			R = computeRank(M, Q, matrix);
+
+			/*
+			 * Step 3a: count the number of matrices with rank = (full rank) and rank = (full rank - 1)
+			 */
+			if (R == full_rank) {
+				stat.F_M++;	// rank full_rank found
+			} else if (R == (full_rank - 1)) {
+				stat.F_M_minus_one++;	// rank full_rank-1 found
+			}
+		}
 
 		/*
-	 	 * Step 1b: copy bits of each block into a NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK matrix
-	 	 */
-		def_matrix(thread_state, NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK, matrix, k);
+		 * Step 3b: count the number of matrices with rank less than (full rank - 1)
+		 */
+		stat.F_remaining = matrix_count - (stat.F_M + stat.F_M_minus_one);
+	} else if (M <= BITS_N_DBLWORD && Q <= BITS_N_DBLWORD) {
 
 		/*
-	 	 * Step 2: determine the binary rank of each matrix
-	 	 */
-		R = computeRank(NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK, matrix);
+		 * Steps 1 thru 3: load each block of the packed sequence into word rows, determine the ranks
+		 * of RANK_BATCH matrices at once, and count the ranks
+		 */
+		countWordRanks(state->packedEpsilon[thread_state->thread_id], matrix_count,
+			       M, Q, &stat.F_M, &stat.F_M_minus_one, &stat.F_remaining);
+	} else {
 
 		/*
-		 * Step 3a: count the number of matrices with rank = (full rank) and rank = (full rank - 1)
+		 * Step 1: load each block of the packed sequence into a packed matrix
+		 *
+		 * Step 2: determine the binary rank of each matrix with the Method of Four Russians
+		 *
+		 * Step 3: count the number of matrices of each rank class
 		 */
-		if (R == NUMBER_OF_ROWS_RANK) {
-			stat.F_M++;	// rank NUMBER_OF_ROWS_RANK found
-		} else if (R == (NUMBER_OF_ROWS_RANK - 1)) {
-			stat.F_M_minus_one++;	// rank NUMBER_OF_ROWS_RANK-1 found
+		rows = state->rank_rows[thread_state->thread_id];
+		for (k = 0; k < matrix_count; k++) {
+			def_packed_matrix(state->packedEpsilon[thread_state->thread_id], k * M * Q, M, Q, rows);
+			R = computePackedRank(M, Q, rows);
+			if (R == full_rank) {
+				stat.F_M++;	// rank full_rank found
+			} else if (R == (full_rank - 1)) {
+				stat.F_M_minus_one++;	// rank full_rank-1 found
+			}
 		}
+		stat.F_remaining = matrix_count - (stat.F_M + stat.F_M_minus_one);
 	}
 
-	/*
-	 * Step 3b: count the number of matrices with rank less than (full rank - 1)
-	 */
-	stat.F_remaining = matrix_count - (stat.F_M + stat.F_M_minus_one);
-
 	/*
 	 * Step 4: compute the test statistic
 	 */
@@ -462,27 +561,27 @@ Rank_print_stat(FILE * stream, struct state *state, struct Rank_private_stats *s
 			return false;
 		}
 	}
-	io_ret = fprintf(stream, "\t\t(a) Probability P_%d = %f\n", NUMBER_OF_ROWS_RANK, p_32);
+	io_ret = fprintf(stream, "\t\t(a) Probability P_%d = %f\n", full_rank, p_32);
 	if (io_ret <= 0) {
 		return false;
 	}
-	io_ret = fprintf(stream, "\t\t(b)             P_%d = %f\n", NUMBER_OF_ROWS_RANK - 1, p_31);
+	io_ret = fprintf(stream, "\t\t(b)             P_%d = %f\n", full_rank - 1, p_31);
 	if (io_ret <= 0) {
 		return false;
 	}
-	io_ret = fprintf(stream, "\t\t(c)             P_%d = %f\n", NUMBER_OF_ROWS_RANK - 2, p_30);
+	io_ret = fprintf(stream, "\t\t(c)             P_%d = %f\n", full_rank - 2, p_30);
 	if (io_ret <= 0) {
 		return false;
 	}
-	io_ret = fprintf(stream, "\t\t(d) Frequency   F_%d = %ld\n", NUMBER_OF_ROWS_RANK, stat->F_M);
+	io_ret = fprintf(stream, "\t\t(d) Frequency   F_%d = %ld\n", full_rank, stat->F_M);
 	if (io_ret <= 0) {
 		return false;
 	}
-	io_ret = fprintf(stream, "\t\t(e)             F_%d = %ld\n", NUMBER_OF_ROWS_RANK - 1, stat->F_M_minus_one);
+	io_ret = fprintf(stream, "\t\t(e)             F_%d = %ld\n", full_rank - 1, stat->F_M_minus_one);
 	if (io_ret <= 0) {
 		return false;
 	}
-	io_ret = fprintf(stream, "\t\t(f)             F_%d = %ld\n", NUMBER_OF_ROWS_RANK - 2, stat->F_remaining);
+	io_ret = fprintf(stream, "\t\t(f)             F_%d = %ld\n", full_rank - 2, stat->F_remaining);
 	if (io_ret <= 0) {
 		return false;
 	}
@@ -496,13 +595,13 @@ Rank_print_stat(FILE * stream, struct state *state, struct Rank_private_stats *s
 	}
 	if (state->legacy_output == true) {
 		io_ret = fprintf(stream, "\t\t(i) NOTE: %ld BITS WERE DISCARDED.\n",
-				 state->tp.n % (NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK));
+				 state->tp.n % ((long int) M * (long int) Q));
 		if (io_ret <= 0) {
 			return false;
 		}
 	} else {
 		io_ret = fprintf(stream, "\t\t(i) %ld bits were discarded\n",
-				 state->tp.n % (NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK));
+				 state->tp.n % ((long int) M * (long int) Q));
 		if (io_ret <= 0) {
 			return false;
 		}
@@ -1135,22 +1234,32 @@ Rank_destroy(struct state *state)
 	/*
 	 * Free the matrices for each thread
 	 */
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->rank_matrix[i] != NULL) {
-			for (j = 0; j < NUMBER_OF_ROWS_RANK; j++) {
-				if (state->rank_matrix[i][j] != NULL) {
-					free(state->rank_matrix[i][j]);
-					state->rank_matrix[i][j] = NULL;
+	if (state->rank_matrix != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			if (state->rank_matrix[i] != NULL) {
+				for (j = 0; j < M; j++) {
+					if (state->rank_matrix[i][j] != NULL) {
+						free(state->rank_matrix[i][j]);
+						state->rank_matrix[i][j] = NULL;
+					}
 				}
+				free(state->rank_matrix[i]);
+				state->rank_matrix[i] = NULL;
 			}
-			free(state->rank_matrix[i]);
-			state->rank_matrix[i] = NULL;
 		}
-	}
-	if (state->rank_matrix != NULL) {
 		free(state->rank_matrix);
 		state->rank_matrix = NULL;
 	}
+	if (state->rank_rows != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			if (state->rank_rows[i] != NULL) {
+				free(state->rank_rows[i]);
+				state->rank_rows[i] = NULL;
+			}
+		}
+		free(state->rank_rows);
+		state->rank_rows = NULL;
+	}
 
 	return;
 }
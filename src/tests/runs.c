@@ -37,6 +37,7 @@
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -70,6 +71,7 @@ static double two_over_sqrtn;			// 2 / Square root of n
 static bool Runs_print_stat(FILE * stream, struct state *state, struct Runs_private_stats *stat, double p_value);
 static bool Runs_print_p_value(FILE * stream, double p_value);
 static void Runs_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
+static long int Runs_count_changes(const WORD64 *w, long int n, long int *ones);
 
 
 /*
@@ -174,6 +176,7 @@ Runs_iterate(struct thread_state *thread_state)
 	struct Runs_private_stats stat;	// Stats for this iteration
 	long int n;			// Length of a single bit stream
 	long int S;			// Number of 1 bits in the sequence
+	long int changes;		// Number of bits that differ from the bit before them
 	double p_value;			// p_value iteration test result(s)
 	long int k;
 
@@ -191,11 +194,14 @@ Runs_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(181, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(181, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(181, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(181, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(181, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->cSetup != true) {
 		err(181, __func__, "test constants not setup prior to calling %s for %s[%d]",
@@ -209,12 +215,20 @@ Runs_iterate(struct thread_state *thread_state)
 
 	/*
 	 * Step 1: determine the proportion of ones in the input sequence
+	 *
+	 * The number of runs, which step 3 needs, is the number of changes between adjacent bits plus one.
+	 * Both counts are found in the same pass over the bit stream.
 	 */
 	S = 0;
-	for (k = 0; k < n; k++) {
-		if (state->epsilon[thread_state->thread_id][k]) {
-			S++;
+	changes = 0;
+	if (state->byteEpsilon == true) {
+		S = state->epsilon[thread_state->thread_id][0];
+		for (k = 1; k < n; k++) {
+			S += state->epsilon[thread_state->thread_id][k];
+			changes += state->epsilon[thread_state->thread_id][k] ^ state->epsilon[thread_state->thread_id][k - 1];
 		}
+	} else {
+		changes = Runs_count_changes(state->packedEpsilon[thread_state->thread_id], n, &S);
 	}
 	stat.pi = (double) S / (double) n;
 
@@ -231,12 +245,7 @@ Runs_iterate(struct thread_state *thread_state)
 		/*
 		 * Step 3: compute the test statistic
 		 */
-		stat.V_n = 1;
-		for (k = 1; k < n; k++) {
-			if (state->epsilon[thread_state->thread_id][k] != state->epsilon[thread_state->thread_id][k - 1]) {
-				stat.V_n++;
-			}
-		}
+		stat.V_n = changes + 1;
 
 		/*
 		 * Step 4: compute the test P-value
@@ -1093,3 +1102,49 @@ Runs_destroy(struct state *state)
 
 	return;
 }
+
+
+/*
+ * Runs_count_changes - count the 1 bits and the changes between adjacent bits of a packed bit stream
+ *
+ * given:
+ *      w               // packed bit stream
+ *      n               // number of bits in the bit stream, n > 0
+ *      ones            // where to store the number of 1 bits
+ *
+ * returns:
+ *      Number of bits k, 0 < k < n, that differ from bit k-1
+ *
+ * The bit that precedes each bit of a word is found by shifting the word right by one, with the
+ * last bit of the previous word carried into the most significant bit.  For the first word, its
+ * own first bit is carried in, so the first bit of the stream never counts as a change.
+ * Bits beyond n are 0 and are masked from the changes of the last word.
+ */
+static long int
+Runs_count_changes(const WORD64 *w, long int n, long int *ones)
+{
+	long int words;		// Number of words that hold the n bits
+	long int count;		// Number of 1 bits
+	long int changes;	// Number of changes between adjacent bits
+	WORD64 carry;		// Bit preceding the current word, as its most significant bit
+	WORD64 diff;		// Bits of a word that differ from the bit before them
+	long int i;
+
+	words = WORD64_COUNT(n);
+	count = 0;
+	changes = 0;
+	carry = w[0] & ((WORD64) 1 << (BITS_N_WORD64 - 1));
+	for (i = 0; i < words - 1; i++) {
+		diff = w[i] ^ ((w[i] >> 1) | carry);
+		count += popcount64(w[i]);
+		changes += popcount64(diff);
+		carry = w[i] << (BITS_N_WORD64 - 1);
+	}
+	diff = w[i] ^ ((w[i] >> 1) | carry);
+	diff &= ~(WORD64) 0 << (BITS_N_WORD64 - 1 - (n - 1) % BITS_N_WORD64);
+	count += popcount64(w[i]);
+	changes += popcount64(diff);
+	*ones = count;
+
+	return changes;
+}
@@ -38,6 +38,7 @@
 #include "../utils/utilities.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/bitstream.h"
 
 
 /*
@@ -282,11 +283,14 @@ Universal_iterate(struct thread_state *thread_state)
 		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
 		return;
 	}
-	if (state->epsilon == NULL) {
-		err(201, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(201, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(201, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(201, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(201, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (state->universal_T == NULL) {
 		err(201, __func__, "state->universal_T is NULL");
@@ -337,9 +341,13 @@ Universal_iterate(struct thread_state *thread_state)
 		 * It is convenient to use this representation because we can store and
 		 * have access to the contents of each block in the table T with size 2^L.
 		 */
-		decRep = 0;
-		for (j = 0; j < L; j++) {
-			decRep += state->epsilon[thread_state->thread_id][(i - 1) * L + j] * ((long int) 1 << (L - 1 - j));
+		if (state->byteEpsilon == true) {
+			decRep = 0;
+			for (j = 0; j < L; j++) {
+				decRep += state->epsilon[thread_state->thread_id][(i - 1) * L + j] * ((long int) 1 << (L - 1 - j));
+			}
+		} else {
+			decRep = (long int) packedBits(state->packedEpsilon[thread_state->thread_id], (i - 1) * L, (int) L);
 		}
 
 		/*
@@ -357,9 +365,13 @@ Universal_iterate(struct thread_state *thread_state)
 		/*
 		 * Get decimal representation of the block
 		 */
-		decRep = 0;
-		for (j = 0; j < L; j++) {
-			decRep += state->epsilon[thread_state->thread_id][(i - 1) * L + j] * ((long int) 1 << (L - 1 - j));
+		if (state->byteEpsilon == true) {
+			decRep = 0;
+			for (j = 0; j < L; j++) {
+				decRep += state->epsilon[thread_state->thread_id][(i - 1) * L + j] * ((long int) 1 << (L - 1 - j));
+			}
+		} else {
+			decRep = (long int) packedBits(state->packedEpsilon[thread_state->thread_id], (i - 1) * L, (int) L);
 		}
 
 		/*
@@ -0,0 +1,355 @@
+/*****************************************************************************
+	        A S C I I   R A N D D A T A   O F F S E T   I N D E X
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 95 thru 99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include "../utils/externs.h"
+#include "ascii_index.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static struct ascii_index *read_ascii_index(char *path, struct stat *statbuf);
+static struct ascii_index *build_ascii_index(struct state *state, struct stat *statbuf);
+static void write_ascii_index(char *path, struct ascii_index *index, struct stat *statbuf);
+
+
+/*
+ * load_ascii_index - load the index of ASCII randdata, building it first if needed
+ *
+ * given:
+ *      state           // pointer to run state
+ *
+ * The index is read from randdata.idx when that file matches the size and modification time
+ * of randdata.  Otherwise randdata is scanned once to build the index, which is then saved
+ * to randdata.idx for later runs and -j jobs.  Failing to save the index is not fatal.
+ *
+ * NOTE: This function does NOT return on error.
+ */
+void
+load_ascii_index(struct state *state)
+{
+	struct stat statbuf;	// Status of randdata
+	char *path;		// Path of the index file
+	size_t len;		// Length of the index file path
+	struct ascii_index *index;	// Loaded index
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(95, __func__, "state arg is NULL");
+	}
+	if (state->randomDataPath == NULL) {
+		err(95, __func__, "state->randomDataPath is NULL");
+	}
+	if (stat(state->randomDataPath, &statbuf) != 0) {
+		errp(95, __func__, "cannot stat: %s", state->randomDataPath);
+	}
+
+	/*
+	 * Form the path of the index file
+	 */
+	len = strlen(state->randomDataPath) + sizeof(".idx");
+	path = malloc(len);
+	if (path == NULL) {
+		errp(95, __func__, "cannot malloc of %ld bytes for index path", (long int) len);
+	}
+	snprintf(path, len, "%s.idx", state->randomDataPath);
+
+	/*
+	 * Reuse the index file, or build and save the index
+	 */
+	index = read_ascii_index(path, &statbuf);
+	if (index != NULL) {
+		dbg(DBG_LOW, "read ASCII index of %ld checkpoints from %s", index->count, path);
+	} else {
+		dbg(DBG_LOW, "building ASCII index of %s", state->randomDataPath);
+		index = build_ascii_index(state, &statbuf);
+		write_ascii_index(path, index, &statbuf);
+		dbg(DBG_LOW, "built ASCII index of %ld checkpoints", index->count);
+	}
+	state->asciiIndex = index;
+	free(path);
+
+	return;
+}
+
+
+/*
+ * free_ascii_index - free the index of ASCII randdata
+ *
+ * given:
+ *      state           // pointer to run state
+ */
+void
+free_ascii_index(struct state *state)
+{
+	if (state == NULL || state->asciiIndex == NULL) {
+		return;
+	}
+
+	if (state->asciiIndex->offset != NULL) {
+		free(state->asciiIndex->offset);
+		state->asciiIndex->offset = NULL;
+	}
+	free(state->asciiIndex);
+	state->asciiIndex = NULL;
+
+	return;
+}
+
+
+/*
+ * ascii_index_seek - find where to start parsing ASCII randdata to reach a given bit
+ *
+ * given:
+ *      index           // ASCII index
+ *      bit             // randdata bit number to reach
+ *      skip            // where to store the number of bits to parse and discard before reaching bit
+ *
+ * returns:
+ *      File offset of the checkpoint at or before bit, or the size of randdata if bit is beyond its end
+ */
+long int
+ascii_index_seek(const struct ascii_index *index, long int bit, long int *skip)
+{
+	long int checkpoint;	// Index of the checkpoint at or before bit
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (index == NULL) {
+		err(96, __func__, "index arg is NULL");
+	}
+	if (skip == NULL) {
+		err(96, __func__, "skip arg is NULL");
+	}
+	if (bit < 0) {
+		err(96, __func__, "bit: %ld must be >= 0", bit);
+	}
+
+	checkpoint = bit / index->interval;
+	if (checkpoint >= index->count) {
+		*skip = 0;
+		return index->fileSize;
+	}
+	*skip = bit % index->interval;
+
+	return index->offset[checkpoint];
+}
+
+
+/*
+ * read_ascii_index - read an index file that matches randdata
+ *
+ * given:
+ *      path            // path of the index file
+ *      statbuf         // status of randdata
+ *
+ * returns:
+ *      The index, or NULL if the file is missing, unreadable or does not match randdata
+ */
+static struct ascii_index *
+read_ascii_index(char *path, struct stat *statbuf)
+{
+	struct ascii_index_header header;	// Header of the index file
+	struct ascii_index *index;	// Index read
+	FILE *stream;		// Open index file
+
+	stream = fopen(path, "rb");
+	if (stream == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * The index must have been built for this randdata with the current interval
+	 */
+	if (fread(&header, sizeof(header), 1, stream) != 1 ||
+	    memcmp(header.magic, ASCII_INDEX_MAGIC, sizeof(ASCII_INDEX_MAGIC)) != 0 ||
+	    header.fileSize != (long int) statbuf->st_size || header.fileMtime != (long int) statbuf->st_mtime ||
+	    header.interval != ASCII_INDEX_INTERVAL || header.count < 0 ||
+	    header.count > header.fileSize / ASCII_INDEX_INTERVAL + 1) {
+		dbg(DBG_LOW, "ignoring out of date or invalid ASCII index: %s", path);
+		fclose(stream);
+		return NULL;
+	}
+
+	/*
+	 * Read the offsets
+	 */
+	index = malloc(sizeof(*index));
+	if (index == NULL) {
+		errp(97, __func__, "cannot malloc of %ld bytes for index", sizeof(*index));
+	}
+	index->offset = malloc((size_t) (header.count + 1) * sizeof(index->offset[0]));
+	if (index->offset == NULL) {
+		errp(97, __func__, "cannot malloc of %ld elements of %ld bytes each for index->offset",
+		     header.count + 1, sizeof(index->offset[0]));
+	}
+	if (fread(index->offset, sizeof(index->offset[0]), (size_t) header.count, stream) != (size_t) header.count) {
+		dbg(DBG_LOW, "ignoring truncated ASCII index: %s", path);
+		free(index->offset);
+		free(index);
+		fclose(stream);
+		return NULL;
+	}
+	index->count = header.count;
+	index->interval = header.interval;
+	index->fileSize = header.fileSize;
+	fclose(stream);
+
+	return index;
+}
+
+
+/*
+ * build_ascii_index - scan ASCII randdata and record the offset of every checkpoint
+ *
+ * given:
+ *      state           // pointer to run state
+ *      statbuf         // status of randdata
+ *
+ * returns:
+ *      The index
+ *
+ * NOTE: This function does NOT return on error.
+ */
+static struct ascii_index *
+build_ascii_index(struct state *state, struct stat *statbuf)
+{
+	struct ascii_index *index;	// Index to build
+	unsigned char *chunk;	// Chunk of randdata
+	long int maxCount;	// Most checkpoints randdata can hold, each bit takes at least 1 byte
+	long int offset;	// File offset of chunk
+	long int bits;		// Number of bits found so far
+	size_t len;		// Number of bytes in chunk
+	size_t i;
+	FILE *stream;		// Open randdata
+	int ch;
+
+	/*
+	 * Allocate the index
+	 */
+	index = malloc(sizeof(*index));
+	if (index == NULL) {
+		errp(98, __func__, "cannot malloc of %ld bytes for index", sizeof(*index));
+	}
+	maxCount = (long int) statbuf->st_size / ASCII_INDEX_INTERVAL + 1;
+	index->offset = malloc((size_t) (maxCount + 1) * sizeof(index->offset[0]));
+	if (index->offset == NULL) {
+		errp(98, __func__, "cannot malloc of %ld elements of %ld bytes each for index->offset",
+		     maxCount + 1, sizeof(index->offset[0]));
+	}
+	index->count = 0;
+	index->interval = ASCII_INDEX_INTERVAL;
+	index->fileSize = (long int) statbuf->st_size;
+	chunk = malloc(ASCII_CHUNK_SIZE);
+	if (chunk == NULL) {
+		errp(98, __func__, "cannot malloc of %d bytes for chunk", ASCII_CHUNK_SIZE);
+	}
+
+	/*
+	 * Record the offset of every interval-th '0' or '1' character
+	 */
+	stream = fopen(state->randomDataPath, "rb");
+	if (stream == NULL) {
+		errp(98, __func__, "cannot open for reading: %s", state->randomDataPath);
+	}
+	bits = 0;
+	for (offset = 0; (len = fread(chunk, 1, ASCII_CHUNK_SIZE, stream)) > 0; offset += (long int) len) {
+		for (i = 0; i < len; i++) {
+			ch = chunk[i];
+			if (ch == '0' || ch == '1') {
+				if (bits % ASCII_INDEX_INTERVAL == 0 && index->count < maxCount) {
+					index->offset[index->count++] = offset + (long int) i;
+				}
+				bits++;
+			} else if (!isspace(ch)) {
+				err(98, __func__, "character 0x%02x found in file %s after %ld bits were read: ASCII data must be 0 or 1",
+				    ch, state->randomDataPath, bits);
+			}
+		}
+	}
+	if (ferror(stream)) {
+		errp(98, __func__, "read error while reading file: %s", state->randomDataPath);
+	}
+	fclose(stream);
+	free(chunk);
+
+	return index;
+}
+
+
+/*
+ * write_ascii_index - save an index next to randdata
+ *
+ * given:
+ *      path            // path of the index file
+ *      index           // index to save
+ *      statbuf         // status of randdata
+ *
+ * A partially written index file is removed.  Failing to save the index only warns.
+ */
+static void
+write_ascii_index(char *path, struct ascii_index *index, struct stat *statbuf)
+{
+	struct ascii_index_header header;	// Header of the index file
+	FILE *stream;		// Open index file
+	bool written;		// true ==> the whole index was written
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ASCII_INDEX_MAGIC, sizeof(ASCII_INDEX_MAGIC));
+	header.fileSize = (long int) statbuf->st_size;
+	header.fileMtime = (long int) statbuf->st_mtime;
+	header.interval = index->interval;
+	header.count = index->count;
+
+	stream = fopen(path, "wb");
+	if (stream == NULL) {
+		warnp(__func__, "cannot save ASCII index: %s", path);
+		return;
+	}
+	written = (fwrite(&header, sizeof(header), 1, stream) == 1 &&
+		   fwrite(index->offset, sizeof(index->offset[0]), (size_t) index->count, stream) == (size_t) index->count);
+	if (fclose(stream) != 0 || written == false) {
+		warnp(__func__, "cannot save ASCII index: %s", path);
+		remove(path);
+		return;
+	}
+	dbg(DBG_LOW, "saved ASCII index to %s", path);
+
+	return;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+	        A S C I I   R A N D D A T A   O F F S E T   I N D E X
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef ASCII_INDEX_H
+#   define ASCII_INDEX_H
+
+#include "../utils/defs.h"
+
+/*
+ * ASCII offset index
+ *
+ * ASCII randdata may hold whitespace, such as newlines, between its '0' and '1' characters,
+ * so bit i of the data is not found at file offset i.  The index holds the file offset of
+ * every ASCII_INDEX_INTERVAL-th bit.  To seek to a bit, seek to the checkpoint before it
+ * and parse the less than ASCII_INDEX_INTERVAL bits from there.
+ *
+ * The index is saved next to randdata as randdata.idx: a struct ascii_index_header followed
+ * by count offsets, all as long int in host byte order.  The index is a cache for the host
+ * that built it; an index file that does not match the current randdata is rebuilt.
+ */
+#   define ASCII_INDEX_MAGIC "sts-ascii-idx-1"	// Identifies an index file, with its NUL fills magic[]
+
+struct ascii_index_header {
+	char magic[16];			// ASCII_INDEX_MAGIC
+	long int fileSize;		// Size of randdata when the index was built
+	long int fileMtime;		// Modification time of randdata when the index was built
+	long int interval;		// Number of bits between checkpoints
+	long int count;			// Number of checkpoints that follow the header
+};
+
+struct ascii_index {
+	long int *offset;		// File offset of bit i * interval, for i = 0 thru count-1
+	long int count;			// Number of checkpoints
+	long int interval;		// Number of bits between checkpoints
+	long int fileSize;		// Size of randdata
+};
+
+extern void load_ascii_index(struct state *state);
+extern void free_ascii_index(struct state *state);
+extern long int ascii_index_seek(const struct ascii_index *index, long int bit, long int *skip);
+
+#endif				/* ASCII_INDEX_H */
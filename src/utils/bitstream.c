@@ -0,0 +1,578 @@
+/*****************************************************************************
+	  P A C K E D   B I T S T R E A M   R O U T I N E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 80 thru 89
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "bitstream.h"
+#include "debug.h"
+
+
+/*
+ * Expansion of a byte into 8 BitSequence values, most significant bit first
+ */
+#define BYTE_BITS(b) { ((b) >> 7) & 1, ((b) >> 6) & 1, ((b) >> 5) & 1, ((b) >> 4) & 1, \
+		       ((b) >> 3) & 1, ((b) >> 2) & 1, ((b) >> 1) & 1, (b) & 1 }
+#define BYTE_BITS_4(b) BYTE_BITS(b), BYTE_BITS((b) + 1), BYTE_BITS((b) + 2), BYTE_BITS((b) + 3)
+#define BYTE_BITS_16(b) BYTE_BITS_4(b), BYTE_BITS_4((b) + 4), BYTE_BITS_4((b) + 8), BYTE_BITS_4((b) + 12)
+#define BYTE_BITS_64(b) BYTE_BITS_16(b), BYTE_BITS_16((b) + 16), BYTE_BITS_16((b) + 32), BYTE_BITS_16((b) + 48)
+
+static const BitSequence byte_bits[256][BITS_N_BYTE] = {
+	BYTE_BITS_64(0), BYTE_BITS_64(64), BYTE_BITS_64(128), BYTE_BITS_64(192)
+};
+
+
+/*
+ * Random walk over the 8 bits of a byte, most significant bit first, relative to its starting point
+ *
+ * The 256 entries take 768 bytes, so the table stays in the L1 cache while a bit stream is walked.
+ */
+struct walk_step {
+	signed char delta;	// partial sum after the 8 bits
+	signed char max;	// largest of the 8 partial sums
+	signed char min;	// smallest of the 8 partial sums
+};
+
+static struct walk_step walk_step[256];
+static pthread_once_t walk_step_once = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Forward static function declarations
+ */
+static void build_walk_step(void);
+
+
+/*
+ * create_packed_bits - allocate a zeroized packed bit stream
+ *
+ * given:
+ *      n       // number of bits the packed bit stream must hold
+ *
+ * returns:
+ *      An allocated array of WORD64_COUNT(n) words plus one zero padding word.
+ *
+ * NOTE: This function does NOT return on error.
+ */
+WORD64 *
+create_packed_bits(long int n)
+{
+	WORD64 *w;		// packed bit stream to return
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (n <= 0) {
+		err(80, __func__, "number of bits: %ld must be > 0", n);
+	}
+
+	/*
+	 * Allocate the words plus the padding word
+	 */
+	w = calloc((size_t) WORD64_COUNT(n) + 1, sizeof(w[0]));
+	if (w == NULL) {
+		errp(80, __func__, "cannot calloc of %ld elements of %ld bytes each for packed bit stream",
+		     WORD64_COUNT(n) + 1, sizeof(w[0]));
+	}
+
+	return w;
+}
+
+
+/*
+ * unpackBits - expand part of a packed bit stream into one BitSequence per bit
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit to expand
+ *      len     // number of bits to expand
+ *      bits    // where to store the len expanded bits
+ *
+ * This function is used by code that still needs the historic one byte per bit
+ * representation of (part of) a bit stream.
+ */
+void
+unpackBits(const WORD64 *w, long int pos, long int len, BitSequence *bits)
+{
+	WORD64 word;		// next up to 64 bits to expand
+	int count;		// number of bits held in word
+	long int i;
+	int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(81, __func__, "w arg is NULL");
+	}
+	if (bits == NULL) {
+		err(81, __func__, "bits arg is NULL");
+	}
+	if (pos < 0 || len < 0) {
+		err(81, __func__, "pos: %ld and len: %ld must be >= 0", pos, len);
+	}
+
+	/*
+	 * Expand up to 64 bits at a time
+	 */
+	for (i = 0; i < len; i += count) {
+		count = (int) MIN(len - i, BITS_N_WORD64);
+		word = packedBits(w, pos + i, count);
+		for (j = count - 1; j >= 0; j--) {
+			bits[i + j] = (BitSequence) (word & 1);
+			word >>= 1;
+		}
+	}
+
+	return;
+}
+
+
+/*
+ * countOnes - count the 1 bits in a range of a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit to count
+ *      len     // number of bits to count
+ *
+ * returns:
+ *      Number of 1 bits in bits pos thru pos + len - 1
+ *
+ * Whole words are counted with one popcount each.  The range need not start or end at a word
+ * boundary, the words at either end are masked down to the bits of the range.
+ */
+long int
+countOnes(const WORD64 *w, long int pos, long int len)
+{
+	WORD64 headMask;	// bits of the first word that are in the range
+	WORD64 tailMask;	// bits of the last word that are in the range
+	long int first;		// index of the first word of the range
+	long int last;		// index of the last word of the range
+	long int ones;		// number of 1 bits counted
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(85, __func__, "w arg is NULL");
+	}
+	if (pos < 0 || len < 0) {
+		err(85, __func__, "pos: %ld and len: %ld must be >= 0", pos, len);
+	}
+	if (len == 0) {
+		return 0;
+	}
+
+	first = pos / BITS_N_WORD64;
+	last = (pos + len - 1) / BITS_N_WORD64;
+	headMask = ~(WORD64) 0 >> (pos % BITS_N_WORD64);
+	tailMask = ~(WORD64) 0 << (BITS_N_WORD64 - 1 - (pos + len - 1) % BITS_N_WORD64);
+	if (first == last) {
+		return popcount64(w[first] & headMask & tailMask);
+	}
+	ones = popcount64(w[first] & headMask);
+	for (i = first + 1; i < last; i++) {
+		ones += popcount64(w[i]);
+	}
+	ones += popcount64(w[last] & tailMask);
+
+	return ones;
+}
+
+
+/*
+ * longestOnesRun - find the longest run of 1 bits in a range of a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit of the range
+ *      len     // number of bits in the range
+ *
+ * returns:
+ *      Length of the longest run of consecutive 1 bits in bits pos thru pos + len - 1
+ *
+ * The range is taken up to 64 bits at a time.  The run carried in from the previous bits is
+ * extended by the leading 1 bits of each chunk, found with a count of leading zeros.  The longest
+ * run within a chunk is the number of times x &= x << 1 takes to clear it, and the run carried
+ * out of a chunk is its trailing 1 bits, found with a count of trailing zeros.
+ */
+long int
+longestOnesRun(const WORD64 *w, long int pos, long int len)
+{
+	WORD64 x;		// next up to 64 bits of the range, right justified
+	WORD64 y;		// x with each run of 1 bits shortened k times
+	long int longest;	// longest run found so far
+	long int run;		// length of the run of 1 bits that ends with the last bit taken so far
+	int count;		// number of bits in x
+	int k;
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(86, __func__, "w arg is NULL");
+	}
+	if (pos < 0 || len < 0) {
+		err(86, __func__, "pos: %ld and len: %ld must be >= 0", pos, len);
+	}
+
+	longest = 0;
+	run = 0;
+	for (i = 0; i < len; i += count) {
+		count = (int) MIN(len - i, BITS_N_WORD64);
+		x = packedBits(w, pos + i, count);
+		if (x == 0) {
+			run = 0;
+		} else if (x == ~(WORD64) 0 >> (BITS_N_WORD64 - count)) {
+			run += count;
+			longest = MAX(longest, run);
+		} else {
+			run += clz64(~(x << (BITS_N_WORD64 - count)));
+			longest = MAX(longest, run);
+			for (y = x, k = 0; y != 0; k++) {
+				y &= y << 1;
+			}
+			longest = MAX(longest, k);
+			run = ctz64(~x);
+		}
+	}
+
+	return longest;
+}
+
+
+/*
+ * build_walk_step - fill the walk_step table, called once thru pthread_once()
+ */
+static void
+build_walk_step(void)
+{
+	int S;			// partial sum within a byte
+	int b;
+	int i;
+
+	for (b = 0; b < 256; b++) {
+		S = 0;
+		walk_step[b].max = -BITS_N_BYTE;
+		walk_step[b].min = BITS_N_BYTE;
+		for (i = BITS_N_BYTE - 1; i >= 0; i--) {
+			S += ((b >> i) & 1) ? 1 : -1;
+			walk_step[b].max = (signed char) MAX(walk_step[b].max, S);
+			walk_step[b].min = (signed char) MIN(walk_step[b].min, S);
+		}
+		walk_step[b].delta = (signed char) S;
+	}
+
+	return;
+}
+
+
+/*
+ * randomWalk - advance a random walk over a range of a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit to walk
+ *      len     // number of bits to walk
+ *      walk    // walk to advance, see struct random_walk in bitstream.h
+ *
+ * Bits up to a byte boundary, and the bits after the last whole byte, are walked one at a time.
+ * Each whole byte is walked with a single lookup of its net step and its largest and smallest
+ * partial sums in the walk_step table.
+ */
+void
+randomWalk(const WORD64 *w, long int pos, long int len, struct random_walk *walk)
+{
+	const struct walk_step *step;	// walk over the current byte
+	long int S;		// partial sum
+	long int max;		// largest partial sum
+	long int min;		// smallest partial sum
+	long int end;		// index of the bit after the range
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(87, __func__, "w arg is NULL");
+	}
+	if (walk == NULL) {
+		err(87, __func__, "walk arg is NULL");
+	}
+	if (pos < 0 || len < 0) {
+		err(87, __func__, "pos: %ld and len: %ld must be >= 0", pos, len);
+	}
+	pthread_once(&walk_step_once, build_walk_step);
+
+	S = walk->S;
+	max = walk->max;
+	min = walk->min;
+	end = pos + len;
+
+	/*
+	 * Walk bit by bit up to a byte boundary
+	 */
+	for (i = pos; i < end && (i % BITS_N_BYTE) != 0; i++) {
+		S += 2 * PACKED_BIT(w, i) - 1;
+		max = MAX(max, S);
+		min = MIN(min, S);
+	}
+
+	/*
+	 * Walk whole bytes
+	 */
+	for (; i + BITS_N_BYTE <= end; i += BITS_N_BYTE) {
+		step = &walk_step[(w[i / BITS_N_WORD64] >> (BITS_N_WORD64 - BITS_N_BYTE - i % BITS_N_WORD64)) & 0xff];
+		max = MAX(max, S + step->max);
+		min = MIN(min, S + step->min);
+		S += step->delta;
+	}
+
+	/*
+	 * Walk the bits after the last whole byte
+	 */
+	for (; i < end; i++) {
+		S += 2 * PACKED_BIT(w, i) - 1;
+		max = MAX(max, S);
+		min = MIN(min, S);
+	}
+
+	walk->S = S;
+	walk->max = max;
+	walk->min = min;
+
+	return;
+}
+
+
+/*
+ * packBytes - pack whole words of raw binary bytes into a packed bit stream
+ *
+ * given:
+ *      x       // raw binary bytes, 8 bits per byte, most significant bit first
+ *      shift   // bit of x[0] where the first word starts, 0 thru 7 from its most significant bit
+ *      words   // number of words to pack
+ *      w       // where to store the words
+ *
+ * returns:
+ *      Number of 1 bits packed
+ *
+ * Each group of 8 bytes is one word in big endian order, see the layout in bitstream.h.
+ * When shift is not 0, each word is funnel shifted with the first bits of the byte that follows,
+ * so 8 * words + 1 bytes of x are used.
+ */
+long int
+packBytes(const BYTE *x, int shift, long int words, WORD64 *w)
+{
+	long int ones;		// number of 1 bits packed
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (x == NULL) {
+		err(82, __func__, "x arg is NULL");
+	}
+	if (w == NULL) {
+		err(82, __func__, "w arg is NULL");
+	}
+	if (shift < 0 || shift >= BITS_N_BYTE) {
+		err(82, __func__, "shift: %d must be >= 0 and < %d", shift, BITS_N_BYTE);
+	}
+
+	/*
+	 * Assemble each word, compilers turn this into a single byte swapping load
+	 */
+	ones = 0;
+	for (i = 0; i < words; i++, x += sizeof(WORD64)) {
+		w[i] = ((WORD64) x[0] << 56) | ((WORD64) x[1] << 48) | ((WORD64) x[2] << 40) | ((WORD64) x[3] << 32) |
+		       ((WORD64) x[4] << 24) | ((WORD64) x[5] << 16) | ((WORD64) x[6] << 8) | (WORD64) x[7];
+		if (shift != 0) {
+			w[i] = (w[i] << shift) | (WORD64) (x[8] >> (BITS_N_BYTE - shift));
+		}
+		ones += popcount64(w[i]);
+	}
+
+	return ones;
+}
+
+
+/*
+ * expandBytes - expand raw binary bytes into one BitSequence per bit
+ *
+ * given:
+ *      x       // raw binary bytes, 8 bits per byte, most significant bit first
+ *      nbytes  // number of bytes to expand
+ *      bits    // where to store the 8 * nbytes expanded bits
+ *
+ * Each byte is expanded with a single copy from a 256 entry table.
+ */
+void
+expandBytes(const BYTE *x, long int nbytes, BitSequence *bits)
+{
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (x == NULL) {
+		err(83, __func__, "x arg is NULL");
+	}
+	if (bits == NULL) {
+		err(83, __func__, "bits arg is NULL");
+	}
+
+	for (i = 0; i < nbytes; i++) {
+		memcpy(bits + i * BITS_N_BYTE, byte_bits[x[i]], BITS_N_BYTE);
+	}
+
+	return;
+}
+
+
+/*
+ * formatWordBytes - number of bytes in the words of a raw binary format
+ *
+ * given:
+ *      format  // -F format of randdata
+ *
+ * returns:
+ *      4 or 8 for a format of 32 or 64 bit little endian words, 1 for a format of bytes
+ *
+ * The bytes of a word are only in stream order once the whole word has been reordered,
+ * so randdata of a word format must be read in whole words.
+ */
+int
+formatWordBytes(enum format format)
+{
+	switch (format) {
+	case FORMAT_WORD32_LE:
+		return (int) sizeof(DBLWORD);
+	case FORMAT_WORD64_LE:
+		return (int) sizeof(WORD64);
+	default:
+		break;
+	}
+	return 1;
+}
+
+
+/*
+ * reorderBytes - put raw binary data into stream order, 8 bits per byte, most significant bit first
+ *
+ * given:
+ *      x       // raw binary data in the given format, reordered in place
+ *      nbytes  // number of bytes of x, a multiple of formatWordBytes(format)
+ *      format  // -F format of the data in x
+ *
+ * LSB first bytes are bit reversed and little endian words are byte swapped, 8 bytes at a time
+ * with shifts and masks on a WORD64, which compilers turn into vector shuffles.  Data in the
+ * FORMAT_RAW_BINARY format is already in stream order and is left unchanged.
+ */
+void
+reorderBytes(BYTE *x, long int nbytes, enum format format)
+{
+	WORD64 v;		// 8 bytes of x
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (x == NULL) {
+		err(84, __func__, "x arg is NULL");
+	}
+	if (nbytes < 0 || nbytes % formatWordBytes(format) != 0) {
+		err(84, __func__, "nbytes: %ld must be a non-negative multiple of %d", nbytes, formatWordBytes(format));
+	}
+
+	switch (format) {
+	case FORMAT_RAW_LSB:
+		/*
+		 * Reverse the bits of each byte: swap adjacent bits, then bit pairs, then nibbles
+		 */
+		for (i = 0; i + (long int) sizeof(WORD64) <= nbytes; i += sizeof(WORD64)) {
+			memcpy(&v, x + i, sizeof(v));
+			v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+			v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+			v = ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((v & 0x0f0f0f0f0f0f0f0fULL) << 4);
+			memcpy(x + i, &v, sizeof(v));
+		}
+		for (; i < nbytes; i++) {
+			x[i] = (BYTE) (((x[i] >> 1) & 0x55) | ((x[i] & 0x55) << 1));
+			x[i] = (BYTE) (((x[i] >> 2) & 0x33) | ((x[i] & 0x33) << 2));
+			x[i] = (BYTE) ((x[i] >> 4) | (x[i] << 4));
+		}
+		break;
+
+	case FORMAT_WORD32_LE:
+		/*
+		 * Reverse the bytes of each 32 bit word: swap adjacent bytes, then byte pairs
+		 */
+		for (i = 0; i + (long int) sizeof(WORD64) <= nbytes; i += sizeof(WORD64)) {
+			memcpy(&v, x + i, sizeof(v));
+			v = ((v >> 8) & 0x00ff00ff00ff00ffULL) | ((v & 0x00ff00ff00ff00ffULL) << 8);
+			v = ((v >> 16) & 0x0000ffff0000ffffULL) | ((v & 0x0000ffff0000ffffULL) << 16);
+			memcpy(x + i, &v, sizeof(v));
+		}
+		for (; i < nbytes; i += sizeof(DBLWORD)) {
+			BYTE t;
+			t = x[i], x[i] = x[i + 3], x[i + 3] = t;
+			t = x[i + 1], x[i + 1] = x[i + 2], x[i + 2] = t;
+		}
+		break;
+
+	case FORMAT_WORD64_LE:
+		/*
+		 * Reverse the bytes of each 64 bit word
+		 */
+		for (i = 0; i < nbytes; i += sizeof(WORD64)) {
+			memcpy(&v, x + i, sizeof(v));
+#if defined(__GNUC__) || defined(__clang__)
+			v = __builtin_bswap64(v);
+#else
+			v = ((v >> 8) & 0x00ff00ff00ff00ffULL) | ((v & 0x00ff00ff00ff00ffULL) << 8);
+			v = ((v >> 16) & 0x0000ffff0000ffffULL) | ((v & 0x0000ffff0000ffffULL) << 16);
+			v = (v >> 32) | (v << 32);
+#endif
+			memcpy(x + i, &v, sizeof(v));
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return;
+}
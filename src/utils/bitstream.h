@@ -0,0 +1,181 @@
+/*****************************************************************************
+	  P A C K E D   B I T S T R E A M   P R I M I T I V E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef BITSTREAM_H
+#   define BITSTREAM_H
+
+#include "../utils/defs.h"
+
+/*
+ * Packed bit stream layout
+ *
+ * A packed bit stream holds 64 bits per WORD64.  Bit i of the stream is found in word i / 64
+ * at bit position 63 - (i % 64), i.e., the first bit of the stream is the most significant
+ * bit of the first word.  This is the same order in which bits are taken from the bytes of
+ * a raw binary randdata file, so 8 consecutive input bytes form one word in big endian order.
+ *
+ * Unused bits at the end of the last word are always 0.  Packed bit streams are allocated
+ * with one extra zero padding word so that an unaligned read of up to 64 bits that starts
+ * inside the last word never reads beyond the allocation.
+ */
+#   define BITS_N_WORD64 (64)			// Number of bits in a WORD64
+#   define WORD64_COUNT(bits) (((bits) + BITS_N_WORD64 - 1) / BITS_N_WORD64)	// Words needed for bits
+#   define PACKED_BIT(w, i) ((int) (((w)[(i) / BITS_N_WORD64] >> (BITS_N_WORD64 - 1 - ((i) % BITS_N_WORD64))) & 1))
+
+
+/*
+ * Random walk of a packed bit stream
+ *
+ * Each 0 bit steps the walk down by 1 and each 1 bit steps it up by 1.  A walk is advanced over
+ * consecutive ranges of a bit stream with randomWalk(), which keeps the partial sum S and the
+ * largest and smallest partial sums seen, starting from S = max = min = 0.
+ */
+struct random_walk {
+	long int S;		// partial sum after the last bit walked
+	long int max;		// largest partial sum, including the starting point
+	long int min;		// smallest partial sum, including the starting point
+};
+
+
+/*
+ * popcount64 - count the number of 1 bits in a WORD64
+ *
+ * NOTE: On x86 compiled without -mpopcnt, the builtin is a library call that is slower than the
+ *	 shifts and masks below, which the compiler also vectorizes over loops of words.
+ */
+static inline int
+popcount64(WORD64 x)
+{
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__POPCNT__) || (!defined(__x86_64__) && !defined(__i386__)))
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+/*
+ * clz64 - count the leading 0 bits of a non-zero WORD64
+ */
+static inline int
+clz64(WORD64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_clzll(x);
+#else
+	int n;
+
+	for (n = 0; (x & ((WORD64) 1 << (BITS_N_WORD64 - 1))) == 0; n++) {
+		x <<= 1;
+	}
+	return n;
+#endif
+}
+
+
+/*
+ * ctz64 - count the trailing 0 bits of a non-zero WORD64
+ */
+static inline int
+ctz64(WORD64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(x);
+#else
+	int n;
+
+	for (n = 0; (x & 1) == 0; n++) {
+		x >>= 1;
+	}
+	return n;
+#endif
+}
+
+
+/*
+ * packedBits - extract up to 64 consecutive bits from a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream (allocated with its padding word)
+ *      pos     // index of the first bit to extract
+ *      len     // number of bits to extract, 1 <= len <= 64
+ *
+ * returns:
+ *      len bits starting at bit pos, right justified, the bit at pos being the most significant one
+ *
+ * NOTE: The two words that hold the bits are combined with a funnel shift, no bit loop is needed.
+ */
+static inline WORD64
+packedBits(const WORD64 *w, long int pos, int len)
+{
+	long int i = pos / BITS_N_WORD64;
+	int shift = (int) (pos % BITS_N_WORD64);
+	WORD64 x;
+
+	x = w[i] << shift;
+	if (shift != 0) {
+		x |= w[i + 1] >> (BITS_N_WORD64 - shift);
+	}
+	return x >> (BITS_N_WORD64 - len);
+}
+
+
+/*
+ * appendPackedBit - store the next bit of a packed bit stream that is filled in order
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the bit to store, all bits before pos have been stored already
+ *      bit     // 0 or 1
+ *
+ * The word is cleared when its first bit is stored, so the buffer need not be zeroized between iterations.
+ */
+static inline void
+appendPackedBit(WORD64 *w, long int pos, int bit)
+{
+	if ((pos % BITS_N_WORD64) == 0) {
+		w[pos / BITS_N_WORD64] = 0;
+	}
+	w[pos / BITS_N_WORD64] |= (WORD64) bit << (BITS_N_WORD64 - 1 - (pos % BITS_N_WORD64));
+}
+
+
+extern WORD64 *create_packed_bits(long int n);
+extern void unpackBits(const WORD64 *w, long int pos, long int len, BitSequence *bits);
+extern long int countOnes(const WORD64 *w, long int pos, long int len);
+extern long int longestOnesRun(const WORD64 *w, long int pos, long int len);
+extern void randomWalk(const WORD64 *w, long int pos, long int len, struct random_walk *walk);
+extern long int packBytes(const BYTE *x, int shift, long int words, WORD64 *w);
+extern void expandBytes(const BYTE *x, long int nbytes, BitSequence *bits);
+extern int formatWordBytes(enum format format);
+extern void reorderBytes(BYTE *x, long int nbytes, enum format format);
+
+#endif				/* BITSTREAM_H */
@@ -0,0 +1,1038 @@
+/*****************************************************************************
+	      C O M P R E S S E D   R A N D D A T A   D E C O D E R
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 235 thru 239
+
+// for fdopen(), pipe() and pthread_sigmask()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#if defined(HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(HAVE_LZMA)
+#include <lzma.h>
+#endif
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#include "../utils/externs.h"
+#include "decompress.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static enum compression detect_compression(const BYTE *buf, size_t length);
+static void *decode_thread(void *arg);
+static bool put_decompressed(struct decompressor *d, const BYTE *buf, size_t length);
+static size_t read_compressed(struct decompressor *d, BYTE *buf, size_t size);
+static void copy_uncompressed(struct decompressor *d, BYTE *in);
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+static size_t find_unit(enum compression compression, const BYTE *buf, size_t length, bool more, size_t *out_length);
+static void *unit_thread(void *arg);
+static void decode_units(struct decompressor *d, BYTE *in, BYTE *out);
+#endif
+#if defined(HAVE_ZLIB)
+static void decode_gzip(struct decompressor *d, BYTE *in, BYTE *out);
+#endif
+#if defined(HAVE_LZMA)
+static void decode_xz(struct decompressor *d, BYTE *in, BYTE *out);
+#endif
+#if defined(HAVE_ZSTD)
+static void decode_zstd(struct decompressor *d, BYTE *in, BYTE *out);
+#endif
+
+
+/*
+ * Names of the compression formats, indexed by enum compression
+ */
+static const char *const compression_name[] = {
+	"uncompressed", "gzip", "xz", "zstd",
+};
+
+/*
+ * Magic numbers of the compression formats
+ */
+static const BYTE gzip_magic[] = { 0x1f, 0x8b };
+static const BYTE xz_magic[DECOMPRESS_MAGIC] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+static const BYTE zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+
+/*
+ * open_decompressor - start decompressing randdata if it is compressed
+ *
+ * given:
+ *      state           // pointer to run state
+ *      skip            // number of decompressed bytes before the first bit to test
+ *
+ * returns:
+ *      true ==> randdata is compressed, or is a pipe whose first bytes were read to tell, and
+ *               state->streamFile now reads the decompressed, or copied, data
+ *      false ==> randdata is not compressed and state->streamFile is unchanged
+ *
+ * NOTE: This function does NOT return on error.
+ */
+bool
+open_decompressor(struct state *state, long int skip)
+{
+	struct decompressor *d;		// Decoder of the compressed randdata
+	struct stat statbuf;		// Status of the open randdata file
+	enum compression compression;	// Format of randdata
+	BYTE head[DECOMPRESS_MAGIC];	// First bytes of randdata
+	size_t length;			// Number of bytes in head
+	size_t kept;			// Number of bytes in head that cannot be read again from randdata
+	int c;				// First byte of a pipe
+	int fds[2];			// Read and write ends of the pipe
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(235, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(235, __func__, "streamFile arg is NULL");
+	}
+	if (skip < 0) {
+		err(235, __func__, "skip: %ld must be >= 0", skip);
+	}
+
+	/*
+	 * A regular file is checked for a magic number and then read again from its start
+	 *
+	 * A pipe, such as stdin, cannot be rewound.  A first byte that cannot start a magic number is
+	 * pushed back, which stdio allows for one byte, otherwise the bytes read are kept for the decoder.
+	 */
+	if (fstat(fileno(state->streamFile), &statbuf) != 0) {
+		return false;
+	}
+	if (S_ISREG(statbuf.st_mode) != 0) {
+		length = fread(head, 1, sizeof(head), state->streamFile);
+		rewind(state->streamFile);
+		kept = 0;
+	} else {
+		c = getc(state->streamFile);
+		if (c == EOF) {
+			return false;
+		}
+		if (c != gzip_magic[0] && c != xz_magic[0] && c != zstd_magic[0]) {
+			if (ungetc(c, state->streamFile) == EOF) {
+				err(235, __func__, "cannot push back the first byte of: %s", state->randomDataPath);
+			}
+			return false;
+		}
+		head[0] = (BYTE) c;
+		length = 1 + fread(head + 1, 1, sizeof(head) - 1, state->streamFile);
+		if (ferror(state->streamFile)) {
+			errp(235, __func__, "read error while reading file: %s", state->randomDataPath);
+		}
+		kept = length;
+	}
+	compression = detect_compression(head, length);
+	if (compression == COMPRESSION_NONE && kept == 0) {
+		return false;
+	}
+	switch (compression) {
+#if defined(HAVE_ZLIB)
+	case COMPRESSION_GZIP:
+#endif
+#if defined(HAVE_LZMA)
+	case COMPRESSION_XZ:
+#endif
+#if defined(HAVE_ZSTD)
+	case COMPRESSION_ZSTD:
+#endif
+	case COMPRESSION_NONE:
+		break;
+	default:
+		err(235, __func__, "randdata is %s compressed, but sts was compiled without %s support: %s",
+		    compression_name[compression], compression_name[compression], state->randomDataPath);
+	}
+	if (compression == COMPRESSION_NONE) {
+		dbg(DBG_LOW, "randdata is not compressed, will copy it after the %lu bytes read from it", kept);
+	} else {
+		dbg(DBG_LOW, "randdata is %s compressed, will decompress it while testing", compression_name[compression]);
+	}
+
+	/*
+	 * Setup the decoder
+	 */
+	d = malloc(sizeof(*d));
+	if (d == NULL) {
+		errp(235, __func__, "cannot malloc %lu bytes for decompressor", sizeof(*d));
+	}
+	if (pipe(fds) != 0) {
+		errp(235, __func__, "cannot create a pipe for decompressed randdata");
+	}
+	d->compression = compression;
+	d->in = state->streamFile;
+	d->path = state->randomDataPath;
+	d->fd = fds[1];
+	d->skip = skip;
+	d->threads = state->numberOfThreads;
+	memcpy(d->head, head, kept);
+	d->pending = d->head;
+	d->pending_length = kept;
+
+	/*
+	 * The test threads read the decompressed data from the pipe
+	 */
+	state->streamFile = fdopen(fds[0], "r");
+	if (state->streamFile == NULL) {
+		errp(235, __func__, "cannot fdopen the read end of the pipe for decompressed randdata");
+	}
+	state->decompressor = d;
+
+	/*
+	 * Start decompressing
+	 */
+	ret = pthread_create(&d->thread, NULL, decode_thread, d);
+	if (ret != 0) {
+		errno = ret;
+		errp(235, __func__, "cannot create the decoder thread");
+	}
+
+	return true;
+}
+
+
+/*
+ * close_decompressor - wait for the decoder thread and close compressed randdata
+ *
+ * given:
+ *      state           // pointer to run state
+ *
+ * The read end of the pipe, i.e., state->streamFile, must have been closed already so that a
+ * decoder thread that would write more data than was tested stops.
+ *
+ * NOTE: This function does NOT return on error.
+ */
+void
+close_decompressor(struct state *state)
+{
+	struct decompressor *d;		// Decoder of the compressed randdata
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(236, __func__, "state arg is NULL");
+	}
+	d = state->decompressor;
+	if (d == NULL) {
+		return;
+	}
+
+	ret = pthread_join(d->thread, NULL);
+	if (ret != 0) {
+		errno = ret;
+		errp(236, __func__, "cannot join the decoder thread");
+	}
+	if (fclose(d->in) != 0) {
+		errp(236, __func__, "error closing: %s", d->path);
+	}
+	free(d);
+	state->decompressor = NULL;
+
+	return;
+}
+
+
+/*
+ * detect_compression - determine the compression format of data from its magic number
+ *
+ * given:
+ *      buf             // first bytes of the data
+ *      length          // number of bytes in buf
+ *
+ * returns:
+ *      Compression format
+ */
+static enum compression
+detect_compression(const BYTE *buf, size_t length)
+{
+	if (length >= sizeof(gzip_magic) && memcmp(buf, gzip_magic, sizeof(gzip_magic)) == 0) {
+		return COMPRESSION_GZIP;
+	} else if (length >= sizeof(xz_magic) && memcmp(buf, xz_magic, sizeof(xz_magic)) == 0) {
+		return COMPRESSION_XZ;
+	} else if (length >= sizeof(zstd_magic) && memcmp(buf, zstd_magic, sizeof(zstd_magic)) == 0) {
+		return COMPRESSION_ZSTD;
+	}
+	return COMPRESSION_NONE;
+}
+
+
+/*
+ * decode_thread - decompress randdata into the pipe
+ *
+ * given:
+ *      arg             // pointer to the struct decompressor
+ *
+ * SIGPIPE is blocked in this thread, so once the test threads close the read end of the pipe,
+ * writing fails with EPIPE and the thread stops decompressing.
+ */
+static void *
+decode_thread(void *arg)
+{
+	struct decompressor *d = (struct decompressor *) arg;
+	sigset_t sigpipe;	// Set with only SIGPIPE
+	BYTE *in;		// Compressed data buffer
+	BYTE *out;		// Decompressed data buffer
+
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+	in = malloc(DECOMPRESS_BUFSIZE);
+	out = malloc(DECOMPRESS_BUFSIZE);
+	if (in == NULL || out == NULL) {
+		errp(237, __func__, "cannot malloc %d byte decompression buffers", DECOMPRESS_BUFSIZE);
+	}
+
+	switch (d->compression) {
+	case COMPRESSION_NONE:
+		copy_uncompressed(d, in);
+		break;
+#if defined(HAVE_ZLIB)
+	case COMPRESSION_GZIP:
+		if (d->threads > 1) {
+			decode_units(d, in, out);
+		} else {
+			decode_gzip(d, in, out);
+		}
+		break;
+#endif
+#if defined(HAVE_LZMA)
+	case COMPRESSION_XZ:
+		decode_xz(d, in, out);
+		break;
+#endif
+#if defined(HAVE_ZSTD)
+	case COMPRESSION_ZSTD:
+		if (d->threads > 1) {
+			decode_units(d, in, out);
+		} else {
+			decode_zstd(d, in, out);
+		}
+		break;
+#endif
+	default:
+		err(237, __func__, "unsupported compression format: %d", (int) d->compression);
+	}
+
+	/*
+	 * Closing the write end makes the test threads see EOF after the last decompressed byte
+	 */
+	close(d->fd);
+	free(in);
+	free(out);
+
+	return NULL;
+}
+
+
+/*
+ * put_decompressed - write decompressed data into the pipe
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      buf             // decompressed data
+ *      length          // number of bytes in buf
+ *
+ * returns:
+ *      true ==> data was written or discarded, keep decompressing
+ *      false ==> no more data is read from the pipe, stop decompressing
+ *
+ * The first d->skip bytes decompressed are discarded.
+ */
+static bool
+put_decompressed(struct decompressor *d, const BYTE *buf, size_t length)
+{
+	ssize_t ret;		// write() return value
+
+	if (d->skip > 0) {
+		size_t discard = (size_t) d->skip < length ? (size_t) d->skip : length;
+
+		d->skip -= (long int) discard;
+		buf += discard;
+		length -= discard;
+	}
+	while (length > 0) {
+		ret = write(d->fd, buf, length);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EPIPE) {
+				return false;
+			}
+			errp(237, __func__, "cannot write decompressed randdata to the pipe");
+		}
+		buf += ret;
+		length -= (size_t) ret;
+	}
+
+	return true;
+}
+
+
+/*
+ * read_compressed - read compressed randdata, starting with data read before the decoder or a fallback
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      buf             // buffer for compressed data
+ *      size            // size of buf
+ *
+ * returns:
+ *      Number of bytes read into buf, 0 at EOF or on a read error
+ */
+static size_t
+read_compressed(struct decompressor *d, BYTE *buf, size_t size)
+{
+	size_t length;		// Number of pending bytes copied
+
+	if (d->pending_length > 0) {
+		length = d->pending_length < size ? d->pending_length : size;
+		memcpy(buf, d->pending, length);
+		d->pending += length;
+		d->pending_length -= length;
+		return length;
+	}
+	return fread(buf, 1, size, d->in);
+}
+
+
+/*
+ * copy_uncompressed - copy uncompressed randdata from a pipe into the pipe to the readers
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      in              // DECOMPRESS_BUFSIZE byte buffer
+ *
+ * The bytes read to look for a magic number, in d->pending, are copied first.
+ */
+static void
+copy_uncompressed(struct decompressor *d, BYTE *in)
+{
+	size_t length;		// Number of bytes read
+
+	for (;;) {
+		length = read_compressed(d, in, DECOMPRESS_BUFSIZE);
+		if (length == 0) {
+			if (ferror(d->in)) {
+				errp(237, __func__, "read error while reading file: %s", d->path);
+			}
+			break;
+		}
+		if (put_decompressed(d, in, length) == false) {
+			break;
+		}
+	}
+
+	return;
+}
+
+
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/*
+ * Unit of compressed randdata that is decoded on its own: a zstd frame or a BGZF gzip member
+ */
+struct unit {
+	size_t in_offset;		// Offset of the unit in the compressed batch
+	size_t in_length;		// Compressed size of the unit
+	size_t out_offset;		// Offset of the decompressed unit in the decompressed batch
+	size_t out_length;		// Decompressed size of the unit
+};
+
+/*
+ * Batch of units decoded in parallel
+ */
+struct unit_batch {
+	struct decompressor *d;		// Decompressor of the randdata
+	const BYTE *in;			// Compressed batch
+	BYTE *out;			// Decompressed batch
+	struct unit *unit;		// Units of the batch
+	long int count;			// Number of units
+	long int workers;		// Number of threads decoding the batch
+};
+
+/*
+ * Thread decoding every workers-th unit of a batch
+ */
+struct unit_worker {
+	struct unit_batch *batch;	// Batch being decoded
+	long int id;			// First unit decoded by this thread
+	pthread_t thread;		// Worker thread
+};
+
+#   define UNIT_NONE ((size_t) -1)	// find_unit(): data cannot be decoded as a unit
+#   define ZSTD_HEADER_MAX (18)		// Maximum size of a zstd frame header
+
+
+/*
+ * find_unit - find the size of the unit at the start of compressed data
+ *
+ * given:
+ *      compression     // COMPRESSION_GZIP or COMPRESSION_ZSTD
+ *      buf             // compressed data starting at a gzip member or zstd frame
+ *      length          // number of bytes in buf
+ *      more            // true ==> buf may be extended with the bytes that follow it
+ *      out_length      // pointer to the decompressed size of the unit
+ *
+ * returns:
+ *      Compressed size of the unit, or
+ *      0 ==> more data is needed to find the unit, only if more is true, or
+ *      UNIT_NONE ==> the data does not start with a unit of at most DECOMPRESS_BATCH bytes
+ *
+ * A gzip member is a unit only if it is a BGZF block, whose BC extra subfield holds its size
+ * less one.  A zstd frame is a unit only if its header records the decompressed size.
+ */
+static size_t
+find_unit(enum compression compression, const BYTE *buf, size_t length, bool more, size_t *out_length)
+{
+	switch (compression) {
+#if defined(HAVE_ZLIB)
+	case COMPRESSION_GZIP:
+		{
+			size_t xlen;		// Size of the extra field
+			size_t size;		// Size of the member
+			size_t i;
+
+			if (length < 12) {
+				return more ? 0 : UNIT_NONE;
+			}
+			if (buf[0] != 0x1f || buf[1] != 0x8b || buf[2] != 8 || (buf[3] & 0x04) == 0) {
+				return UNIT_NONE;
+			}
+			xlen = (size_t) buf[10] | ((size_t) buf[11] << 8);
+			if (length < 12 + xlen) {
+				return more ? 0 : UNIT_NONE;
+			}
+			size = 0;
+			for (i = 12; i + 4 <= 12 + xlen; i += 4 + ((size_t) buf[i + 2] | ((size_t) buf[i + 3] << 8))) {
+				if (buf[i] == 'B' && buf[i + 1] == 'C' && buf[i + 2] == 2 && buf[i + 3] == 0 && i + 6 <= 12 + xlen) {
+					size = ((size_t) buf[i + 4] | ((size_t) buf[i + 5] << 8)) + 1;
+					break;
+				}
+			}
+			if (size < 12 + xlen + 8) {
+				return UNIT_NONE;
+			}
+			if (length < size) {
+				return more ? 0 : UNIT_NONE;
+			}
+			*out_length = (size_t) buf[size - 4] | ((size_t) buf[size - 3] << 8) |
+				      ((size_t) buf[size - 2] << 16) | ((size_t) buf[size - 1] << 24);
+			if (*out_length > DECOMPRESS_BATCH) {
+				return UNIT_NONE;
+			}
+			return size;
+		}
+#endif
+#if defined(HAVE_ZSTD)
+	case COMPRESSION_ZSTD:
+		{
+			unsigned long long content;	// Decompressed size of the frame
+			size_t size;			// Size of the frame
+
+			content = ZSTD_getFrameContentSize(buf, length);
+			if (content == ZSTD_CONTENTSIZE_ERROR) {
+				return (more && length < ZSTD_HEADER_MAX) ? 0 : UNIT_NONE;
+			}
+			if (content == ZSTD_CONTENTSIZE_UNKNOWN || content > DECOMPRESS_BATCH) {
+				return UNIT_NONE;
+			}
+			size = ZSTD_findFrameCompressedSize(buf, length);
+			if (ZSTD_isError(size)) {
+				return more ? 0 : UNIT_NONE;
+			}
+			*out_length = (size_t) content;
+			return size;
+		}
+#endif
+	default:
+		return UNIT_NONE;
+	}
+}
+
+
+/*
+ * unit_thread - decode every workers-th unit of a batch
+ *
+ * given:
+ *      arg             // pointer to the struct unit_worker
+ */
+static void *
+unit_thread(void *arg)
+{
+	struct unit_worker *w = (struct unit_worker *) arg;
+	struct unit_batch *b = w->batch;
+	struct unit *u;		// Unit being decoded
+	long int i;
+
+	switch (b->d->compression) {
+#if defined(HAVE_ZLIB)
+	case COMPRESSION_GZIP:
+		{
+			z_stream z;	// zlib stream state
+			int ret;	// inflate() return value
+
+			memset(&z, 0, sizeof(z));
+			ret = inflateInit2(&z, 15 + 16);	// 15 bit window, gzip header
+			if (ret != Z_OK) {
+				err(238, __func__, "inflateInit2 failed: %d", ret);
+			}
+			for (i = w->id; i < b->count; i += b->workers) {
+				u = &b->unit[i];
+				inflateReset(&z);
+				z.next_in = (Bytef *) (b->in + u->in_offset);
+				z.avail_in = (uInt) u->in_length;
+				z.next_out = b->out + u->out_offset;
+				z.avail_out = (uInt) u->out_length;
+				ret = inflate(&z, Z_FINISH);
+				if (ret != Z_STREAM_END || z.avail_in != 0 || z.avail_out != 0) {
+					err(238, __func__, "gzip data error in %s: %s", b->d->path,
+					    z.msg != NULL ? z.msg : "member size does not match its data");
+				}
+			}
+			inflateEnd(&z);
+		}
+		break;
+#endif
+#if defined(HAVE_ZSTD)
+	case COMPRESSION_ZSTD:
+		{
+			ZSTD_DCtx *z;	// zstd decoder state
+			size_t ret;	// ZSTD_decompressDCtx() return value
+
+			z = ZSTD_createDCtx();
+			if (z == NULL) {
+				err(239, __func__, "cannot create the zstd decoder");
+			}
+			for (i = w->id; i < b->count; i += b->workers) {
+				u = &b->unit[i];
+				ret = ZSTD_decompressDCtx(z, b->out + u->out_offset, u->out_length,
+							  b->in + u->in_offset, u->in_length);
+				if (ZSTD_isError(ret)) {
+					err(239, __func__, "zstd data error in %s: %s", b->d->path, ZSTD_getErrorName(ret));
+				}
+				if (ret != u->out_length) {
+					err(239, __func__, "zstd data error in %s: frame size does not match its data", b->d->path);
+				}
+			}
+			ZSTD_freeDCtx(z);
+		}
+		break;
+#endif
+	default:
+		err(237, __func__, "unsupported compression format: %d", (int) b->d->compression);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * decode_units - decompress gzip or zstd randdata, decoding independent units in parallel
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      in              // DECOMPRESS_BUFSIZE byte buffer for compressed data
+ *      out             // DECOMPRESS_BUFSIZE byte buffer for decompressed data
+ *
+ * Up to DECOMPRESS_BATCH compressed bytes are read and split into units, which d->threads threads
+ * decode into one decompressed batch that is written to the pipe in order.  Once the data does not
+ * start with a unit, the data read so far and the rest of the file are decoded by this thread,
+ * using in and out, as with one thread.
+ */
+static void
+decode_units(struct decompressor *d, BYTE *in, BYTE *out)
+{
+	struct unit_batch b;		// Batch being decoded
+	struct unit_worker *worker;	// Threads decoding the batch
+	BYTE *batch_in;			// Compressed data of the batch
+	size_t length;			// Number of bytes in batch_in
+	size_t offset;			// Offset of the next unit in batch_in
+	size_t size;			// Compressed size of the next unit
+	size_t out_length;		// Decompressed size of the next unit
+	size_t out_total;		// Decompressed size of the batch
+	bool eof;			// true once all of the file has been read
+	bool parallel;			// true while units are found
+	long int i;
+	int ret;
+
+	batch_in = malloc(DECOMPRESS_BATCH);
+	b.out = malloc(DECOMPRESS_BATCH);
+	b.unit = malloc(DECOMPRESS_UNITS * sizeof(b.unit[0]));
+	worker = malloc((size_t) d->threads * sizeof(worker[0]));
+	if (batch_in == NULL || b.out == NULL || b.unit == NULL || worker == NULL) {
+		errp(237, __func__, "cannot malloc parallel decompression buffers");
+	}
+	b.d = d;
+	b.in = batch_in;
+
+	length = 0;
+	eof = false;
+	parallel = true;
+	for (;;) {
+		/*
+		 * Fill the batch
+		 */
+		while (length < DECOMPRESS_BATCH && eof == false) {
+			size = read_compressed(d, batch_in + length, DECOMPRESS_BATCH - length);
+			if (size == 0) {
+				if (ferror(d->in)) {
+					errp(237, __func__, "read error while reading file: %s", d->path);
+				}
+				eof = true;
+			}
+			length += size;
+		}
+
+		/*
+		 * Split the batch into units, a partial unit at its end is moved to the next batch
+		 */
+		b.count = 0;
+		offset = 0;
+		out_total = 0;
+		while (b.count < DECOMPRESS_UNITS && offset < length) {
+			size = find_unit(d->compression, batch_in + offset, length - offset, offset > 0 && eof == false,
+					 &out_length);
+			if (size == 0 || size == UNIT_NONE || out_total + out_length > DECOMPRESS_BATCH) {
+				break;
+			}
+			b.unit[b.count].in_offset = offset;
+			b.unit[b.count].in_length = size;
+			b.unit[b.count].out_offset = out_total;
+			b.unit[b.count].out_length = out_length;
+			b.count++;
+			offset += size;
+			out_total += out_length;
+		}
+		if (b.count == 0) {
+			if (length > 0) {
+				parallel = false;
+			}
+			break;
+		}
+
+		/*
+		 * Decode the units, this thread decodes a share of them as well
+		 */
+		b.workers = d->threads < b.count ? d->threads : b.count;
+		for (i = 0; i < b.workers; ++i) {
+			worker[i].batch = &b;
+			worker[i].id = i;
+			if (i > 0) {
+				ret = pthread_create(&worker[i].thread, NULL, unit_thread, &worker[i]);
+				if (ret != 0) {
+					errno = ret;
+					errp(237, __func__, "cannot create decoder thread %ld", i);
+				}
+			}
+		}
+		unit_thread(&worker[0]);
+		for (i = 1; i < b.workers; ++i) {
+			ret = pthread_join(worker[i].thread, NULL);
+			if (ret != 0) {
+				errno = ret;
+				errp(237, __func__, "cannot join decoder thread %ld", i);
+			}
+		}
+		if (put_decompressed(d, b.out, out_total) == false) {
+			break;
+		}
+
+		memmove(batch_in, batch_in + offset, length - offset);
+		length -= offset;
+	}
+
+	/*
+	 * Decode what is left with one thread
+	 */
+	if (parallel == false) {
+		dbg(DBG_LOW, "%s randdata is not split into independent units from here on, decoding it with one thread",
+		    compression_name[d->compression]);
+		d->pending = batch_in;
+		d->pending_length = length;
+		switch (d->compression) {
+#if defined(HAVE_ZLIB)
+		case COMPRESSION_GZIP:
+			decode_gzip(d, in, out);
+			break;
+#endif
+#if defined(HAVE_ZSTD)
+		case COMPRESSION_ZSTD:
+			decode_zstd(d, in, out);
+			break;
+#endif
+		default:
+			err(237, __func__, "unsupported compression format: %d", (int) d->compression);
+		}
+	}
+
+	free(batch_in);
+	free(b.out);
+	free(b.unit);
+	free(worker);
+
+	return;
+}
+#endif				/* HAVE_ZLIB || HAVE_ZSTD */
+
+
+#if defined(HAVE_ZLIB)
+/*
+ * decode_gzip - decompress gzip randdata
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      in              // DECOMPRESS_BUFSIZE byte buffer for compressed data
+ *      out             // DECOMPRESS_BUFSIZE byte buffer for decompressed data
+ *
+ * Concatenated members, such as those written by parallel gzip compressors, are decompressed in order.
+ * Decoding starts with any data in d->pending.
+ */
+static void
+decode_gzip(struct decompressor *d, BYTE *in, BYTE *out)
+{
+	z_stream z;		// zlib stream state
+	bool full;		// true if the last inflate() filled out and may have more to flush
+	bool stopped;		// true if no more data is read from the pipe
+	int ret;		// inflate() return value
+
+	memset(&z, 0, sizeof(z));
+	ret = inflateInit2(&z, 15 + 16);	// 15 bit window, gzip header
+	if (ret != Z_OK) {
+		err(238, __func__, "inflateInit2 failed: %d", ret);
+	}
+
+	ret = Z_OK;
+	full = false;
+	stopped = false;
+	for (;;) {
+		/*
+		 * Refill the compressed data once inflate() has flushed all it decompressed
+		 */
+		if (z.avail_in == 0 && full == false) {
+			z.next_in = in;
+			z.avail_in = (uInt) read_compressed(d, in, DECOMPRESS_BUFSIZE);
+			if (z.avail_in == 0) {
+				if (ferror(d->in)) {
+					errp(238, __func__, "read error while reading file: %s", d->path);
+				}
+				break;
+			}
+		}
+
+		/*
+		 * Decompress, starting a new member after the end of the previous one
+		 */
+		if (ret == Z_STREAM_END) {
+			inflateReset(&z);
+		}
+		z.next_out = out;
+		z.avail_out = DECOMPRESS_BUFSIZE;
+		ret = inflate(&z, Z_NO_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+			err(238, __func__, "gzip data error in %s: %s", d->path, z.msg != NULL ? z.msg : "unknown error");
+		}
+		full = (z.avail_out == 0 && ret != Z_STREAM_END);
+		if (put_decompressed(d, out, DECOMPRESS_BUFSIZE - z.avail_out) == false) {
+			stopped = true;
+			break;
+		}
+	}
+	if (ret != Z_STREAM_END && stopped == false) {
+		warn(__func__, "gzip data in %s is truncated", d->path);
+	}
+	inflateEnd(&z);
+
+	return;
+}
+#endif				/* HAVE_ZLIB */
+
+
+#if defined(HAVE_LZMA)
+/*
+ * decode_xz - decompress xz randdata
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      in              // DECOMPRESS_BUFSIZE byte buffer for compressed data
+ *      out             // DECOMPRESS_BUFSIZE byte buffer for decompressed data
+ *
+ * An xz file written in independent blocks, such as by xz -T, records the size of each block,
+ * so liblzma decodes up to d->threads blocks in parallel.  Other files are decoded by one thread.
+ * Decoding starts with any data in d->pending.
+ */
+static void
+decode_xz(struct decompressor *d, BYTE *in, BYTE *out)
+{
+	lzma_stream s = LZMA_STREAM_INIT;	// liblzma stream state
+	lzma_action action;	// LZMA_RUN, or LZMA_FINISH once all compressed data was read
+	lzma_ret ret;		// lzma_code() return value
+
+#if LZMA_VERSION >= 50040002
+	lzma_mt mt;		// Multi-threaded decoder options
+
+	memset(&mt, 0, sizeof(mt));
+	mt.flags = LZMA_CONCATENATED;
+	mt.threads = (uint32_t) (d->threads > 0 ? d->threads : 1);
+	mt.memlimit_threading = lzma_physmem() / 4;
+	if (mt.memlimit_threading == 0) {
+		mt.memlimit_threading = UINT64_MAX;
+	}
+	mt.memlimit_stop = UINT64_MAX;
+	ret = lzma_stream_decoder_mt(&s, &mt);
+#else
+	ret = lzma_stream_decoder(&s, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+	if (ret != LZMA_OK) {
+		err(239, __func__, "cannot initialize the xz decoder: %d", (int) ret);
+	}
+
+	action = LZMA_RUN;
+	do {
+		/*
+		 * Refill the compressed data
+		 */
+		if (s.avail_in == 0 && action == LZMA_RUN) {
+			s.next_in = in;
+			s.avail_in = read_compressed(d, in, DECOMPRESS_BUFSIZE);
+			if (s.avail_in == 0) {
+				if (ferror(d->in)) {
+					errp(239, __func__, "read error while reading file: %s", d->path);
+				}
+				action = LZMA_FINISH;
+			}
+		}
+
+		/*
+		 * Decompress
+		 */
+		s.next_out = out;
+		s.avail_out = DECOMPRESS_BUFSIZE;
+		ret = lzma_code(&s, action);
+		if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+			err(239, __func__, "xz data error in %s: %d", d->path, (int) ret);
+		}
+		if (put_decompressed(d, out, DECOMPRESS_BUFSIZE - s.avail_out) == false) {
+			break;
+		}
+	} while (ret != LZMA_STREAM_END);
+	lzma_end(&s);
+
+	return;
+}
+#endif				/* HAVE_LZMA */
+
+
+#if defined(HAVE_ZSTD)
+/*
+ * decode_zstd - decompress zstd randdata
+ *
+ * given:
+ *      d               // pointer to the decompressor
+ *      in              // DECOMPRESS_BUFSIZE byte buffer for compressed data
+ *      out             // DECOMPRESS_BUFSIZE byte buffer for decompressed data
+ *
+ * Concatenated frames are decompressed in order.  Decoding starts with any data in d->pending.
+ */
+static void
+decode_zstd(struct decompressor *d, BYTE *in, BYTE *out)
+{
+	ZSTD_DStream *z;	// zstd stream state
+	ZSTD_inBuffer zin;	// Compressed data
+	ZSTD_outBuffer zout;	// Decompressed data
+	size_t ret;		// ZSTD_decompressStream() return value, 0 at the end of a frame
+	bool full;		// true if the last ZSTD_decompressStream() filled out and may have more to flush
+	bool stopped;		// true if no more data is read from the pipe
+
+	z = ZSTD_createDStream();
+	if (z == NULL) {
+		err(239, __func__, "cannot create the zstd decoder");
+	}
+	ZSTD_initDStream(z);
+
+	zin.src = in;
+	zin.size = 0;
+	zin.pos = 0;
+	ret = 0;
+	full = false;
+	stopped = false;
+	for (;;) {
+		/*
+		 * Refill the compressed data once all it decompressed has been flushed
+		 */
+		if (zin.pos == zin.size && full == false) {
+			zin.size = read_compressed(d, in, DECOMPRESS_BUFSIZE);
+			zin.pos = 0;
+			if (zin.size == 0) {
+				if (ferror(d->in)) {
+					errp(239, __func__, "read error while reading file: %s", d->path);
+				}
+				break;
+			}
+		}
+
+		/*
+		 * Decompress
+		 */
+		zout.dst = out;
+		zout.size = DECOMPRESS_BUFSIZE;
+		zout.pos = 0;
+		ret = ZSTD_decompressStream(z, &zout, &zin);
+		if (ZSTD_isError(ret)) {
+			err(239, __func__, "zstd data error in %s: %s", d->path, ZSTD_getErrorName(ret));
+		}
+		full = (zout.pos == zout.size && ret != 0);
+		if (put_decompressed(d, out, zout.pos) == false) {
+			stopped = true;
+			break;
+		}
+	}
+	if (ret != 0 && stopped == false) {
+		warn(__func__, "zstd data in %s is truncated", d->path);
+	}
+	ZSTD_freeDStream(z);
+
+	return;
+}
+#endif				/* HAVE_ZSTD */
@@ -0,0 +1,83 @@
+/*****************************************************************************
+	      C O M P R E S S E D   R A N D D A T A   D E C O D E R
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef DECOMPRESS_H
+#   define DECOMPRESS_H
+
+#include <pthread.h>
+#include "../utils/defs.h"
+
+/*
+ * Compressed randdata
+ *
+ * A randdata file compressed with gzip, xz or zstd is recognized by its magic number.  A decoder
+ * thread decompresses it and writes the decompressed data into a pipe, and the pipe replaces the
+ * streamFile of the randdata file.  The readers then read the data in order, as from stdin, while
+ * it is being decompressed.  Decompressed data before the first bit to test is discarded by the
+ * decoder thread, so -j jobnum works without writing the decompressed data anywhere.
+ *
+ * With more than one thread, data split into independently decodable units is decoded in parallel
+ * batches: zstd frames that record their decompressed size, and BGZF gzip members (as written by
+ * bgzip) whose extra field records the member size.  The units of a batch are decoded by up to
+ * threads threads and written to the pipe in order.  Other data, and everything after a unit that
+ * cannot be decoded on its own, is decoded by the decoder thread alone.
+ *
+ * A pipe, such as stdin, cannot be rewound after its magic number was read.  The decoder thread
+ * starts with the bytes read from it, and when they turn out not to be a magic number, it copies
+ * them and the rest of the uncompressed data into the pipe to the readers.
+ *
+ * Support for each format is compiled in with HAVE_ZLIB, HAVE_LZMA and HAVE_ZSTD, see the Makefile.
+ */
+#   define DECOMPRESS_BUFSIZE (1024*1024)	// Size of the compressed and decompressed data buffers
+#   define DECOMPRESS_BATCH (32*1024*1024)	// Maximum compressed, and decompressed, bytes of a parallel batch
+#   define DECOMPRESS_UNITS (4096)		// Maximum number of units in a parallel batch
+#   define DECOMPRESS_MAGIC (6)		// Length of the longest magic number
+
+enum compression {
+	COMPRESSION_NONE = 0,		// randdata is not compressed, the decoder thread only copies it
+	COMPRESSION_GZIP,		// gzip, possibly several concatenated members
+	COMPRESSION_XZ,			// xz, possibly several concatenated streams
+	COMPRESSION_ZSTD,		// zstd, possibly several concatenated frames
+};
+
+struct decompressor {
+	enum compression compression;	// Format of the compressed randdata
+	FILE *in;			// Compressed randdata file
+	char *path;			// Path of the compressed randdata file
+	int fd;				// Write end of the pipe that the decompressed data is written to
+	long int skip;			// Number of decompressed bytes to discard before writing to the pipe
+	long int threads;		// Maximum number of threads decoding independent blocks
+	BYTE *pending;			// Data read before the decoder reads d->in, such as head, or before a fallback
+	size_t pending_length;		// Number of bytes left in pending
+	BYTE head[DECOMPRESS_MAGIC];	// First bytes of randdata that cannot be rewound
+	pthread_t thread;		// Decoder thread
+};
+
+extern bool open_decompressor(struct state *state, long int skip);
+extern void close_decompressor(struct state *state);
+
+#endif				/* DECOMPRESS_H */
@@ -110,6 +110,10 @@
 #   define BITS_N_INT			(BITS_N_BYTE * sizeof(int))		// Number of bits in an int
 #   define BITS_N_LONGINT		(BITS_N_BYTE * sizeof(long int))	// Number of bits in a long int
 #   define MAX_DATA_DIGITS		(21)					// Decimal digits in (2^64)-1
+#   define FORMAT_WORD_BYTES_MAX		(8)					// Bytes in the largest word of a -F format
+#   define ITERATION_BYTES(n)		(((n) + 2 * BITS_N_BYTE * FORMAT_WORD_BYTES_MAX - 2) / BITS_N_BYTE)	// Whole words holding n bits from any bit of a word
+#   define ASCII_CHUNK_SIZE		(65536)					// Bytes of ASCII randdata parsed at a time
+#   define ASCII_INDEX_INTERVAL		(65536)					// Bits between ASCII index checkpoints
 
 #   define NUMOFTESTS			(15)		// MAX TESTS DEFINED - must match max enum test value below
 #   define NUMOFGENERATORS		(10)		// MAX PRNGs
@@ -125,6 +129,8 @@
 #   define DEFAULT_BITCOUNT		(1048576)	// -P 9=bitcount, Length of a single bit stream
 #   define DEFAULT_UNIFORMITY_LEVEL	(0.0001)	// -P 10=uni_level, uniformity errors have values below this
 #   define DEFAULT_ALPHA		(0.01)		// -P 11=alpha, p_value significance level
+#   define DEFAULT_RANK_ROWS		(32)		// -P 12=M, Rank Test - rows per matrix
+#   define DEFAULT_RANK_COLS		(32)		// -P 13=Q, Rank Test - columns per matrix
 
 /*****************************************************************************
  INPUT SIZE RECOMMENDATIONS CONSTANTS
@@ -142,19 +148,14 @@
 #   define MIN_LENGTH_LONGESTRUN	(128)		// Minimum n for a Longest Runs test for TEST_LONGEST_RUN
 #   define CLASS_COUNT_LONGEST_RUN	(6)		// Number of classes == max_len - min_len + 1 for TEST_LONGEST_RUN
 
-#   define NUMBER_OF_ROWS_RANK		(32)		// Number of rows in the rank_matrix used by TEST_RANK
-#   define NUMBER_OF_COLS_RANK		(32)		// Number of columns in the rank_matrix used by TEST_RANK
+#   define MIN_ROWS_RANK		(2)		// Minimum rows and columns of a TEST_RANK matrix
 #   define MIN_NUMBER_OF_MATRICES_RANK	(38)		// Minimum number of matrices required for TEST_RANK
-#   if NUMBER_OF_ROWS_RANK <= 0
-// force syntax error if NUMBER_OF_ROWS_RANK is not bigger than zero
-      -=*#@#*=- NUMBER_OF_ROWS_RANK must be > 0 -=*#@#*=-
-#   endif
-#   if NUMBER_OF_COLS_RANK <= 0
-// force syntax error if NUMBER_OF_COLS_RANK is not bigger than zero
-      -=*#@#*=- NUMBER_OF_COLS_RANK must be > 0 -=*#@#*=-
-#   endif
+#   define MIN_EXPECTED_COUNT_RANK	(5.0)		// Minimum expected number of matrices in each TEST_RANK rank class
 
 #   define MIN_LENGTH_FFT		(1000)		// Minimum n for TEST_FFT
+#   define BATCH_FFT			(16)		// Most bit streams transformed together by a TEST_FFT thread
+#   define BATCH_LENGTH_FFT		(131072)	// Most bits in a batch of TEST_FFT bit streams, so it stays in cache
+#   define MAX_LENGTH_SINGLE_FFT	(4096)		// Maximum n for a -D single precision TEST_FFT transform
 
 #   define BLOCKS_NON_OVERLAPPING	(8)		// Number of blocks N used by TEST_NON_OVERLAPPING
 #   define MAX_BLOCKS_NON_OVERLAPPING	(100)		// Maximum number N of blocks used by TEST_NON_OVERLAPPING
@@ -240,8 +241,32 @@ enum format {
 	FORMAT_0 = '0',			// Alias for FORMAT_ASCII_01 - redirects to it
 	FORMAT_RAW_BINARY = 'r',	// Data in raw binary, 8 bits per octet
 	FORMAT_1 = '1',			// Alias for FORMAT_RAW_BINARY - redirects to it
+	FORMAT_RAW_LSB = 'l',		// Data in raw binary, 8 bits per octet, least significant bit first
+	FORMAT_WORD32_LE = 'w',		// 32 bit little endian words, most significant bit of each word first
+	FORMAT_WORD32_BE = 'W',		// 32 bit big endian words - same bit order as FORMAT_RAW_BINARY, redirects to it
+	FORMAT_WORD64_LE = 'q',		// 64 bit little endian words, most significant bit of each word first
+	FORMAT_WORD64_BE = 'Q',		// 64 bit big endian words - same bit order as FORMAT_RAW_BINARY, redirects to it
+};
+
+// How raw binary data is read from a randdata file
+enum reader {
+	READER_STDIO = 's',		// fseek() and fread() on the shared streamFile while holding the mutex
+	READER_MMAP = 'm',		// mmap() randdata and convert each iteration straight from the mapping
+	READER_PREAD = 'p',		// pread() each iteration into a per thread buffer, no shared FILE state
+					// ASCII data can be read with pread() only with an ASCII index (-x)
 };
 
+// How hard FFTW plans the transform of the DFT test
+enum fft_effort {
+	FFT_ESTIMATE = 'e',		// FFTW_ESTIMATE: plan from heuristics, no transform is timed (default)
+	FFT_MEASURE = 'm',		// FFTW_MEASURE: time a few candidate plans
+	FFT_PATIENT = 'p',		// FFTW_PATIENT: time many more candidate plans
+	FFT_EXHAUSTIVE = 'x',		// FFTW_EXHAUSTIVE: time every candidate plan
+};
+#   define DEFAULT_WISDOM_FILE "fftw.wisdom"	// FFTW wisdom file under workDir when -E is not e and no -W was given
+#   define SINGLE_WISDOM_SUFFIX ".single"	// Suffix of the file with the fftwf wisdom of -D next to the FFTW wisdom
+#   define SCRATCH_MEMORY (256L * 1024 * 1024)	// -X: bytes of memory each thread uses for the out-of-core DFT test transform
+
 // Run modes
 enum run_mode {
 	MODE_ITERATE_AND_ASSESS = 'b',	// Test the data specified from '-g generator' (default mode)
@@ -250,8 +275,9 @@ enum run_mode {
 };
 
 #   define MIN_PARAM (1)	// minimum -P parameter number
-#   define MAX_PARAM (11)	// maximum -P parameter number
+#   define MAX_PARAM (13)	// maximum -P parameter number
 #   define MAX_INT_PARAM (9)	// maximum -P parameter that is an integer, beyond this are doubles
+#   define MAX_DOUBLE_PARAM (11)	// maximum -P parameter that is a double, beyond this are integers again
 
 enum param {
 	PARAM_continue = 0,				// Don't prompt for any more parameters
@@ -266,6 +292,8 @@ enum param {
 	PARAM_n = 9,					// -P 9=bitcount, Length of a single bit stream
 	PARAM_uniformity_level = 10,			// -P 10=uni_level, uniformity errors have values below this
 	PARAM_alpha = 11,				// -P 11=alpha, p_value significance level
+	PARAM_rankRows = 12,				// -P 12=M, Rank Test - rows per matrix
+	PARAM_rankCols = 13,				// -P 13=Q, Rank Test - columns per matrix
 };
 
 /*
@@ -286,6 +314,8 @@ typedef struct _testParameters {
 	long int n;					// -P 9=bitcount, Length of a single bit stream
 	double uniformity_level;			// -P 10=uni_level, uniformity errors have values below this
 	double alpha;					// -P 11=alpha, p_value significance level
+	long int rankRows;				// -P 12=M, Rank Test - rows per matrix
+	long int rankCols;				// -P 13=Q, Rank Test - columns per matrix
 } TP;
 
 /*
@@ -360,6 +390,17 @@ struct Node
 	struct Node *next;
 };
 
+/*
+ * ascii_cursor - position in ASCII randdata and the chunk of it read ahead
+ */
+struct ascii_cursor {
+	char *buf;			// true if non-NULL, ASCII_CHUNK_SIZE bytes of ASCII randdata read ahead
+	long int length;		// Number of bytes held in buf
+	long int pos;			// Index of the next unparsed byte in buf
+	long int offset;		// File offset of the byte after the last one held in buf (pread only)
+	long int nextBit;		// randdata bit number of the next unparsed bit, < 0 ==> unknown
+};
+
 /*
  * state - execution state, initialized and set up by the command line, augmented by test results
  */
@@ -394,15 +435,42 @@ struct state {
 	bool stdinData;			// true is reading randdata from standard input (stdin)
 
 	bool dataFormatFlag;		// true if -F format was given
-	enum format dataFormat;		// -F format: 'r': raw binary, 'a': ASCII '0'/'1' chars
+	enum format dataFormat;		// -F format: 'r': raw binary, 'a': ASCII '0'/'1' chars, 'l', 'w', 'q': see enum format
+
+	bool readerFlag;		// true if -R reader was given
+	enum reader reader;		// -R reader: 's': stdio, 'm': mmap, 'p': pread (def: 'p' for regular files, else 's')
+	void *mapAddr;			// true if non-NULL, start of the mmap() of randomDataPath (page aligned)
+	size_t mapLength;		// Length in bytes of the mmap() at mapAddr
+	BYTE *mapData;			// Mapped randdata from the byte that holds base_seek (within mapAddr)
+	long int mapDataLength;		// Number of mapped randdata bytes available from mapData
+
+	bool readerThreadsFlag;		// true if -r readers was given
+	long int readerThreads;		// -r readers: threads reading bitstreams for the test threads, 0: test threads read
+
+	struct ascii_cursor asciiCursor;	// Cursor into ASCII randdata shared by the stdio reader
+	bool asciiIndexFlag;		// true if -x was given
+	struct ascii_index *asciiIndex;	// true if non-NULL, offsets of ASCII randdata bits (see ascii_index.h)
+
+	struct decompressor *decompressor;	// true if non-NULL, randdata is compressed (see decompress.h)
+
+	bool fftEffortFlag;		// true if -E effort was given
+	enum fft_effort fftEffort;	// -E effort: how hard FFTW plans the DFT test transform (def: 'e': estimate)
+	char *wisdomPath;		// -W wisdom: FFTW wisdom file, NULL -> workDir/DEFAULT_WISDOM_FILE when -E is not e
+	bool inPlaceFFT;		// true if -H was given, transform the DFT test in place
+	bool singleFFT;			// true if -D was given, transform the DFT test in single precision first
+	char *scratchDir;		// -X scratchdir: transform the DFT test out of core in scratchdir, NULL -> in memory
 
 	bool numberOfThreadsFlag;	// true if -T numberOfFlag was given
 	long int numberOfThreads;	// Number of threads to use for the current execution
-	long int iterationsMissing;	// Number of iterations that need to be completed
+	long int iterationsMissing;	// Number of iterations that need to be completed (see claimIteration())
+	long int iterationsDone;	// Number of iterations completed (see iterationsLeft())
+	long int fftThreads;		// Most threads sharing a DFT test transform, the iterations left share the cores
 
 	bool jobnumFlag;		// true if -j jobnum was given
 	long int jobnum;		// -j jobnum: seek into randdata num*bitcount*iterations bits unless reading from stdin
-	long int base_seek;		// Seek position for the input file indicating where we want to start testing it
+	long int base_seek;		// Bit of randdata where we want to start testing it
+	BYTE carryBytes[FORMAT_WORD_BYTES_MAX];	// Last word read from stdin when only some of its bits have been tested
+	int carryBits;			// Number of bits of carryBytes not yet tested
 
 	char *pvalues_dir;		// Directory where to look for the .pvalues binary files
 	struct Node *filenames;		// Names of the .pvalues files
@@ -431,8 +499,10 @@ struct state {
 
 	bool is_excursion[NUMOFTESTS + 1];	// true --> test is a form of random excursion
 
-	BitSequence **epsilon;			// Bit stream
+	bool byteEpsilon;			// -B: true -> also keep a one byte per bit view of each bit stream in epsilon
+	BitSequence **epsilon;			// Bit stream, one byte per bit, each 0 or 1 (only if -B, otherwise NULL)
 	BitSequence *tmpepsilon;		// Buffer to write to file in dataFormat
+	WORD64 **packedEpsilon;			// Bit stream, packed 64 bits per WORD64 (see bitstream.h)
 
 	long int count[NUMOFTESTS + 1];		// Count of completed iterations, including tests skipped due to conditions
 	long int valid[NUMOFTESTS + 1];		// Count of completed testable iterations, ignores tests skipped due to conditions
@@ -449,16 +519,27 @@ struct state {
 
 	struct dyn_array *nonovTemplates;	// Array of non-overlapping template words for TEST_NON_OVERLAPPING
 
-	double **fft_m;				// test m array for TEST_DFT
 	double **fft_X;				// test X array for TEST_DFT
+	FILE **fft_scratch;			// -X: scratch file of each thread for TEST_DFT, else NULL
+	double *fft_roots;			// -X: unit roots of the output rows, -D: of n, for TEST_DFT, else NULL
 # if defined(LEGACY_FFT)
-	double **fft_wsave;			// test wsave array for legacy dfft library in TEST_DFT
+	struct dfft_plan *fft_plan;		// Plan of the built-in transform in TEST_DFT, shared by all threads
+	double **fft_work;			// test work array for the built-in transform in TEST_DFT
+	struct dfft_cplan *fft_row_plan;	// -X: plan of the row transforms in TEST_DFT, else NULL
+	struct dfft_cplan *fft_col_plan;	// -X: plan of the column transforms in TEST_DFT, else NULL
 #else /* LEGACY_FFT */
-	fftw_plan *fftw_p;			// Plan containing information about the fastest way to compute the transform
+	fftw_plan *fftw_p;			// Plans of the transform, indexed by the threads sharing it, shared by all threads
 	fftw_complex **fftw_out;		// Output array for fftw library output in TEST_DFT
+	fftw_plan fftw_row_p;			// -X: plan of the row transforms in TEST_DFT, else NULL
+	fftw_plan fftw_col_p;			// -X: plan of the column transforms in TEST_DFT, else NULL
+	fftwf_plan fftwf_p;			// -D: single precision plan of the transform in TEST_DFT, else NULL
+	fftw_plan fftw_batch_p;			// Plan of a batch of transforms in TEST_DFT, NULL when each is done alone
+	long int *fft_batched;			// Number of bit streams each thread has waiting in fft_X for TEST_DFT
+	long int *fft_iteration;		// Iteration of each bit stream waiting in fft_X for TEST_DFT
 #endif /* LEGACY_FFT */
 
-	BitSequence ***rank_matrix;		// Rank test 32 by 32 matrix for TEST_RANK
+	BitSequence ***rank_matrix;		// Rank test M by Q byte matrix for TEST_RANK, when -B was given
+	WORD64 **rank_rows;			// Rank test packed M by Q matrix for TEST_RANK, when M or Q > 32
 
 	long int *rnd_excursion_var_stateX;	// Pointer to NUMBER_OF_STATES_RND_EXCURSION_VAR states for TEST_RND_EXCURSION_VAR
 	long int **ex_var_partial_sums;		// Array of n partial sums for TEST_RND_EXCURSION_VAR
@@ -474,6 +555,8 @@ struct state {
 	long int serial_v_len;			// Number of long ints in serial_v for TEST_SERIAL
 
 	BitSequence **nonper_seq;		// Special BitSequence for TEST_NON_OVERLAPPING
+	long int *nonper_index;			// Template index of each m bit value, or -1, for TEST_NON_OVERLAPPING
+	long int **nonper_next;			// First bit where each m bit value may be counted again for TEST_NON_OVERLAPPING
 
 	long int universal_L;			// Length of each block for TEST_UNIVERSAL
 	long int **universal_T;			// Working Universal template
@@ -491,6 +574,9 @@ struct thread_state {
 	struct state *global_state;
 	long int iteration_being_done;
 	pthread_mutex_t *mutex;
+	struct bitstream_pipeline *pipeline;	// non-NULL ==> bitstreams come from reader threads (see pipeline.h)
+	struct ascii_cursor asciiCursor;	// Cursor into ASCII randdata of this thread (pread reader only)
+	bool deferred;			// true ==> a test holds the result of iteration_being_done, see flush()
 };
 
 /* *INDENT-ON* */
@@ -500,6 +586,7 @@ struct thread_state {
  */
 extern void init(struct state *state);
 extern void iterate(struct thread_state *thread_state);
+extern void flush(struct thread_state *thread_state);
 extern void print(struct state *state);
 extern void metrics(struct state *state);
 extern void destroy(struct state *state);
@@ -1,1716 +1,1168 @@
 #if defined(LEGACY_FFT)
 /*
- * NOTE: This is slow legacy FFT code.  We recommend that you not compile with -DLEGACY_FFT but instead compile
- *	 with version 3.3.3 or later of the fftw3 library (see http://www.fftw.org).
+ * dfft - the built-in real input FFT used when sts is built without fftw
  *
- * Other than adding these leading comments, applying the indent tool to re-format this file, and
- * fixing variable declarations, this code is equivalent the NIST v2.1.2 source code.
+ * NOTE: We recommend that you not compile with -DLEGACY_FFT but instead compile with version 3.3.3 or
+ *	 later of the fftw3 library (see http://www.fftw.org).
+ *
+ * This replaces the OggSQUISH port of FFTPACK that NIST v2.1.2 used.  That code computed its twiddle
+ * factors again for every bit stream and took time proportional to p * n for a prime factor p of n.
+ * Here the factorization and the twiddle factors are computed once per bitcount by dfft_plan_create(),
+ * and the plan is shared read-only by all threads.
  */
+
 /*
- * Notes from RFB:
- *
- * Looks like the user-level routines are:
- *
- * Real FFT
+ * This code has been heavily modified by the following people:
  *
- * void __ogg_fdrffti(int n, double *wsave, long int *ifac) void __ogg_fdrfftf(int n, double *r, double *wsave, long int *ifac)
- * void __ogg_fdrfftb(int n, double *r, double *wsave, long int *ifac)
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
  *
- * __ogg_fdrffti == initialization __ogg_fdrfftf == forward transform __ogg_fdrfftb == backward transform
+ * See the README.md and the initial comment in sts.c for more information.
  *
- * Parameters are n == length of sequence r == sequence to be transformed (input) == transformed sequence (output) wsave == work
- * array of length 2n (allocated by caller) ifac == work array of length 15 (WORK_ARRAY_LEN) (allocated by caller)
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
  *
- * Cosine quarter-wave FFT
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
  *
- * void __ogg_fdcosqi(int n, double *wsave, int *ifac) void __ogg_fdcosqf(int n, double *x, double *wsave, int *ifac) void
- * __ogg_fdcosqb(int n, double *x, double *wsave, int *ifac)
+ * Share and enjoy! :-)
  */
 
-/********************************************************************
-*                                                                  *
-* THIS FILE IS PART OF THE OggSQUISH SOFTWARE CODEC SOURCE CODE.   *
-*                                                                  *
-********************************************************************
 
-file: fft.c
-function: Fast discrete Fourier and cosine transforms and inverses
-author: Monty <xiphmont@mit.edu>
-modifications by: Monty
-last modification date: Jul 1 1996
+// Exit codes: 240 thru 249
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include "dfft.h"
+#include "debug.h"
+
+
+static const double tpi = 6.28318530717958647692528676655900577;	// 2 * pi
 
-********************************************************************/
 
 /*
- * These Fourier routines were originally based on the Fourier routines of the same names from the NETLIB bihar and fftpack fortran
- * libraries developed by Paul N. Swarztrauber at the National Center for Atmospheric Research in Boulder, CO USA.  They have been
- * reimplemented in C and optimized in a few ways for OggSquish.
+ * Team of threads sharing one transform
+ *
+ * Every member of a team runs the same code on its own share of each pass over the data, then
+ * waits at a barrier for the others, as the next pass reads what they wrote.  A team of one thread
+ * is how a transform is done by a single thread.
  */
+struct team {
+	long int threads;		// number of members
+	pthread_mutex_t lock;		// protects arrived and generation
+	pthread_cond_t done;		// broadcast when the last member reaches the barrier
+	long int arrived;		// members waiting at the barrier
+	long int generation;		// number of barriers passed
+};
+
+struct member {
+	struct team *team;		// team of this member
+	long int id;			// 0 .. team->threads - 1
+	const struct dfft_plan *plan;	// plan of the transform
+	double *X;			// input of the transform
+	double *work;			// work space of the transform
+	double *out;			// where the member found the output
+};
+
 
 /*
- * As the original fortran libraries are public domain, the C Fourier routines in this file are hereby released to the public
- * domain as well.  The C routines here produce output exactly equivalent to the original fortran routines.  Of particular interest
- * are the facts that (like the original fortran), these routines can work on arbitrary length vectors that need not be powers of
- * two in length.
+ * Forward static function declarations
  */
+static double *cplan_forward(const struct dfft_cplan *plan, double *x, double *y, double *scratch,
+			     struct member *me);
 
-#include <math.h>
-#include "dfft.h"
-
-#define STIN static
 
+/*
+ * team_wait - wait until all members of a team are done with the current pass
+ *
+ * given:
+ *      me              // member that is done with its share of the pass
+ */
 static void
-drfti1(long int n, double *wa, long int *ifac)
+team_wait(struct member *me)
 {
-	static int ntryh[4] = { 4, 2, 3, 5 };
-	static double tpi = 6.28318530717958647692528676655900577;
-	double arg;
-	double argh;
-	double argld;
-	double fi;
-	long int ntry = 0;
-	long int i;
-	long int j = -1;
-	long int k1;
-	long int l1;
-	long int l2;
-	long int ib;
-	long int ld;
-	long int ii;
-	long int ip;
-	long int is;
-	long int nq;
-	long int nr;
-	long int ido;
-	long int ipm;
-	long int nfm1;
-	long int nl = n;
-	long int nf = 0;
-
-      L101:
-	j++;
-	if (j < 4) {
-		ntry = ntryh[j];
-	} else {
-		ntry += 2;
-	}
-
-      L104:
-	nq = nl / ntry;
-	nr = nl - ntry * nq;
-	if (nr != 0) {
-		goto L101;
-	}
-
-	nf++;
-	ifac[nf + 1] = ntry;
-	nl = nq;
-	if (ntry != 2) {
-		goto L107;
-	}
-	if (nf == 1) {
-		goto L107;
-	}
+	struct team *team = me->team;
+	long int generation;
 
-	for (i = 1; i < nf; i++) {
-		ib = nf - i + 1;
-		ifac[ib + 1] = ifac[ib];
-	}
-	ifac[2] = 2;
-
-      L107:
-	if (nl != 1) {
-		goto L104;
-	}
-	ifac[0] = n;
-	ifac[1] = nf;
-	argh = tpi / n;
-	is = 0;
-	nfm1 = nf - 1;
-	l1 = 1;
-
-	if (nfm1 == 0) {
+	if (team->threads <= 1) {
 		return;
 	}
-
-	for (k1 = 0; k1 < nfm1; k1++) {
-		ip = ifac[k1 + 2];
-		ld = 0;
-		l2 = l1 * ip;
-		ido = n / l2;
-		ipm = ip - 1;
-
-		for (j = 0; j < ipm; j++) {
-			ld += l1;
-			i = is;
-			argld = (double) ld *argh;
-			fi = 0.0;
-			for (ii = 2; ii < ido; ii += 2) {
-				fi += 1.0;
-				arg = fi * argld;
-				wa[i++] = cos(arg);
-				wa[i++] = sin(arg);
-			}
-			is += ido;
+	pthread_mutex_lock(&team->lock);
+	generation = team->generation;
+	if (++team->arrived == team->threads) {
+		team->arrived = 0;
+		team->generation++;
+		pthread_cond_broadcast(&team->done);
+	} else {
+		while (generation == team->generation) {
+			pthread_cond_wait(&team->done, &team->lock);
 		}
-		l1 = l2;
 	}
+	pthread_mutex_unlock(&team->lock);
+	return;
 }
 
-void
-__ogg_fdrffti(long int n, double *wsave, long int *ifac)
+
+/*
+ * share - find the share of a member in count items
+ *
+ * given:
+ *      me              // member whose share is wanted
+ *      count           // number of items shared by the team
+ *      begin           // where to store the first item of the share
+ *      end             // where to store the item after the share
+ */
+static void
+share(const struct member *me, long int count, long int *begin, long int *end)
 {
-	if (n == 1) {
-		return;
-	}
-	drfti1(n, wsave + n, ifac);
+	long int threads = me->team->threads;
+
+	*begin = (long int) ((double) count * (double) me->id / (double) threads);
+	*end = (me->id == threads - 1) ? count : (long int) ((double) count * (double) (me->id + 1) / (double) threads);
+	return;
 }
 
-#ifdef LBBBBBBBBBBBBB
 
-void
-__ogg_fdcosqi(int n, double *wsave, long int *ifac)
+/*
+ * unit_root - set a complex exp(-2 * pi * i * k / len)
+ *
+ * given:
+ *      k               // numerator of the angle, 0 <= k < len
+ *      len             // denominator of the angle
+ *      w               // where to store the real and the imaginary part
+ *
+ * The angle is reduced to the first octant before cos() and sin() are called, so that every
+ * root is as accurate as those functions are.
+ */
+static void
+unit_root(long int k, long int len, double *w)
 {
-	static double pih = 1.57079632679489661923132169163975;
-	static int k;
-	static double fk;
-	static double dt;
-
-	dt = pih / n;
-	fk = 0.0;
-	for (k = 0; k < n; k++) {
-		fk += 1.0;
-		wsave[k] = cos(fk * dt);
+	long int k8;		// 8 * k, reduced modulo 8 * len
+	long int oct;		// octant of the angle
+	long int rem;		// remainder of the angle within its octant, in units of 2 * pi / (8 * len)
+	double a;		// angle within the octant
+	double c;
+	double s;
+
+	k8 = 8 * k;
+	oct = k8 / len;
+	rem = k8 - oct * len;
+	if ((oct & 1) != 0) {
+		rem = len - rem;
+	}
+	a = tpi * (double) rem / (double) (8 * len);
+	c = cos(a);
+	s = sin(a);
+	switch (oct) {
+	case 0:
+		w[0] = c;
+		w[1] = -s;
+		break;
+	case 1:
+		w[0] = s;
+		w[1] = -c;
+		break;
+	case 2:
+		w[0] = -s;
+		w[1] = -c;
+		break;
+	case 3:
+		w[0] = -c;
+		w[1] = -s;
+		break;
+	case 4:
+		w[0] = -c;
+		w[1] = s;
+		break;
+	case 5:
+		w[0] = -s;
+		w[1] = c;
+		break;
+	case 6:
+		w[0] = s;
+		w[1] = c;
+		break;
+	default:
+		w[0] = c;
+		w[1] = s;
+		break;
 	}
-
-	__ogg_fdrffti(n, wsave + n, ifac);
+	return;
 }
 
-#endif /* LBBBBBBBBBBBBB */
 
-STIN void
-dradf2(long int ido, long int l1, double *cc, double *ch, double *wa1)
-{
-	long int i;
-	long int k;
-	double ti2;
-	double tr2;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-
-	t1 = 0;
-	t0 = (t2 = l1 * ido);
-	t3 = ido << 1;
-	for (k = 0; k < l1; k++) {
-		ch[t1 << 1] = cc[t1] + cc[t2];
-		ch[(t1 << 1) + t3 - 1] = cc[t1] - cc[t2];
-		t1 += ido;
-		t2 += ido;
-	}
+/*
+ * Stockham autosort stages
+ *
+ * A stage of radix r works on s interleaved transforms of length len = r * m each.  Input value
+ * q + s * (p + j * m) feeds output value q + s * (r * p + k), for q < s, p < m and j, k < r.  Each
+ * r point DFT output k is multiplied by the twiddle factor exp(-2 * pi * i * p * k / len), which the
+ * plan keeps for k = 1 .. r-1 at twiddle[(r - 1) * p + k - 1].
+ *
+ * The loop over q runs over consecutive values without dependencies, so the compiler can vectorize it.
+ */
 
-	if (ido < 2) {
-		return;
-	}
-	if (ido == 2) {
-		goto L105;
-	}
+// complex multiplication of (ar, ai) by (br, bi), into (cr, ci)
+#define CMUL(cr, ci, ar, ai, br, bi) do { \
+		double cmul_r_ = (ar) * (br) - (ai) * (bi); \
+		(ci) = (ar) * (bi) + (ai) * (br); \
+		(cr) = cmul_r_; \
+	} while (0)
 
-	t1 = 0;
-	t2 = t0;
-	for (k = 0; k < l1; k++) {
-		t3 = t2;
-		t4 = (t1 << 1) + (ido << 1);
-		t5 = t1;
-		t6 = t1 + t1;
-		for (i = 2; i < ido; i += 2) {
-			t3 += 2;
-			t4 -= 2;
-			t5 += 2;
-			t6 += 2;
-			tr2 = wa1[i - 2] * cc[t3 - 1] + wa1[i - 1] * cc[t3];
-			ti2 = wa1[i - 2] * cc[t3] - wa1[i - 1] * cc[t3 - 1];
-			ch[t6] = cc[t5] + ti2;
-			ch[t4] = ti2 - cc[t5];
-			ch[t6 - 1] = cc[t5 - 1] + tr2;
-			ch[t4 - 1] = cc[t5 - 1] - tr2;
+
+static void
+stage2(long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
+{
+	long int p;
+	long int q;
+
+	for (p = p0; p < p1; p++) {
+		const double w1r = tw[2 * p];
+		const double w1i = tw[2 * p + 1];
+		const double *x0 = x + 2 * s * p;
+		const double *x1 = x + 2 * s * (p + m);
+		double *y0 = y + 2 * s * 2 * p;
+		double *y1 = y0 + 2 * s;
+
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double dr = x0[q] - x1[q];
+			double di = x0[q + 1] - x1[q + 1];
+
+			y0[q] = x0[q] + x1[q];
+			y0[q + 1] = x0[q + 1] + x1[q + 1];
+			CMUL(y1[q], y1[q + 1], dr, di, w1r, w1i);
 		}
-		t1 += ido;
-		t2 += ido;
 	}
+	return;
+}
 
-	if (ido % 2 == 1) {
-		return;
-	}
 
-      L105:
-	t3 = (t2 = (t1 = ido) - 1);
-	t2 += t0;
-	for (k = 0; k < l1; k++) {
-		ch[t1] = -cc[t2];
-		ch[t1 - 1] = cc[t3];
-		t1 += ido << 1;
-		t2 += ido;
-		t3 += ido;
+static void
+stage3(long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
+{
+	static const double h3 = 0.86602540378443864676372317075293618;	// sqrt(3) / 2
+	long int p;
+	long int q;
+
+	for (p = p0; p < p1; p++) {
+		const double *w = tw + 4 * p;
+		const double *x0 = x + 2 * s * p;
+		const double *x1 = x + 2 * s * (p + m);
+		const double *x2 = x + 2 * s * (p + 2 * m);
+		double *y0 = y + 2 * s * 3 * p;
+		double *y1 = y0 + 2 * s;
+		double *y2 = y1 + 2 * s;
+
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double tr = x1[q] + x2[q];
+			double ti = x1[q + 1] + x2[q + 1];
+			double mr = x0[q] - 0.5 * tr;
+			double mi = x0[q + 1] - 0.5 * ti;
+			// -i * sqrt(3) / 2 * (x1 - x2)
+			double vr = h3 * (x1[q + 1] - x2[q + 1]);
+			double vi = -h3 * (x1[q] - x2[q]);
+
+			y0[q] = x0[q] + tr;
+			y0[q + 1] = x0[q + 1] + ti;
+			CMUL(y1[q], y1[q + 1], mr + vr, mi + vi, w[0], w[1]);
+			CMUL(y2[q], y2[q + 1], mr - vr, mi - vi, w[2], w[3]);
+		}
 	}
+	return;
 }
 
-STIN void
-dradf4(long int ido, long int l1, double *cc, double *ch, double *wa1, double *wa2, double *wa3)
+
+static void
+stage4(long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
 {
-	static double hsqt2 = .70710678118654752440084436210485;
-	long int i;
-	long int k;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	double ci2;
-	double ci3;
-	double ci4;
-	double cr2;
-	double cr3;
-	double cr4;
-	double ti1;
-	double ti2;
-	double ti3;
-	double ti4;
-	double tr1;
-	double tr2;
-	double tr3;
-	double tr4;
-
-	t0 = l1 * ido;
-	t1 = t0;
-	t4 = t1 << 1;
-	t2 = t1 + (t1 << 1);
-	t3 = 0;
-
-	for (k = 0; k < l1; k++) {
-		tr1 = cc[t1] + cc[t2];
-		tr2 = cc[t3] + cc[t4];
-		ch[t5 = t3 << 2] = tr1 + tr2;
-		ch[(ido << 2) + t5 - 1] = tr2 - tr1;
-		ch[(t5 += (ido << 1)) - 1] = cc[t3] - cc[t4];
-		ch[t5] = cc[t2] - cc[t1];
-
-		t1 += ido;
-		t2 += ido;
-		t3 += ido;
-		t4 += ido;
+	long int p;
+	long int q;
+
+	for (p = p0; p < p1; p++) {
+		const double *w = tw + 6 * p;
+		const double *x0 = x + 2 * s * p;
+		const double *x1 = x + 2 * s * (p + m);
+		const double *x2 = x + 2 * s * (p + 2 * m);
+		const double *x3 = x + 2 * s * (p + 3 * m);
+		double *y0 = y + 2 * s * 4 * p;
+		double *y1 = y0 + 2 * s;
+		double *y2 = y1 + 2 * s;
+		double *y3 = y2 + 2 * s;
+
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double t0r = x0[q] + x2[q];
+			double t0i = x0[q + 1] + x2[q + 1];
+			double t1r = x0[q] - x2[q];
+			double t1i = x0[q + 1] - x2[q + 1];
+			double t2r = x1[q] + x3[q];
+			double t2i = x1[q + 1] + x3[q + 1];
+			// -i * (x1 - x3)
+			double t3r = x1[q + 1] - x3[q + 1];
+			double t3i = x3[q] - x1[q];
+
+			y0[q] = t0r + t2r;
+			y0[q + 1] = t0i + t2i;
+			CMUL(y1[q], y1[q + 1], t1r + t3r, t1i + t3i, w[0], w[1]);
+			CMUL(y2[q], y2[q + 1], t0r - t2r, t0i - t2i, w[2], w[3]);
+			CMUL(y3[q], y3[q + 1], t1r - t3r, t1i - t3i, w[4], w[5]);
+		}
 	}
+	return;
+}
 
-	if (ido < 2) {
-		return;
-	}
-	if (ido == 2) {
-		goto L105;
-	}
 
-	t1 = 0;
-	for (k = 0; k < l1; k++) {
-		t2 = t1;
-		t4 = t1 << 2;
-		t5 = (t6 = ido << 1) + t4;
-		for (i = 2; i < ido; i += 2) {
-			t3 = (t2 += 2);
-			t4 += 2;
-			t5 -= 2;
-
-			t3 += t0;
-			cr2 = wa1[i - 2] * cc[t3 - 1] + wa1[i - 1] * cc[t3];
-			ci2 = wa1[i - 2] * cc[t3] - wa1[i - 1] * cc[t3 - 1];
-			t3 += t0;
-			cr3 = wa2[i - 2] * cc[t3 - 1] + wa2[i - 1] * cc[t3];
-			ci3 = wa2[i - 2] * cc[t3] - wa2[i - 1] * cc[t3 - 1];
-			t3 += t0;
-			cr4 = wa3[i - 2] * cc[t3 - 1] + wa3[i - 1] * cc[t3];
-			ci4 = wa3[i - 2] * cc[t3] - wa3[i - 1] * cc[t3 - 1];
-
-			tr1 = cr2 + cr4;
-			tr4 = cr4 - cr2;
-			ti1 = ci2 + ci4;
-			ti4 = ci2 - ci4;
-			ti2 = cc[t2] + ci3;
-			ti3 = cc[t2] - ci3;
-			tr2 = cc[t2 - 1] + cr3;
-			tr3 = cc[t2 - 1] - cr3;
-
-
-			ch[t4 - 1] = tr1 + tr2;
-			ch[t4] = ti1 + ti2;
-
-			ch[t5 - 1] = tr3 - ti4;
-			ch[t5] = tr4 - ti3;
-
-			ch[t4 + t6 - 1] = ti4 + tr3;
-			ch[t4 + t6] = tr4 + ti3;
-
-			ch[t5 + t6 - 1] = tr2 - tr1;
-			ch[t5 + t6] = ti1 - ti2;
+static void
+stage5(long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
+{
+	static const double c1 = 0.30901699437494742410229341718281906;	// cos(2 * pi / 5)
+	static const double c2 = -0.80901699437494742410229341718281906;	// cos(4 * pi / 5)
+	static const double s1 = 0.95105651629515357211643933337938214;	// sin(2 * pi / 5)
+	static const double s2 = 0.58778525229247312916870595463907277;	// sin(4 * pi / 5)
+	long int p;
+	long int q;
+
+	for (p = p0; p < p1; p++) {
+		const double *w = tw + 8 * p;
+		const double *x0 = x + 2 * s * p;
+		const double *x1 = x + 2 * s * (p + m);
+		const double *x2 = x + 2 * s * (p + 2 * m);
+		const double *x3 = x + 2 * s * (p + 3 * m);
+		const double *x4 = x + 2 * s * (p + 4 * m);
+		double *y0 = y + 2 * s * 5 * p;
+		double *y1 = y0 + 2 * s;
+		double *y2 = y1 + 2 * s;
+		double *y3 = y2 + 2 * s;
+		double *y4 = y3 + 2 * s;
+
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double t1r = x1[q] + x4[q];
+			double t1i = x1[q + 1] + x4[q + 1];
+			double t2r = x2[q] + x3[q];
+			double t2i = x2[q + 1] + x3[q + 1];
+			double t3r = x1[q] - x4[q];
+			double t3i = x1[q + 1] - x4[q + 1];
+			double t4r = x2[q] - x3[q];
+			double t4i = x2[q + 1] - x3[q + 1];
+			double u1r = x0[q] + c1 * t1r + c2 * t2r;
+			double u1i = x0[q + 1] + c1 * t1i + c2 * t2i;
+			double u2r = x0[q] + c2 * t1r + c1 * t2r;
+			double u2i = x0[q + 1] + c2 * t1i + c1 * t2i;
+			double v1r = s1 * t3r + s2 * t4r;
+			double v1i = s1 * t3i + s2 * t4i;
+			double v2r = s2 * t3r - s1 * t4r;
+			double v2i = s2 * t3i - s1 * t4i;
+
+			y0[q] = x0[q] + t1r + t2r;
+			y0[q + 1] = x0[q + 1] + t1i + t2i;
+			// output k is u - i * v for k = 1, 2 and u + i * v for k = 3, 4
+			CMUL(y1[q], y1[q + 1], u1r + v1i, u1i - v1r, w[0], w[1]);
+			CMUL(y2[q], y2[q + 1], u2r + v2i, u2i - v2r, w[2], w[3]);
+			CMUL(y3[q], y3[q + 1], u2r - v2i, u2i + v2r, w[4], w[5]);
+			CMUL(y4[q], y4[q + 1], u1r - v1i, u1i + v1r, w[6], w[7]);
 		}
-		t1 += ido;
-	}
-	if (ido % 2 == 1) {
-		return;
-	}
-
-      L105:
-
-	t2 = (t1 = t0 + ido - 1) + (t0 << 1);
-	t3 = ido << 2;
-	t4 = ido;
-	t5 = ido << 1;
-	t6 = ido;
-
-	for (k = 0; k < l1; k++) {
-		ti1 = -hsqt2 * (cc[t1] + cc[t2]);
-		tr1 = hsqt2 * (cc[t1] - cc[t2]);
-		ch[t4 - 1] = tr1 + cc[t6 - 1];
-		ch[t4 + t5 - 1] = cc[t6 - 1] - tr1;
-		ch[t4] = ti1 - cc[t1 + t0];
-		ch[t4 + t5] = ti1 + cc[t1 + t0];
-		t1 += ido;
-		t2 += ido;
-		t4 += t3;
-		t6 += ido;
 	}
+	return;
 }
 
-STIN void
-dradfg(long int ido, long int ip, long int l1, long int idl1, double *cc, double *c1, double *c2, double *ch,
-       double *ch2, double *wa)
-{
-	static double tpi = 6.28318530717958647692528676655900577;
-	long int idij;
-	long int ipph;
-	long int i;
-	long int j;
-	long int k;
-	long int l;
-	long int ic;
-	long int ik;
-	long int is;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	long int t7;
-	long int t8;
-	long int t9;
-	long int t10;
-	double dc2;
-	double ai1;
-	double ai2;
-	double ar1;
-	double ar2;
-	double ds2;
-	long int nbd;
-	double dcp;
-	double arg;
-	double dsp;
-	double ar1h;
-	double ar2h;
-	long int idp2;
-	long int ipp2;
-
-	arg = tpi / (double) ip;
-	dcp = cos(arg);
-	dsp = sin(arg);
-	ipph = (ip + 1) >> 1;
-	ipp2 = ip;
-	idp2 = ido;
-	nbd = (ido - 1) >> 1;
-	t0 = l1 * ido;
-	t10 = ip * ido;
-
-	if (ido == 1) {
-		goto L119;
-	}
-	for (ik = 0; ik < idl1; ik++) {
-		ch2[ik] = c2[ik];
-	}
 
-	t1 = 0;
-	for (j = 1; j < ip; j++) {
-		t1 += t0;
-		t2 = t1;
-		for (k = 0; k < l1; k++) {
-			ch[t2] = c1[t2];
-			t2 += ido;
+static void
+stage8(long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
+{
+	static const double r2 = 0.70710678118654752440084436210484904;	// sqrt(2) / 2
+	long int p;
+	long int q;
+	int j;
+
+	for (p = p0; p < p1; p++) {
+		const double *w = tw + 14 * p;
+		const double *xj[8];
+		double *yk[8];
+
+		for (j = 0; j < 8; j++) {
+			xj[j] = x + 2 * s * (p + j * m);
+			yk[j] = y + 2 * s * (8 * p + j);
 		}
-	}
-
-	is = -ido;
-	t1 = 0;
-	if (nbd > l1) {
-		for (j = 1; j < ip; j++) {
-			t1 += t0;
-			is += ido;
-			t2 = -ido + t1;
-			for (k = 0; k < l1; k++) {
-				idij = is - 1;
-				t2 += ido;
-				t3 = t2;
-				for (i = 2; i < ido; i += 2) {
-					idij += 2;
-					t3 += 2;
-					ch[t3 - 1] = wa[idij - 1] * c1[t3 - 1] + wa[idij] * c1[t3];
-					ch[t3] = wa[idij - 1] * c1[t3] - wa[idij] * c1[t3 - 1];
-				}
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double er[4], ei[4];	// 4 point DFT of the even inputs
+			double or[4], oi[4];	// 4 point DFT of the odd inputs
+			double ar;
+			double ai;
+
+			// 4 point DFT of x0, x2, x4, x6
+			{
+				double t0r = xj[0][q] + xj[4][q], t0i = xj[0][q + 1] + xj[4][q + 1];
+				double t1r = xj[0][q] - xj[4][q], t1i = xj[0][q + 1] - xj[4][q + 1];
+				double t2r = xj[2][q] + xj[6][q], t2i = xj[2][q + 1] + xj[6][q + 1];
+				double t3r = xj[2][q + 1] - xj[6][q + 1], t3i = xj[6][q] - xj[2][q];
+
+				er[0] = t0r + t2r;
+				ei[0] = t0i + t2i;
+				er[1] = t1r + t3r;
+				ei[1] = t1i + t3i;
+				er[2] = t0r - t2r;
+				ei[2] = t0i - t2i;
+				er[3] = t1r - t3r;
+				ei[3] = t1i - t3i;
 			}
-		}
-	} else {
-		for (j = 1; j < ip; j++) {
-			is += ido;
-			idij = is - 1;
-			t1 += t0;
-			t2 = t1;
-			for (i = 2; i < ido; i += 2) {
-				idij += 2;
-				t2 += 2;
-				t3 = t2;
-				for (k = 0; k < l1; k++) {
-					ch[t3 - 1] = wa[idij - 1] * c1[t3 - 1] + wa[idij] * c1[t3];
-					ch[t3] = wa[idij - 1] * c1[t3] - wa[idij] * c1[t3 - 1];
-					t3 += ido;
-				}
+			// 4 point DFT of x1, x3, x5, x7
+			{
+				double t0r = xj[1][q] + xj[5][q], t0i = xj[1][q + 1] + xj[5][q + 1];
+				double t1r = xj[1][q] - xj[5][q], t1i = xj[1][q + 1] - xj[5][q + 1];
+				double t2r = xj[3][q] + xj[7][q], t2i = xj[3][q + 1] + xj[7][q + 1];
+				double t3r = xj[3][q + 1] - xj[7][q + 1], t3i = xj[7][q] - xj[3][q];
+
+				or[0] = t0r + t2r;
+				oi[0] = t0i + t2i;
+				or[1] = t1r + t3r;
+				oi[1] = t1i + t3i;
+				or[2] = t0r - t2r;
+				oi[2] = t0i - t2i;
+				or[3] = t1r - t3r;
+				oi[3] = t1i - t3i;
 			}
-		}
-	}
-
-	t1 = 0;
-	t2 = ipp2 * t0;
-	if (nbd < l1) {
-		for (j = 1; j < ipph; j++) {
-			t1 += t0;
-			t2 -= t0;
-			t3 = t1;
-			t4 = t2;
-			for (i = 2; i < ido; i += 2) {
-				t3 += 2;
-				t4 += 2;
-				t5 = t3 - ido;
-				t6 = t4 - ido;
-				for (k = 0; k < l1; k++) {
-					t5 += ido;
-					t6 += ido;
-					c1[t5 - 1] = ch[t5 - 1] + ch[t6 - 1];
-					c1[t6 - 1] = ch[t5] - ch[t6];
-					c1[t5] = ch[t5] + ch[t6];
-					c1[t6] = ch[t6 - 1] - ch[t5 - 1];
-				}
+			// multiply the odd DFT by exp(-2 * pi * i * k / 8)
+			ar = r2 * (or[1] + oi[1]);
+			ai = r2 * (oi[1] - or[1]);
+			or[1] = ar;
+			oi[1] = ai;
+			ar = oi[2];
+			ai = -or[2];
+			or[2] = ar;
+			oi[2] = ai;
+			ar = r2 * (oi[3] - or[3]);
+			ai = -r2 * (or[3] + oi[3]);
+			or[3] = ar;
+			oi[3] = ai;
+
+			yk[0][q] = er[0] + or[0];
+			yk[0][q + 1] = ei[0] + oi[0];
+			for (j = 1; j < 4; j++) {
+				CMUL(yk[j][q], yk[j][q + 1], er[j] + or[j], ei[j] + oi[j], w[2 * j - 2], w[2 * j - 1]);
 			}
-		}
-	} else {
-		for (j = 1; j < ipph; j++) {
-			t1 += t0;
-			t2 -= t0;
-			t3 = t1;
-			t4 = t2;
-			for (k = 0; k < l1; k++) {
-				t5 = t3;
-				t6 = t4;
-				for (i = 2; i < ido; i += 2) {
-					t5 += 2;
-					t6 += 2;
-					c1[t5 - 1] = ch[t5 - 1] + ch[t6 - 1];
-					c1[t6 - 1] = ch[t5] - ch[t6];
-					c1[t5] = ch[t5] + ch[t6];
-					c1[t6] = ch[t6 - 1] - ch[t5 - 1];
-				}
-				t3 += ido;
-				t4 += ido;
+			for (j = 0; j < 4; j++) {
+				CMUL(yk[j + 4][q], yk[j + 4][q + 1], er[j] - or[j], ei[j] - oi[j], w[2 * j + 6], w[2 * j + 7]);
 			}
 		}
 	}
+	return;
+}
 
-      L119:
-	for (ik = 0; ik < idl1; ik++) {
-		c2[ik] = ch2[ik];
-	}
-
-	t1 = 0;
-	t2 = ipp2 * idl1;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1 - ido;
-		t4 = t2 - ido;
-		for (k = 0; k < l1; k++) {
-			t3 += ido;
-			t4 += ido;
-			c1[t3] = ch[t3] + ch[t4];
-			c1[t4] = ch[t4] - ch[t3];
-		}
-	}
 
-	ar1 = 1.0;
-	ai1 = 0.0;
-	t1 = 0;
-	t2 = ipp2 * idl1;
-	t3 = (ip - 1) * idl1;
-	for (l = 1; l < ipph; l++) {
-		t1 += idl1;
-		t2 -= idl1;
-		ar1h = dcp * ar1 - dsp * ai1;
-		ai1 = dcp * ai1 + dsp * ar1;
-		ar1 = ar1h;
-		t4 = t1;
-		t5 = t2;
-		t6 = t3;
-		t7 = idl1;
-
-		for (ik = 0; ik < idl1; ik++) {
-			ch2[t4++] = c2[ik] + ar1 * c2[t7++];
-			ch2[t5++] = ai1 * c2[t6++];
-		}
+/*
+ * stage_odd - Stockham stage of an odd prime radix up to DFFT_MAX_RADIX
+ *
+ * The r point DFT is done directly, pairing outputs k and r - k, which share the sums and
+ * differences of inputs j and r - j.
+ */
+static void
+stage_odd(long int r, long int s, long int m, long int p0, long int p1, long int q0, long int q1,
+	    const double *tw, const double *x, double *y)
+{
+	double c[DFFT_MAX_RADIX];	// cos(2 * pi * k / r)
+	double sn[DFFT_MAX_RADIX];	// sin(2 * pi * k / r)
+	double sr[DFFT_MAX_RADIX];	// real part of x_j + x_{r-j}
+	double si[DFFT_MAX_RADIX];	// imaginary part of x_j + x_{r-j}
+	double dr[DFFT_MAX_RADIX];	// real part of x_j - x_{r-j}
+	double di[DFFT_MAX_RADIX];	// imaginary part of x_j - x_{r-j}
+	double w[2];
+	long int half = r / 2;
+	long int p;
+	long int q;
+	long int j;
+	long int k;
 
-		dc2 = ar1;
-		ds2 = ai1;
-		ar2 = ar1;
-		ai2 = ai1;
-
-		t4 = idl1;
-		t5 = (ipp2 - 1) * idl1;
-		for (j = 2; j < ipph; j++) {
-			t4 += idl1;
-			t5 -= idl1;
-
-			ar2h = dc2 * ar2 - ds2 * ai2;
-			ai2 = dc2 * ai2 + ds2 * ar2;
-			ar2 = ar2h;
-
-			t6 = t1;
-			t7 = t2;
-			t8 = t4;
-			t9 = t5;
-			for (ik = 0; ik < idl1; ik++) {
-				ch2[t6++] += ar2 * c2[t8++];
-				ch2[t7++] += ai2 * c2[t9++];
+	for (k = 0; k < r; k++) {
+		unit_root(k, r, w);
+		c[k] = w[0];
+		sn[k] = -w[1];
+	}
+	for (p = p0; p < p1; p++) {
+		const double *wp = tw + 2 * (r - 1) * p;
+		const double *x0 = x + 2 * s * p;
+		double *y0 = y + 2 * s * r * p;
+
+		for (q = 2 * q0; q < 2 * q1; q += 2) {
+			double b0r = x0[q];
+			double b0i = x0[q + 1];
+
+			for (j = 1; j <= half; j++) {
+				const double *xa = x + 2 * s * (p + j * m);
+				const double *xb = x + 2 * s * (p + (r - j) * m);
+
+				sr[j] = xa[q] + xb[q];
+				si[j] = xa[q + 1] + xb[q + 1];
+				dr[j] = xa[q] - xb[q];
+				di[j] = xa[q + 1] - xb[q + 1];
+				b0r += sr[j];
+				b0i += si[j];
 			}
-		}
-	}
-
-	t1 = 0;
-	for (j = 1; j < ipph; j++) {
-		t1 += idl1;
-		t2 = t1;
-		for (ik = 0; ik < idl1; ik++) {
-			ch2[ik] += c2[t2++];
-		}
-	}
-
-	if (ido < l1) {
-		goto L132;
-	}
-
-	t1 = 0;
-	t2 = 0;
-	for (k = 0; k < l1; k++) {
-		t3 = t1;
-		t4 = t2;
-		for (i = 0; i < ido; i++) {
-			cc[t4++] = ch[t3++];
-		}
-		t1 += ido;
-		t2 += t10;
-	}
-
-	goto L135;
-
-      L132:
-	for (i = 0; i < ido; i++) {
-		t1 = i;
-		t2 = i;
-		for (k = 0; k < l1; k++) {
-			cc[t2] = ch[t1];
-			t1 += ido;
-			t2 += t10;
-		}
-	}
-
-      L135:
-	t1 = 0;
-	t2 = ido << 1;
-	t3 = 0;
-	t4 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-
-		t1 += t2;
-		t3 += t0;
-		t4 -= t0;
-
-		t5 = t1;
-		t6 = t3;
-		t7 = t4;
-
-		for (k = 0; k < l1; k++) {
-			cc[t5 - 1] = ch[t6];
-			cc[t5] = ch[t7];
-			t5 += t10;
-			t6 += ido;
-			t7 += ido;
-		}
-	}
-
-	if (ido == 1) {
-		return;
-	}
-	if (nbd < l1) {
-		goto L141;
-	}
-
-	t1 = -ido;
-	t3 = 0;
-	t4 = 0;
-	t5 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t2;
-		t3 += t2;
-		t4 += t0;
-		t5 -= t0;
-		t6 = t1;
-		t7 = t3;
-		t8 = t4;
-		t9 = t5;
-		for (k = 0; k < l1; k++) {
-			for (i = 2; i < ido; i += 2) {
-				ic = idp2 - i;
-				cc[i + t7 - 1] = ch[i + t8 - 1] + ch[i + t9 - 1];
-				cc[ic + t6 - 1] = ch[i + t8 - 1] - ch[i + t9 - 1];
-				cc[i + t7] = ch[i + t8] + ch[i + t9];
-				cc[ic + t6] = ch[i + t9] - ch[i + t8];
+			y0[q] = b0r;
+			y0[q + 1] = b0i;
+			for (k = 1; k <= half; k++) {
+				double ur = x0[q];
+				double ui = x0[q + 1];
+				double vr = 0.0;
+				double vi = 0.0;
+				double *ya = y0 + 2 * s * k;
+				double *yb = y0 + 2 * s * (r - k);
+
+				for (j = 1; j <= half; j++) {
+					long int jk = (j * k) % r;
+
+					ur += c[jk] * sr[j];
+					ui += c[jk] * si[j];
+					vr += sn[jk] * dr[j];
+					vi += sn[jk] * di[j];
+				}
+				// output k is u - i * v and output r - k is u + i * v
+				CMUL(ya[q], ya[q + 1], ur + vi, ui - vr, wp[2 * (k - 1)], wp[2 * (k - 1) + 1]);
+				CMUL(yb[q], yb[q + 1], ur - vi, ui + vr, wp[2 * (r - k - 1)], wp[2 * (r - k - 1) + 1]);
 			}
-			t6 += t10;
-			t7 += t10;
-			t8 += ido;
-			t9 += ido;
 		}
 	}
-
 	return;
-
-      L141:
-
-	t1 = -ido;
-	t3 = 0;
-	t4 = 0;
-	t5 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t2;
-		t3 += t2;
-		t4 += t0;
-		t5 -= t0;
-		for (i = 2; i < ido; i += 2) {
-			t6 = idp2 + t1 - i;
-			t7 = i + t3;
-			t8 = i + t4;
-			t9 = i + t5;
-			for (k = 0; k < l1; k++) {
-				cc[t7 - 1] = ch[t8 - 1] + ch[t9 - 1];
-				cc[t6 - 1] = ch[t8 - 1] - ch[t9 - 1];
-				cc[t7] = ch[t8] + ch[t9];
-				cc[t6] = ch[t9] - ch[t8];
-				t6 += t10;
-				t7 += t10;
-				t8 += ido;
-				t9 += ido;
-			}
-		}
-	}
 }
 
-STIN void
-drftf1(long int n, double *c, double *ch, double *wa, long int *ifac)
-{
-	long int i;
-	long int k1;
-	long int l1;
-	long int l2;
-	long int na;
-	long int kh;
-	long int nf;
-	long int ip;
-	long int iw;
-	long int ido;
-	long int idl1;
-	long int ix2;
-	long int ix3;
-
-	nf = ifac[1];
-	na = 1;
-	l2 = n;
-	iw = n;
-
-	for (k1 = 0; k1 < nf; k1++) {
-		kh = nf - k1;
-		ip = ifac[kh + 1];
-		l1 = l2 / ip;
-		ido = n / l2;
-		idl1 = ido * l1;
-		iw -= (ip - 1) * ido;
-		na = 1 - na;
-
-		if (ip != 4) {
-			goto L102;
-		}
 
-		ix2 = iw + ido;
-		ix3 = ix2 + ido;
-		if (na != 0) {
-			dradf4(ido, l1, ch, c, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
-		} else {
-			dradf4(ido, l1, c, ch, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
+/*
+ * cplan_create - plan a complex forward DFT
+ *
+ * given:
+ *      len             // complex transform length, > 0
+ *
+ * returns:
+ *      malloced plan, free with cplan_destroy()
+ *
+ * This function does not return on error.
+ */
+static struct dfft_cplan *
+cplan_create(long int len)
+{
+	static const long int radices[] = {8, 4, 2, 3, 5, 7, 11, 13, 0};	// radices tried, in order
+	struct dfft_cplan *plan;	// plan being formed
+	long int rest;			// part of len not yet factored
+	long int count;			// number of twiddle factors of all stages
+	struct team one = {1};		// team of the calling thread alone
+	struct member solo = {&one, 0, NULL, NULL, NULL, NULL};	// the calling thread as its only member
+	long int stage_len;		// transform length at a stage
+	long int m;
+	long int r;
+	long int p;
+	long int k;
+	double *w;
+	int i;
+
+	plan = calloc(1, sizeof(*plan));
+	if (plan == NULL) {
+		errp(240, __func__, "cannot calloc a plan of %lu bytes", sizeof(*plan));
+	}
+	plan->len = len;
+
+	/*
+	 * Factor len into the radices
+	 */
+	rest = len;
+	for (i = 0; radices[i] != 0 && rest > 1; i++) {
+		while (rest % radices[i] == 0 && plan->nfactors < DFFT_MAX_FACTORS) {
+			plan->factor[plan->nfactors++] = radices[i];
+			rest /= radices[i];
 		}
-		goto L110;
+	}
 
-	      L102:
-		if (ip != 2) {
-			goto L104;
+	/*
+	 * Form the twiddle factors of each stage
+	 */
+	if (rest == 1) {
+		count = 0;
+		stage_len = len;
+		for (i = 0; i < plan->nfactors; i++) {
+			count += (plan->factor[i] - 1) * (stage_len / plan->factor[i]);
+			stage_len /= plan->factor[i];
 		}
-		if (na != 0) {
-			goto L103;
+		plan->twiddles = malloc((size_t) (2 * count + 2) * sizeof(double));
+		if (plan->twiddles == NULL) {
+			errp(240, __func__, "cannot malloc %ld twiddle factors", count);
 		}
-
-		dradf2(ido, l1, c, ch, wa + iw - 1);
-		goto L110;
-
-	      L103:
-		dradf2(ido, l1, ch, c, wa + iw - 1);
-		goto L110;
-
-	      L104:
-		if (ido == 1) {
-			na = 1 - na;
+		w = plan->twiddles;
+		stage_len = len;
+		for (i = 0; i < plan->nfactors; i++) {
+			r = plan->factor[i];
+			m = stage_len / r;
+			plan->twiddle[i] = w;
+			for (p = 0; p < m; p++) {
+				for (k = 1; k < r; k++) {
+					unit_root(p * k, stage_len, w);
+					w += 2;
+				}
+			}
+			stage_len = m;
 		}
-		if (na != 0) {
-			goto L109;
+		plan->work_len = (size_t) (2 * len);
+		return plan;
+	}
+
+	/*
+	 * Bluestein's algorithm
+	 *
+	 * As j * k = (j^2 + k^2 - (k - j)^2) / 2, output k is chirp[k] times the convolution of
+	 * x[j] * chirp[j] with conj(chirp), and the convolution is done with power of 2 transforms.
+	 */
+	plan->nfactors = 0;
+	for (plan->blue_len = 1; plan->blue_len < 2 * len - 1; plan->blue_len *= 2) {
+	}
+	plan->blue = cplan_create(plan->blue_len);
+	plan->chirp = malloc((size_t) (2 * len) * sizeof(double));
+	if (plan->chirp == NULL) {
+		errp(240, __func__, "cannot malloc a chirp of %ld complex values", len);
+	}
+	plan->blue_filter = calloc((size_t) (2 * plan->blue_len), sizeof(double));
+	if (plan->blue_filter == NULL) {
+		errp(240, __func__, "cannot calloc a filter of %ld complex values", plan->blue_len);
+	}
+	w = malloc((size_t) (2 * plan->blue_len) * sizeof(double));
+	if (w == NULL) {
+		errp(240, __func__, "cannot malloc work space of %ld complex values", plan->blue_len);
+	}
+	for (k = 0; k < len; k++) {
+		// exp(-pi * i * k^2 / len) = exp(-2 * pi * i * (k^2 mod 2 * len) / (2 * len))
+		unit_root((long int) (((unsigned long long) k * (unsigned long long) k) % (unsigned long long) (2 * len)),
+			  2 * len, &plan->chirp[2 * k]);
+	}
+	for (k = 0; k < len; k++) {
+		plan->blue_filter[2 * k] = plan->chirp[2 * k] / (double) plan->blue_len;
+		plan->blue_filter[2 * k + 1] = -plan->chirp[2 * k + 1] / (double) plan->blue_len;
+		if (k > 0) {
+			plan->blue_filter[2 * (plan->blue_len - k)] = plan->blue_filter[2 * k];
+			plan->blue_filter[2 * (plan->blue_len - k) + 1] = plan->blue_filter[2 * k + 1];
 		}
-
-		dradfg(ido, ip, l1, idl1, c, c, c, ch, ch, wa + iw - 1);
-		na = 1;
-		goto L110;
-
-	      L109:
-		dradfg(ido, ip, l1, idl1, ch, ch, ch, c, c, wa + iw - 1);
-		na = 0;
-
-	      L110:
-		l2 = l1;
-	}
-
-	if (na == 1) {
-		return;
-	}
-
-	for (i = 0; i < n; i++) {
-		c[i] = ch[i];
 	}
-}
-
-void
-__ogg_fdrfftf(long int n, double *r, double *wsave, long int *ifac)
-{
-	if (n == 1) {
-		return;
+	if (cplan_forward(plan->blue, plan->blue_filter, w, NULL, &solo) != plan->blue_filter) {
+		memcpy(plan->blue_filter, w, (size_t) (2 * plan->blue_len) * sizeof(double));
 	}
-	drftf1(n, r, wsave, wsave + n, ifac);
+	free(w);
+	plan->work_len = (size_t) (4 * plan->blue_len);
+	return plan;
 }
 
-#ifdef LBBBBBBBBBBBBBBBB
 
-STIN void
-dcsqf1(int n, double *x, double *w, double *xh, int *ifac)
+/*
+ * cplan_destroy - free a plan formed by cplan_create()
+ *
+ * given:
+ *      plan            // plan to free, may be NULL
+ */
+static void
+cplan_destroy(struct dfft_cplan *plan)
 {
-	long int modn;
-	long int i;
-	long int k;
-	long int kc;
-	long int np2;
-	long int ns2;
-	double xim1;
-
-	ns2 = (n + 1) >> 1;
-	np2 = n;
-
-	kc = np2;
-	for (k = 1; k < ns2; k++) {
-		kc--;
-		xh[k] = x[k] + x[kc];
-		xh[kc] = x[k] - x[kc];
-	}
-
-	modn = n % 2;
-	if (modn == 0) {
-		xh[ns2] = x[ns2] + x[ns2];
+	if (plan == NULL) {
+		return;
 	}
-
-	for (k = 1; k < ns2; k++) {
-		kc = np2 - k;
-		x[k] = w[k - 1] * xh[kc] + w[kc - 1] * xh[k];
-		x[kc] = w[k - 1] * xh[k] - w[kc - 1] * xh[kc];
+	if (plan->twiddles != NULL) {
+		free(plan->twiddles);
+		plan->twiddles = NULL;
 	}
-
-	if (modn == 0) {
-		x[ns2] = w[ns2 - 1] * xh[ns2];
+	if (plan->chirp != NULL) {
+		free(plan->chirp);
+		plan->chirp = NULL;
 	}
-
-	__ogg_fdrfftf(n, x, xh, ifac);
-
-	for (i = 2; i < n; i += 2) {
-		xim1 = x[i - 1] - x[i];
-		x[i] = x[i - 1] + x[i];
-		x[i - 1] = xim1;
+	if (plan->blue_filter != NULL) {
+		free(plan->blue_filter);
+		plan->blue_filter = NULL;
 	}
+	cplan_destroy(plan->blue);
+	plan->blue = NULL;
+	free(plan);
+	return;
 }
 
-void
-__ogg_fdcosqf(int n, double *x, double *wsave, int *ifac)
-{
-	static double sqrt2 = 1.4142135623730950488016887242097;
-	double tsqx;
 
-	switch (n) {
-	case 0:
-	case 1:
-		return;
-	case 2:
-		tsqx = sqrt2 * x[1];
-		x[1] = x[0] - tsqx;
-		x[0] += tsqx;
-		return;
-	default:
-		dcsqf1(n, x, wsave, wsave + n, ifac);
-		return;
-	}
-}
-
-STIN void
-dradb2(int ido, int l1, double *cc, double *ch, double *wa1)
+/*
+ * cplan_forward - do a complex forward DFT
+ *
+ * given:
+ *      plan            // plan of the transform
+ *      x               // plan->len complex values to transform, overwritten
+ *      y               // work space of plan->len complex values
+ *      scratch         // Bluestein: work space of 2 * plan->blue_len complex values, else unused
+ *      me              // member of the team doing the transform
+ *
+ * returns:
+ *      x or y, whichever holds the plan->len outputs in natural order
+ *
+ * All members of the team call this function with the same arguments.  A stage is shared out by
+ * its transforms when there are more of them than values in each, else by its values.
+ */
+static double *
+cplan_forward(const struct dfft_cplan *plan, double *x, double *y, double *scratch, struct member *me)
 {
-	long int i;
+	double *src = x;	// input of the next stage
+	double *dst = y;	// output of the next stage
+	double *tmp;
+	long int stage_len;	// transform length at a stage
+	long int s = 1;		// number of interleaved transforms at a stage
+	long int m;
+	long int r;
+	long int p0;		// first p of the share of this member
+	long int p1;		// p after the share of this member
+	long int q0;		// first q of the share of this member
+	long int q1;		// q after the share of this member
 	long int k;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	double ti2;
-	double tr2;
-
-	t0 = l1 * ido;
-
-	t1 = 0;
-	t2 = 0;
-	t3 = (ido << 1) - 1;
-	for (k = 0; k < l1; k++) {
-		ch[t1] = cc[t2] + cc[t3 + t2];
-		ch[t1 + t0] = cc[t2] - cc[t3 + t2];
-		t2 = (t1 += ido) << 1;
-	}
-
-	if (ido < 2) {
-		return;
-	}
-	if (ido == 2) {
-		goto L105;
-	}
-
-	t1 = 0;
-	t2 = 0;
-	for (k = 0; k < l1; k++) {
-		t3 = t1;
-		t5 = (t4 = t2) + (ido << 1);
-		t6 = t0 + t1;
-		for (i = 2; i < ido; i += 2) {
-			t3 += 2;
-			t4 += 2;
-			t5 -= 2;
-			t6 += 2;
-			ch[t3 - 1] = cc[t4 - 1] + cc[t5 - 1];
-			tr2 = cc[t4 - 1] - cc[t5 - 1];
-			ch[t3] = cc[t4] - cc[t5];
-			ti2 = cc[t4] + cc[t5];
-			ch[t6 - 1] = wa1[i - 2] * tr2 - wa1[i - 1] * ti2;
-			ch[t6] = wa1[i - 2] * ti2 + wa1[i - 1] * tr2;
+	long int k0;		// first value of the share of this member
+	long int k1;		// value after the share of this member
+	int i;
+
+	/*
+	 * Stockham stages, each one from src to dst
+	 */
+	if (plan->blue_len == 0) {
+		stage_len = plan->len;
+		for (i = 0; i < plan->nfactors; i++) {
+			r = plan->factor[i];
+			m = stage_len / r;
+			if (m >= s) {
+				share(me, m, &p0, &p1);
+				q0 = 0;
+				q1 = s;
+			} else {
+				p0 = 0;
+				p1 = m;
+				share(me, s, &q0, &q1);
+			}
+			switch (r) {
+			case 2:
+				stage2(s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			case 3:
+				stage3(s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			case 4:
+				stage4(s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			case 5:
+				stage5(s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			case 8:
+				stage8(s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			default:
+				stage_odd(r, s, m, p0, p1, q0, q1, plan->twiddle[i], src, dst);
+				break;
+			}
+			team_wait(me);
+			tmp = src;
+			src = dst;
+			dst = tmp;
+			s *= r;
+			stage_len = m;
 		}
-		t2 = (t1 += ido) << 1;
-	}
-
-	if (ido % 2 == 1) {
-		return;
-	}
-
-      L105:
-	t1 = ido - 1;
-	t2 = ido - 1;
-	for (k = 0; k < l1; k++) {
-		ch[t1] = cc[t2] + cc[t2];
-		ch[t1 + t0] = -(cc[t2 + 1] + cc[t2 + 1]);
-		t1 += ido;
-		t2 += ido << 1;
-	}
-}
-
-STIN void
-dradb3(int ido, int l1, double *cc, double *ch, double *wa1, double *wa2)
-{
-	static double taur = -.5;
-	static double taui = .86602540378443864676372317075293618;
-	long int i;
-	long int k;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	long int t7;
-	long int t8;
-	long int t9;
-	long int t10;
-	double ci2;
-	double ci3;
-	double di2;
-	double di3;
-	double cr2;
-	double cr3;
-	double dr2;
-	double dr3;
-	double ti2;
-	double tr2;
-
-	t0 = l1 * ido;
-	t1 = 0;
-	t2 = t0 << 1;
-	t3 = ido << 1;
-	t4 = ido + (ido << 1);
-	t5 = 0;
-	for (k = 0; k < l1; k++) {
-		tr2 = cc[t3 - 1] + cc[t3 - 1];
-		cr2 = cc[t5] + (taur * tr2);
-		ch[t1] = cc[t5] + tr2;
-		ci3 = taui * (cc[t3] + cc[t3]);
-		ch[t1 + t0] = cr2 - ci3;
-		ch[t1 + t2] = cr2 + ci3;
-		t1 += ido;
-		t3 += t4;
-		t5 += t4;
-	}
-
-	if (ido == 1) {
-		return;
-	}
-
-	t1 = 0;
-	t3 = ido << 1;
-	for (k = 0; k < l1; k++) {
-		t7 = t1 + (t1 << 1);
-		t6 = (t5 = t7 + t3);
-		t8 = t1;
-		t10 = (t9 = t1 + t0) + t0;
-
-		for (i = 2; i < ido; i += 2) {
-			t5 += 2;
-			t6 -= 2;
-			t7 += 2;
-			t8 += 2;
-			t9 += 2;
-			t10 += 2;
-			tr2 = cc[t5 - 1] + cc[t6 - 1];
-			cr2 = cc[t7 - 1] + (taur * tr2);
-			ch[t8 - 1] = cc[t7 - 1] + tr2;
-			ti2 = cc[t5] - cc[t6];
-			ci2 = cc[t7] + (taur * ti2);
-			ch[t8] = cc[t7] + ti2;
-			cr3 = taui * (cc[t5 - 1] - cc[t6 - 1]);
-			ci3 = taui * (cc[t5] + cc[t6]);
-			dr2 = cr2 - ci3;
-			dr3 = cr2 + ci3;
-			di2 = ci2 + cr3;
-			di3 = ci2 - cr3;
-			ch[t9 - 1] = wa1[i - 2] * dr2 - wa1[i - 1] * di2;
-			ch[t9] = wa1[i - 2] * di2 + wa1[i - 1] * dr2;
-			ch[t10 - 1] = wa2[i - 2] * dr3 - wa2[i - 1] * di3;
-			ch[t10] = wa2[i - 2] * di3 + wa2[i - 1] * dr3;
+		return src;
+	}
+
+	/*
+	 * Bluestein's algorithm: the convolution is transformed, multiplied by the transformed filter,
+	 * and transformed back as the conjugate of the transform of its conjugate
+	 */
+	src = scratch;
+	dst = scratch + 2 * plan->blue_len;
+	share(me, plan->blue_len, &k0, &k1);
+	for (k = k0; k < k1; k++) {
+		if (k < plan->len) {
+			CMUL(src[2 * k], src[2 * k + 1], x[2 * k], x[2 * k + 1], plan->chirp[2 * k], plan->chirp[2 * k + 1]);
+		} else {
+			src[2 * k] = 0.0;
+			src[2 * k + 1] = 0.0;
 		}
-		t1 += ido;
 	}
+	team_wait(me);
+	src = cplan_forward(plan->blue, src, dst, NULL, me);
+	for (k = k0; k < k1; k++) {
+		CMUL(src[2 * k], src[2 * k + 1], src[2 * k], src[2 * k + 1], plan->blue_filter[2 * k],
+		     plan->blue_filter[2 * k + 1]);
+		src[2 * k + 1] = -src[2 * k + 1];
+	}
+	team_wait(me);
+	dst = (src == scratch) ? scratch + 2 * plan->blue_len : scratch;
+	src = cplan_forward(plan->blue, src, dst, NULL, me);
+	share(me, plan->len, &k0, &k1);
+	for (k = k0; k < k1; k++) {
+		CMUL(x[2 * k], x[2 * k + 1], src[2 * k], -src[2 * k + 1], plan->chirp[2 * k], plan->chirp[2 * k + 1]);
+	}
+	team_wait(me);
+	return x;
 }
 
-STIN void
-dradb4(int ido, int l1, double *cc, double *ch, double *wa1, double *wa2, double *wa3)
-{
-	static double sqrt2 = 1.4142135623730950488016887242097;
-	long int i;
-	long int k;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	long int t7;
-	long int t8;
-	double ci2;
-	double ci3;
-	double ci4;
-	double cr2;
-	double cr3;
-	double cr4;
-	double ti1;
-	double ti2;
-	double ti3;
-	double ti4;
-	double tr1;
-	double tr2;
-	double tr3;
-	double tr4;
-
-	t0 = l1 * ido;
-	t1 = 0;
-	t2 = ido << 2;
-	t3 = 0;
-	t6 = ido << 1;
-	for (k = 0; k < l1; k++) {
-		t4 = t3 + t6;
-		t5 = t1;
-		tr3 = cc[t4 - 1] + cc[t4 - 1];
-		tr4 = cc[t4] + cc[t4];
-		tr1 = cc[t3] - cc[(t4 += t6) - 1];
-		tr2 = cc[t3] + cc[t4 - 1];
-		ch[t5] = tr2 + tr3;
-		ch[t5 += t0] = tr1 - tr4;
-		ch[t5 += t0] = tr2 - tr3;
-		ch[t5 += t0] = tr1 + tr4;
-		t1 += ido;
-		t3 += t2;
-	}
-
-	if (ido < 2) {
-		return;
-	}
-	if (ido == 2) {
-		goto L105;
-	}
-
-	t1 = 0;
-	for (k = 0; k < l1; k++) {
-		t5 = (t4 = (t3 = (t2 = t1 << 2) + t6)) + t6;
-		t7 = t1;
-		for (i = 2; i < ido; i += 2) {
-			t2 += 2;
-			t3 += 2;
-			t4 -= 2;
-			t5 -= 2;
-			t7 += 2;
-			ti1 = cc[t2] + cc[t5];
-			ti2 = cc[t2] - cc[t5];
-			ti3 = cc[t3] - cc[t4];
-			tr4 = cc[t3] + cc[t4];
-			tr1 = cc[t2 - 1] - cc[t5 - 1];
-			tr2 = cc[t2 - 1] + cc[t5 - 1];
-			ti4 = cc[t3 - 1] - cc[t4 - 1];
-			tr3 = cc[t3 - 1] + cc[t4 - 1];
-			ch[t7 - 1] = tr2 + tr3;
-			cr3 = tr2 - tr3;
-			ch[t7] = ti2 + ti3;
-			ci3 = ti2 - ti3;
-			cr2 = tr1 - tr4;
-			cr4 = tr1 + tr4;
-			ci2 = ti1 + ti4;
-			ci4 = ti1 - ti4;
-
-			ch[(t8 = t7 + t0) - 1] = wa1[i - 2] * cr2 - wa1[i - 1] * ci2;
-			ch[t8] = wa1[i - 2] * ci2 + wa1[i - 1] * cr2;
-			ch[(t8 += t0) - 1] = wa2[i - 2] * cr3 - wa2[i - 1] * ci3;
-			ch[t8] = wa2[i - 2] * ci3 + wa2[i - 1] * cr3;
-			ch[(t8 += t0) - 1] = wa3[i - 2] * cr4 - wa3[i - 1] * ci4;
-			ch[t8] = wa3[i - 2] * ci4 + wa3[i - 1] * cr4;
-		}
-		t1 += ido;
-	}
-
-	if (ido % 2 == 1) {
-		return;
-	}
 
-      L105:
-
-	t1 = ido;
-	t2 = ido << 2;
-	t3 = ido - 1;
-	t4 = ido + (ido << 1);
-	for (k = 0; k < l1; k++) {
-		t5 = t3;
-		ti1 = cc[t1] + cc[t4];
-		ti2 = cc[t4] - cc[t1];
-		tr1 = cc[t1 - 1] - cc[t4 - 1];
-		tr2 = cc[t1 - 1] + cc[t4 - 1];
-		ch[t5] = tr2 + tr2;
-		ch[t5 += t0] = sqrt2 * (tr1 - ti1);
-		ch[t5 += t0] = ti2 + ti2;
-		ch[t5 += t0] = -sqrt2 * (tr1 + ti1);
-
-		t3 += ido;
-		t1 += t2;
-		t4 += t2;
-	}
-}
-
-STIN void
-dradbg(int ido, int ip, int l1, int idl1, double *cc, double *c1, double *c2, double *ch, double *ch2, double *wa)
+/*
+ * dfft_plan_create - plan a real input forward DFT
+ *
+ * given:
+ *      n               // real transform length, > 1
+ *
+ * returns:
+ *      malloced plan, free with dfft_plan_destroy()
+ *
+ * This function does not return on error.
+ */
+struct dfft_plan *
+dfft_plan_create(long int n)
 {
-	static double tpi = 6.28318530717958647692528676655900577;
-	long int idij;
-	long int ipph;
-	long int i;
-	long int j;
+	struct dfft_plan *plan;		// plan being formed
+	long int h;			// number of complex values transformed
 	long int k;
-	long int l;
-	long int ik;
-	long int is;
-	long int t0;
-	long int t1;
-	long int t2;
-	long int t3;
-	long int t4;
-	long int t5;
-	long int t6;
-	long int t7;
-	long int t8;
-	long int t9;
-	long int t10;
-	long int t11;
-	long int t12;
-	double dc2;
-	double ai1;
-	double ai2;
-	double ar1;
-	double ar2;
-	double ds2;
-	long int nbd;
-	double dcp;
-	double arg;
-	double dsp;
-	double ar1h;
-	double ar2h;
-	long int ipp2;
-
-	t10 = ip * ido;
-	t0 = l1 * ido;
-	arg = tpi / (double) ip;
-	dcp = cos(arg);
-	dsp = sin(arg);
-	nbd = (ido - 1) >> 1;
-	ipp2 = ip;
-	ipph = (ip + 1) >> 1;
-	if (ido < l1) {
-		goto L103;
-	}
 
-	t1 = 0;
-	t2 = 0;
-	for (k = 0; k < l1; k++) {
-		t3 = t1;
-		t4 = t2;
-		for (i = 0; i < ido; i++) {
-			ch[t3] = cc[t4];
-			t3++;
-			t4++;
-		}
-		t1 += ido;
-		t2 += t10;
-	}
-	goto L106;
-
-      L103:
-	t1 = 0;
-	for (i = 0; i < ido; i++) {
-		t2 = t1;
-		t3 = t1;
-		for (k = 0; k < l1; k++) {
-			ch[t2] = cc[t3];
-			t2 += ido;
-			t3 += t10;
-		}
-		t1++;
-	}
-
-      L106:
-	t1 = 0;
-	t2 = ipp2 * t0;
-	t7 = (t5 = ido << 1);
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-		t6 = t5;
-		for (k = 0; k < l1; k++) {
-			ch[t3] = cc[t6 - 1] + cc[t6 - 1];
-			ch[t4] = cc[t6] + cc[t6];
-			t3 += ido;
-			t4 += ido;
-			t6 += t10;
-		}
-		t5 += t7;
-	}
-
-	if (ido == 1) {
-		goto L116;
-	}
-	if (nbd < l1) {
-		goto L112;
-	}
-
-	t1 = 0;
-	t2 = ipp2 * t0;
-	t7 = 0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-
-		t7 += (ido << 1);
-		t8 = t7;
-		for (k = 0; k < l1; k++) {
-			t5 = t3;
-			t6 = t4;
-			t9 = t8;
-			t11 = t8;
-			for (i = 2; i < ido; i += 2) {
-				t5 += 2;
-				t6 += 2;
-				t9 += 2;
-				t11 -= 2;
-				ch[t5 - 1] = cc[t9 - 1] + cc[t11 - 1];
-				ch[t6 - 1] = cc[t9 - 1] - cc[t11 - 1];
-				ch[t5] = cc[t9] - cc[t11];
-				ch[t6] = cc[t9] + cc[t11];
-			}
-			t3 += ido;
-			t4 += ido;
-			t8 += t10;
-		}
-	}
-	goto L116;
-
-      L112:
-	t1 = 0;
-	t2 = ipp2 * t0;
-	t7 = 0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-		t7 += (ido << 1);
-		t8 = t7;
-		t9 = t7;
-		for (i = 2; i < ido; i += 2) {
-			t3 += 2;
-			t4 += 2;
-			t8 += 2;
-			t9 -= 2;
-			t5 = t3;
-			t6 = t4;
-			t11 = t8;
-			t12 = t9;
-			for (k = 0; k < l1; k++) {
-				ch[t5 - 1] = cc[t11 - 1] + cc[t12 - 1];
-				ch[t6 - 1] = cc[t11 - 1] - cc[t12 - 1];
-				ch[t5] = cc[t11] - cc[t12];
-				ch[t6] = cc[t11] + cc[t12];
-				t5 += ido;
-				t6 += ido;
-				t11 += t10;
-				t12 += t10;
-			}
-		}
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (n < 2) {
+		err(241, __func__, "transform length n: %ld must be > 1", n);
 	}
 
-      L116:
-	ar1 = 1.0;
-	ai1 = 0.0;
-	t1 = 0;
-	t9 = (t2 = ipp2 * idl1);
-	t3 = (ip - 1) * idl1;
-	for (l = 1; l < ipph; l++) {
-		t1 += idl1;
-		t2 -= idl1;
-
-		ar1h = dcp * ar1 - dsp * ai1;
-		ai1 = dcp * ai1 + dsp * ar1;
-		ar1 = ar1h;
-		t4 = t1;
-		t5 = t2;
-		t6 = 0;
-		t7 = idl1;
-		t8 = t3;
-		for (ik = 0; ik < idl1; ik++) {
-			c2[t4++] = ch2[t6++] + ar1 * ch2[t7++];
-			c2[t5++] = ai1 * ch2[t8++];
-		}
-		dc2 = ar1;
-		ds2 = ai1;
-		ar2 = ar1;
-		ai2 = ai1;
-
-		t6 = idl1;
-		t7 = t9 - idl1;
-		for (j = 2; j < ipph; j++) {
-			t6 += idl1;
-			t7 -= idl1;
-			ar2h = dc2 * ar2 - ds2 * ai2;
-			ai2 = dc2 * ai2 + ds2 * ar2;
-			ar2 = ar2h;
-			t4 = t1;
-			t5 = t2;
-			t11 = t6;
-			t12 = t7;
-			for (ik = 0; ik < idl1; ik++) {
-				c2[t4++] += ar2 * ch2[t11++];
-				c2[t5++] += ai2 * ch2[t12++];
-			}
-		}
+	plan = calloc(1, sizeof(*plan));
+	if (plan == NULL) {
+		errp(241, __func__, "cannot calloc a plan of %lu bytes", sizeof(*plan));
 	}
+	plan->n = n;
+	h = ((n % 2) == 0) ? n / 2 : n;
+	plan->cplan = cplan_create(h);
 
-	t1 = 0;
-	for (j = 1; j < ipph; j++) {
-		t1 += idl1;
-		t2 = t1;
-		for (ik = 0; ik < idl1; ik++) {
-			ch2[ik] += ch2[t2++];
+	/*
+	 * An even length keeps the unit roots that split the half length transform, and needs a second
+	 * buffer of n / 2 + 1 complex values; an odd length needs two buffers of n complex values
+	 */
+	if ((n % 2) == 0) {
+		plan->split = malloc((size_t) (2 * (h / 2 + 1)) * sizeof(double));
+		if (plan->split == NULL) {
+			errp(241, __func__, "cannot malloc %ld unit roots", h / 2 + 1);
 		}
-	}
-
-	t1 = 0;
-	t2 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-		for (k = 0; k < l1; k++) {
-			ch[t3] = c1[t3] - c1[t4];
-			ch[t4] = c1[t3] + c1[t4];
-			t3 += ido;
-			t4 += ido;
+		for (k = 0; k <= h / 2; k++) {
+			unit_root(k, n, &plan->split[2 * k]);
 		}
+		plan->work_len = (size_t) (2 * (h + 1));
+	} else {
+		plan->work_len = (size_t) (4 * n);
 	}
+	plan->work_len += (size_t) (4 * plan->cplan->blue_len);
+	dbg(DBG_MED, "planned a length %ld real DFT with %d stages and Bluestein length %ld, %lu doubles of work space",
+	    n, plan->cplan->nfactors, plan->cplan->blue_len, plan->work_len);
+	return plan;
+}
 
-	if (ido == 1) {
-		goto L132;
-	}
-	if (nbd < l1) {
-		goto L128;
-	}
-
-	t1 = 0;
-	t2 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-		for (k = 0; k < l1; k++) {
-			t5 = t3;
-			t6 = t4;
-			for (i = 2; i < ido; i += 2) {
-				t5 += 2;
-				t6 += 2;
-				ch[t5 - 1] = c1[t5 - 1] - c1[t6];
-				ch[t6 - 1] = c1[t5 - 1] + c1[t6];
-				ch[t5] = c1[t5] + c1[t6 - 1];
-				ch[t6] = c1[t5] - c1[t6 - 1];
-			}
-			t3 += ido;
-			t4 += ido;
-		}
-	}
-	goto L132;
-
-      L128:
-	t1 = 0;
-	t2 = ipp2 * t0;
-	for (j = 1; j < ipph; j++) {
-		t1 += t0;
-		t2 -= t0;
-		t3 = t1;
-		t4 = t2;
-		for (i = 2; i < ido; i += 2) {
-			t3 += 2;
-			t4 += 2;
-			t5 = t3;
-			t6 = t4;
-			for (k = 0; k < l1; k++) {
-				ch[t5 - 1] = c1[t5 - 1] - c1[t6];
-				ch[t6 - 1] = c1[t5 - 1] + c1[t6];
-				ch[t5] = c1[t5] + c1[t6 - 1];
-				ch[t6] = c1[t5] - c1[t6 - 1];
-				t5 += ido;
-				t6 += ido;
-			}
-		}
-	}
 
-      L132:
-	if (ido == 1) {
+/*
+ * dfft_plan_destroy - free a plan formed by dfft_plan_create()
+ *
+ * given:
+ *      plan            // plan to free, may be NULL
+ */
+void
+dfft_plan_destroy(struct dfft_plan *plan)
+{
+	if (plan == NULL) {
 		return;
 	}
-
-	for (ik = 0; ik < idl1; ik++) {
-		c2[ik] = ch2[ik];
-	}
-
-	t1 = 0;
-	for (j = 1; j < ip; j++) {
-		t2 = (t1 += t0);
-		for (k = 0; k < l1; k++) {
-			c1[t2] = ch[t2];
-			t2 += ido;
-		}
-	}
-
-	if (nbd > l1) {
-		goto L139;
-	}
-
-	is = -ido - 1;
-	t1 = 0;
-	for (j = 1; j < ip; j++) {
-		is += ido;
-		t1 += t0;
-		idij = is;
-		t2 = t1;
-		for (i = 2; i < ido; i += 2) {
-			t2 += 2;
-			idij += 2;
-			t3 = t2;
-			for (k = 0; k < l1; k++) {
-				c1[t3 - 1] = wa[idij - 1] * ch[t3 - 1] - wa[idij] * ch[t3];
-				c1[t3] = wa[idij - 1] * ch[t3] + wa[idij] * ch[t3 - 1];
-				t3 += ido;
-			}
-		}
+	cplan_destroy(plan->cplan);
+	plan->cplan = NULL;
+	if (plan->split != NULL) {
+		free(plan->split);
+		plan->split = NULL;
 	}
+	free(plan);
 	return;
-
-      L139:
-	is = -ido - 1;
-	t1 = 0;
-	for (j = 1; j < ip; j++) {
-		is += ido;
-		t1 += t0;
-		t2 = t1;
-		for (k = 0; k < l1; k++) {
-			idij = is;
-			t3 = t2;
-			for (i = 2; i < ido; i += 2) {
-				idij += 2;
-				t3 += 2;
-				c1[t3 - 1] = wa[idij - 1] * ch[t3 - 1] - wa[idij] * ch[t3];
-				c1[t3] = wa[idij - 1] * ch[t3] + wa[idij] * ch[t3 - 1];
-			}
-			t2 += ido;
-		}
-	}
 }
 
-STIN void
-drftb1(int n, double *c, double *ch, double *wa, int *ifac)
-{
-	long int i;
-	long int k1;
-	long int l1;
-	long int l2;
-	long int na;
-	long int nf;
-	long int ip;
-	long int iw;
-	long int ix2;
-	long int ix3;
-	long int ido;
-	long int idl1;
-
-	nf = ifac[1];
-	na = 0;
-	l1 = 1;
-	iw = 1;
-
-	for (k1 = 0; k1 < nf; k1++) {
-		ip = ifac[k1 + 2];
-		l2 = ip * l1;
-		ido = n / l2;
-		idl1 = ido * l1;
-		if (ip != 4) {
-			goto L103;
-		}
-		ix2 = iw + ido;
-		ix3 = ix2 + ido;
 
-		if (na != 0) {
-			dradb4(ido, l1, ch, c, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
-		} else {
-			dradb4(ido, l1, c, ch, wa + iw - 1, wa + ix2 - 1, wa + ix3 - 1);
+/*
+ * member_forward - do the share of one member of a team in a real input forward DFT
+ *
+ * given:
+ *      arg             // struct member of the team member, me->out is set to where the output is found
+ *
+ * returns:
+ *      NULL
+ */
+static void *
+member_forward(void *arg)
+{
+	struct member *me = arg;	// member doing its share
+	const struct dfft_plan *plan = me->plan;
+	double *X = me->X;
+	double *work = me->work;
+	long int n;		// real transform length
+	long int h;		// half of n
+	double *Z;		// half length transform
+	double *a;		// odd n: X as complex values
+	double z0r;
+	double z0i;
+	long int k;
+	long int k0;		// first value of the share of this member
+	long int k1;		// value after the share of this member
+
+	n = plan->n;
+
+	/*
+	 * An odd length is transformed as complex values with 0 imaginary parts
+	 */
+	if ((n % 2) != 0) {
+		a = work;
+		share(me, n, &k0, &k1);
+		for (k = k0; k < k1; k++) {
+			a[2 * k] = X[k];
+			a[2 * k + 1] = 0.0;
 		}
-		na = 1 - na;
-		goto L115;
+		team_wait(me);
+		me->out = cplan_forward(plan->cplan, a, work + 2 * n, work + 4 * n, me);
+		return NULL;
+	}
+
+	/*
+	 * An even length is transformed as n / 2 complex values X[2 * j] + i * X[2 * j + 1]
+	 */
+	h = n / 2;
+	Z = cplan_forward(plan->cplan, X, work, work + 2 * (h + 1), me);
+
+	/*
+	 * Split the half length transform Z into the transforms E and O of the even and the odd values:
+	 *
+	 *	E[k] = (Z[k] + conj(Z[h - k])) / 2,  O[k] = (Z[k] - conj(Z[h - k])) / (2 * i)
+	 *
+	 * Then output k is E[k] + W[k] * O[k] and output h - k is conj(E[k] - W[k] * O[k]), where
+	 * W[k] = exp(-2 * pi * i * k / n), so each pair of outputs is formed in place.
+	 */
+	if (me->id == 0) {
+		z0r = Z[0];
+		z0i = Z[1];
+		Z[0] = z0r + z0i;
+		Z[1] = 0.0;
+		Z[2 * h] = z0r - z0i;
+		Z[2 * h + 1] = 0.0;
+	}
+	share(me, h / 2, &k0, &k1);
+	for (k = k0 + 1; k <= k1; k++) {
+		double zkr = Z[2 * k];
+		double zki = Z[2 * k + 1];
+		double zmr = Z[2 * (h - k)];
+		double zmi = Z[2 * (h - k) + 1];
+		double er = 0.5 * (zkr + zmr);
+		double ei = 0.5 * (zki - zmi);
+		double wr;
+		double wi;
+
+		CMUL(wr, wi, 0.5 * (zki + zmi), 0.5 * (zmr - zkr), plan->split[2 * k], plan->split[2 * k + 1]);
+		Z[2 * k] = er + wr;
+		Z[2 * k + 1] = ei + wi;
+		Z[2 * (h - k)] = er - wr;
+		Z[2 * (h - k) + 1] = wi - ei;
+	}
+	me->out = Z;
+	return NULL;
+}
 
-	      L103:
-		if (ip != 2) {
-			goto L106;
-		}
 
-		if (na != 0) {
-			dradb2(ido, l1, ch, c, wa + iw - 1);
-		} else {
-			dradb2(ido, l1, c, ch, wa + iw - 1);
+/*
+ * dfft_forward - do a real input forward DFT
+ *
+ * given:
+ *      plan            // plan of the transform, may be shared with other threads
+ *      X               // plan->n real values to transform, in an array of at least plan->n + 2 doubles
+ *      work            // work space of plan->work_len doubles of the calling thread
+ *      threads         // number of threads to do the transform with, the calling thread being one of them
+ *
+ * returns:
+ *      X or a pointer into work, where the outputs 0 thru plan->n / 2 are found as pairs of doubles,
+ *      the real part first, with output k = sum over j of X[j] * exp(-2 * pi * i * j * k / plan->n)
+ *
+ * The values of X and work are overwritten.  With threads > 1, the calling thread starts threads - 1
+ * more threads for the transform and joins them before it returns.  Transforms shorter than
+ * DFFT_MIN_SHARED_LEN are done by the calling thread alone.
+ *
+ * This function does not return on error.
+ */
+double *
+dfft_forward(const struct dfft_plan *plan, double *X, double *work, long int threads)
+{
+	struct team team;		// team doing the transform
+	struct member *member;		// members of the team
+	pthread_t *thread;		// threads of the members other than the calling thread
+	struct member solo;		// the calling thread as the only member of its team
+	double *out;			// where the output is found
+	long int i;
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (plan == NULL) {
+		err(242, __func__, "plan arg is NULL");
+	}
+	if (X == NULL) {
+		err(242, __func__, "X arg is NULL");
+	}
+	if (work == NULL) {
+		err(242, __func__, "work arg is NULL");
+	}
+	if (threads < 1 || plan->n < DFFT_MIN_SHARED_LEN) {
+		threads = 1;
+	}
+
+	/*
+	 * A single thread does the transform without any locking
+	 */
+	team.threads = threads;
+	team.arrived = 0;
+	team.generation = 0;
+	if (threads == 1) {
+		solo.team = &team;
+		solo.id = 0;
+		solo.plan = plan;
+		solo.X = X;
+		solo.work = work;
+		solo.out = NULL;
+		(void) member_forward(&solo);
+		return solo.out;
+	}
+
+	/*
+	 * Start the other members of the team, do the share of member 0 and wait for the others
+	 */
+	member = malloc((size_t) threads * sizeof(member[0]));
+	if (member == NULL) {
+		errp(243, __func__, "cannot malloc %ld team members", threads);
+	}
+	thread = malloc((size_t) threads * sizeof(thread[0]));
+	if (thread == NULL) {
+		errp(243, __func__, "cannot malloc %ld threads", threads);
+	}
+	pthread_mutex_init(&team.lock, NULL);
+	pthread_cond_init(&team.done, NULL);
+	for (i = 0; i < threads; i++) {
+		member[i].team = &team;
+		member[i].id = i;
+		member[i].plan = plan;
+		member[i].X = X;
+		member[i].work = work;
+		member[i].out = NULL;
+	}
+	for (i = 1; i < threads; i++) {
+		ret = pthread_create(&thread[i], NULL, member_forward, &member[i]);
+		if (ret != 0) {
+			errno = ret;
+			errp(243, __func__, "cannot start thread %ld of %ld for the transform", i, threads);
 		}
-		na = 1 - na;
-		goto L115;
-
-	      L106:
-		if (ip != 3) {
-			goto L109;
+	}
+	(void) member_forward(&member[0]);
+	for (i = 1; i < threads; i++) {
+		ret = pthread_join(thread[i], NULL);
+		if (ret != 0) {
+			errno = ret;
+			errp(243, __func__, "cannot join thread %ld of %ld of the transform", i, threads);
 		}
+	}
+	out = member[0].out;
+	pthread_cond_destroy(&team.done);
+	pthread_mutex_destroy(&team.lock);
+	free(thread);
+	free(member);
+	return out;
+}
 
-		ix2 = iw + ido;
-		if (na != 0) {
-			dradb3(ido, l1, ch, c, wa + iw - 1, wa + ix2 - 1);
-		} else {
-			dradb3(ido, l1, c, ch, wa + iw - 1, wa + ix2 - 1);
-		}
-		na = 1 - na;
-		goto L115;
-
-	      L109:
-		/*
-		 * The radix five case can be translated later.....
-		 */
-		/*
-		 * if(ip!=5)goto L112;
-		 *
-		 * ix2=iw+ido; ix3=ix2+ido; ix4=ix3+ido; if ( na != 0 ) dradb5(ido,l1,ch,c,wa+iw-1,wa+ix2-1,wa+ix3-1,wa+ix4-1);
-		 * else dradb5(ido,l1,c,ch,wa+iw-1,wa+ix2-1,wa+ix3-1,wa+ix4-1); na=1-na; goto L115;
-		 *
-		 * L112:
-		 */
-		if (na != 0) {
-			dradbg(ido, ip, l1, idl1, ch, ch, ch, c, c, wa + iw - 1);
-		} else {
-			dradbg(ido, ip, l1, idl1, c, c, c, ch, ch, wa + iw - 1);
-		}
-		if (ido == 1) {
-			na = 1 - na;
-		}
 
-	      L115:
-		l1 = l2;
-		iw += (ip - 1) * ido;
-	}
+/*
+ * dfft_cplan_create - plan a complex forward DFT
+ *
+ * given:
+ *      len             // complex transform length, > 0
+ *
+ * returns:
+ *      malloced plan, free with dfft_cplan_destroy()
+ *
+ * This function does not return on error.
+ */
+struct dfft_cplan *
+dfft_cplan_create(long int len)
+{
+	struct dfft_cplan *plan;	// plan being formed
 
-	if (na == 0) {
-		return;
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (len < 1) {
+		err(244, __func__, "transform length len: %ld must be > 0", len);
 	}
 
-	for (i = 0; i < n; i++) {
-		c[i] = ch[i];
-	}
+	plan = cplan_create(len);
+	dbg(DBG_MED, "planned a length %ld complex DFT with %d stages and Bluestein length %ld, %lu doubles of work space",
+	    len, plan->nfactors, plan->blue_len, plan->work_len);
+	return plan;
 }
 
+
+/*
+ * dfft_cplan_destroy - free a plan formed by dfft_cplan_create()
+ *
+ * given:
+ *      plan            // plan to free, may be NULL
+ */
 void
-__ogg_fdrfftb(int n, double *r, double *wsave, long int *ifac)
+dfft_cplan_destroy(struct dfft_cplan *plan)
 {
-	if (n == 1) {
-		return;
-	}
-	drftb1(n, r, wsave, wsave + n, ifac);
+	cplan_destroy(plan);
+	return;
 }
 
-STIN void
-dcsqb1(int n, double *x, double *w, double *xh, int *ifac)
-{
-	long int modn;
-	long int i;
-	long int k;
-	long int kc;
-	long int np2;
-	long int ns2;
-	double xim1;
-
-	ns2 = (n + 1) >> 1;
-	np2 = n;
-
-	for (i = 2; i < n; i += 2) {
-		xim1 = x[i - 1] + x[i];
-		x[i] -= x[i - 1];
-		x[i - 1] = xim1;
-	}
-
-	x[0] += x[0];
-	modn = n % 2;
-	if (modn == 0) {
-		x[n - 1] += x[n - 1];
-	}
 
-	__ogg_fdrfftb(n, x, xh, ifac);
+/*
+ * dfft_cforward - do a complex forward DFT
+ *
+ * given:
+ *      plan            // plan of the transform, may be shared with other threads
+ *      x               // plan->len complex values to transform, as pairs of doubles, the real part first
+ *      work            // work space of plan->work_len doubles of the calling thread
+ *
+ * returns:
+ *      x or work, where the plan->len outputs are found in natural order, with
+ *      output k = sum over j of x[j] * exp(-2 * pi * i * j * k / plan->len)
+ *
+ * The values of x and work are overwritten.
+ *
+ * This function does not return on error.
+ */
+double *
+dfft_cforward(const struct dfft_cplan *plan, double *x, double *work)
+{
+	struct team one = {1};		// team of the calling thread alone
+	struct member solo = {&one, 0, NULL, NULL, NULL, NULL};	// the calling thread as its only member
 
-	kc = np2;
-	for (k = 1; k < ns2; k++) {
-		kc--;
-		xh[k] = w[k - 1] * x[kc] + w[kc - 1] * x[k];
-		xh[kc] = w[k - 1] * x[k] - w[kc - 1] * x[kc];
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (plan == NULL) {
+		err(244, __func__, "plan arg is NULL");
 	}
-
-	if (modn == 0) {
-		x[ns2] = w[ns2 - 1] * (x[ns2] + x[ns2]);
+	if (x == NULL) {
+		err(244, __func__, "x arg is NULL");
 	}
-
-	kc = np2;
-	for (k = 1; k < ns2; k++) {
-		kc--;
-		x[k] = xh[k] + xh[kc];
-		x[kc] = xh[k] - xh[kc];
+	if (work == NULL) {
+		err(244, __func__, "work arg is NULL");
 	}
-	x[0] += x[0];
-}
-
-void
-__ogg_fdcosqb(int n, double *x, double *wsave, int *ifac)
-{
-	static double tsqrt2 = 2.8284271247461900976033774484194;
-	double x1;
 
-	if (n < 2) {
-		x[0] *= 4;
-		return;
+	if (plan->blue_len == 0) {
+		return cplan_forward(plan, x, work, NULL, &solo);
 	}
-	if (n == 2) {
-		x1 = (x[0] + x[1]) * 4;
-		x[1] = tsqrt2 * (x[0] - x[1]);
-		x[0] = x1;
-		return;
-	}
-
-	dcsqb1(n, x, wsave, wsave + n, ifac);
+	return cplan_forward(plan, x, NULL, work, &solo);
 }
-#endif /* LBBBBBBBBBBBBBBBB */
 #endif /* LEGACY_FFT */
@@ -1,6 +1,6 @@
 #if defined(LEGACY_FFT)
 /*
- * The OggSQUISH functions used by sts
+ * The built-in real input FFT used by sts when it is built without fftw
  */
 
 /*
@@ -29,10 +29,64 @@
 #ifndef DFFT_H
 #   define DFFT_H
 
-#   define WORK_ARRAY_LEN (15)
+#include <stddef.h>
 
-extern void __ogg_fdrffti(long int n, double *wsave, long int *ifac);
-extern void __ogg_fdrfftf(long int n, double *X, double *wsave, long int *ifac);
+#   define DFFT_MAX_FACTORS (64)	// Most radices in the factorization of a transform length
+#   define DFFT_MAX_RADIX (13)		// Largest prime radix transformed directly, larger ones use Bluestein's algorithm
+#   define DFFT_MIN_SHARED_LEN (65536)	// Shortest transform that dfft_forward() shares among threads
+
+
+/*
+ * Plan of a complex forward DFT of one length
+ *
+ * A length made of the radices 2, 3, 4, 5, 7, 8, 11 and 13 is transformed by one Stockham autosort
+ * stage per radix, which leaves the output in natural order without a bit reversal pass.  Any other
+ * length is transformed with Bluestein's algorithm, as a convolution with a chirp done by transforms
+ * of a power of 2 length.
+ *
+ * Complex values are held as pairs of doubles, the real part first.  A plan is only read once it is
+ * created, so one plan may be used by any number of threads at the same time.
+ */
+struct dfft_cplan {
+	long int len;				// complex transform length
+	int nfactors;				// number of Stockham stages, 0 if Bluestein's algorithm is used
+	long int factor[DFFT_MAX_FACTORS];	// radix of each stage, in the order the stages are done
+	double *twiddle[DFFT_MAX_FACTORS];	// twiddle factors of each stage, inside twiddles
+	double *twiddles;			// twiddle factors of all stages
+
+	long int blue_len;			// Bluestein: power of 2 convolution length >= 2 * len - 1, else 0
+	double *chirp;				// Bluestein: exp(-pi * i * k^2 / len) for k < len
+	double *blue_filter;			// Bluestein: transformed conjugate chirp divided by blue_len
+	struct dfft_cplan *blue;		// Bluestein: plan of the blue_len transforms
+
+	size_t work_len;			// doubles of work space each dfft_cforward() caller must pass
+};
+
+
+/*
+ * Plan of a real input forward DFT
+ *
+ * An even length n is transformed as n / 2 complex values, the even input values as real parts and
+ * the odd input values as imaginary parts, and the n / 2 + 1 non-redundant outputs are then split
+ * from that half length transform.  An odd length is transformed as n complex values.
+ */
+struct dfft_plan {
+	long int n;			// real transform length
+	struct dfft_cplan *cplan;	// complex transform of n / 2 values if n is even, else of n values
+	double *split;			// n even: exp(-2 * pi * i * k / n) for k <= n / 4, else NULL
+	size_t work_len;		// doubles of work space each dfft_forward() caller must pass
+};
+
+
+/*
+ * External function declarations
+ */
+extern struct dfft_plan *dfft_plan_create(long int n);
+extern void dfft_plan_destroy(struct dfft_plan *plan);
+extern double *dfft_forward(const struct dfft_plan *plan, double *X, double *work, long int threads);
+extern struct dfft_cplan *dfft_cplan_create(long int len);
+extern void dfft_cplan_destroy(struct dfft_cplan *plan);
+extern double *dfft_cforward(const struct dfft_cplan *plan, double *x, double *work);
 
 #endif				/* DFFT_H */
 #endif /* LEGACY_FFT */
@@ -46,6 +46,7 @@
 #include "utilities.h"
 #include "debug.h"
 #include "stat_fncs.h"
+#include "bitstream.h"
 
 extern long int debuglevel;	// -v lvl: defines the level of verbosity for debugging
 
@@ -55,6 +56,7 @@ extern long int debuglevel;	// -v lvl: defines the level of verbosity for debugg
 struct driver {
 	void (*init) (struct state *state);			// Initialize the test and check input size recommendations
 	void (*iterate) (struct thread_state * thread_state);	// Perform a single iteration test on the bitstream
+	void (*flush) (struct thread_state * thread_state);	// Finish iterations deferred by iterate, NULL if none are
 	void (*print) (struct state *state);			// Log iteration info into stats.txt, data*.txt, results.txt if -s
 	void (*metrics) (struct state *state);			// Uniformity and proportional analysis of a test
 	void (*destroy) (struct state *state);			// Final test cleanup and memory de-allocation
@@ -68,11 +70,13 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	 NULL,
 	 NULL,
 	 NULL,
+	 NULL,
 	 },
 
 	{			// TEST_FREQUENCY = 1, Frequency test (frequency.c)
 	 Frequency_init,
 	 Frequency_iterate,
+	 NULL,
 	 Frequency_print,
 	 Frequency_metrics,
 	 Frequency_destroy,
@@ -81,6 +85,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_BLOCK_FREQUENCY = 2, Block Frequency test (blockFrequency.c)
 	 BlockFrequency_init,
 	 BlockFrequency_iterate,
+	 NULL,
 	 BlockFrequency_print,
 	 BlockFrequency_metrics,
 	 BlockFrequency_destroy,
@@ -89,6 +94,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_CUSUM = 3, Cumulative Sums test (cusum.c)
 	 CumulativeSums_init,
 	 CumulativeSums_iterate,
+	 NULL,
 	 CumulativeSums_print,
 	 CumulativeSums_metrics,
 	 CumulativeSums_destroy,
@@ -97,6 +103,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_RUNS = 4, Runs test (runs.c)
 	 Runs_init,
 	 Runs_iterate,
+	 NULL,
 	 Runs_print,
 	 Runs_metrics,
 	 Runs_destroy,
@@ -105,6 +112,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_LONGEST_RUN = 5, Longest Runs test (longestRunOfOnes.c)
 	 LongestRunOfOnes_init,
 	 LongestRunOfOnes_iterate,
+	 NULL,
 	 LongestRunOfOnes_print,
 	 LongestRunOfOnes_metrics,
 	 LongestRunOfOnes_destroy,
@@ -113,6 +121,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_RANK = 6, Rank test (rank.c)
 	 Rank_init,
 	 Rank_iterate,
+	 NULL,
 	 Rank_print,
 	 Rank_metrics,
 	 Rank_destroy,
@@ -121,6 +130,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_DFT = 7, Discrete Fourier Transform test (discreteFourierTransform.c)
 	 DiscreteFourierTransform_init,
 	 DiscreteFourierTransform_iterate,
+	 DiscreteFourierTransform_flush,
 	 DiscreteFourierTransform_print,
 	 DiscreteFourierTransform_metrics,
 	 DiscreteFourierTransform_destroy,
@@ -129,6 +139,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_NON_OVERLAPPING = 8, Non-overlapping Template test (nonOverlappingTemplateMatchings.c)
 	 NonOverlappingTemplateMatchings_init,
 	 NonOverlappingTemplateMatchings_iterate,
+	 NULL,
 	 NonOverlappingTemplateMatchings_print,
 	 NonOverlappingTemplateMatchings_metrics,
 	 NonOverlappingTemplateMatchings_destroy,
@@ -137,6 +148,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_OVERLAPPING = 9, Overlapping Template test (overlappingTemplateMatchings.c)
 	 OverlappingTemplateMatchings_init,
 	 OverlappingTemplateMatchings_iterate,
+	 NULL,
 	 OverlappingTemplateMatchings_print,
 	 OverlappingTemplateMatchings_metrics,
 	 OverlappingTemplateMatchings_destroy,
@@ -145,6 +157,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_UNIVERSAL = 10, Universal test (universal.c)
 	 Universal_init,
 	 Universal_iterate,
+	 NULL,
 	 Universal_print,
 	 Universal_metrics,
 	 Universal_destroy,
@@ -153,6 +166,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_APEN = 11, Approximate Entropy test (approximateEntropy.c)
 	 ApproximateEntropy_init,
 	 ApproximateEntropy_iterate,
+	 NULL,
 	 ApproximateEntropy_print,
 	 ApproximateEntropy_metrics,
 	 ApproximateEntropy_destroy,
@@ -161,6 +175,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_RND_EXCURSION = 12, Random Excursions test (randomExcursions.c)
 	 RandomExcursions_init,
 	 RandomExcursions_iterate,
+	 NULL,
 	 RandomExcursions_print,
 	 RandomExcursions_metrics,
 	 RandomExcursions_destroy,
@@ -169,6 +184,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_RND_EXCURSION_VAR = 13, Random Excursions Variant test (randomExcursionsVariant.c)
 	 RandomExcursionsVariant_init,
 	 RandomExcursionsVariant_iterate,
+	 NULL,
 	 RandomExcursionsVariant_print,
 	 RandomExcursionsVariant_metrics,
 	 RandomExcursionsVariant_destroy,
@@ -177,6 +193,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_SERIAL = 14, Serial test (serial.c)
 	 Serial_init,
 	 Serial_iterate,
+	 NULL,
 	 Serial_print,
 	 Serial_metrics,
 	 Serial_destroy,
@@ -185,6 +202,7 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
 	{			// TEST_LINEARCOMPLEXITY = 15, Linear Complexity test (linearComplexity.c)
 	 LinearComplexity_init,
 	 LinearComplexity_iterate,
+	 NULL,
 	 LinearComplexity_print,
 	 LinearComplexity_metrics,
 	 LinearComplexity_destroy,
@@ -356,24 +374,39 @@ init(struct state *state)
 	 * Set the number of iterations not done yet to be equal to the total numOfBitstreams
 	 */
 	state->iterationsMissing = state->tp.numOfBitStreams;
+	state->iterationsDone = 0;
 
 	/*
-	 * Allocate the array for the bit streams copied to memory
+	 * Allocate the array for the packed bit streams copied to memory
 	 */
-	state->epsilon = calloc((size_t) state->numberOfThreads, sizeof(*state->epsilon));
-	if (state->epsilon == NULL) {
-		errp(50, __func__, "cannot calloc for epsilon: %ld elements of %lu bytes each", state->numberOfThreads,
-		     sizeof(*state->epsilon));
+	state->packedEpsilon = calloc((size_t) state->numberOfThreads, sizeof(*state->packedEpsilon));
+	if (state->packedEpsilon == NULL) {
+		errp(50, __func__, "cannot calloc for packedEpsilon: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(*state->packedEpsilon));
 	}
 
 	/*
-	 * Allocate the array for the bit stream copied to memory for each thread
+	 * Allocate the packed bit stream copied to memory for each thread
 	 */
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->epsilon[i] = calloc((size_t) state->tp.n, sizeof(BitSequence));
+		state->packedEpsilon[i] = create_packed_bits(state->tp.n);
+	}
+
+	/*
+	 * Allocate the one byte per bit view of the bit streams, if requested by -B
+	 */
+	if (state->byteEpsilon == true) {
+		state->epsilon = calloc((size_t) state->numberOfThreads, sizeof(*state->epsilon));
 		if (state->epsilon == NULL) {
-			errp(50, __func__, "cannot calloc for epsilon[%d]: %ld elements of %lu bytes each", i,
-			     state->tp.n, sizeof(BitSequence));
+			errp(50, __func__, "cannot calloc for epsilon: %ld elements of %lu bytes each", state->numberOfThreads,
+			     sizeof(*state->epsilon));
+		}
+		for (i = 0; i < state->numberOfThreads; i++) {
+			state->epsilon[i] = calloc((size_t) state->tp.n, sizeof(BitSequence));
+			if (state->epsilon[i] == NULL) {
+				errp(50, __func__, "cannot calloc for epsilon[%d]: %ld elements of %lu bytes each", i,
+				     state->tp.n, sizeof(BitSequence));
+			}
 		}
 	}
 
@@ -425,6 +458,41 @@ iterate(struct thread_state *thread_state)
 }
 
 
+/*
+ * flush - finish the iterations of all the enabled tests that a thread deferred
+ *
+ * given:
+ *      thread_state    // thread that has no more bitstreams to test
+ */
+void
+flush(struct thread_state *thread_state)
+{
+	int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(55, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(55, __func__, "state is NULL");
+	}
+
+	/*
+	 * Call test flush function if the test is enabled and defers iterations
+	 */
+	for (i = 1; i <= NUMOFTESTS; ++i) {
+		if (state->testVector[i] == true && testDriver[i].flush != NULL) {
+			testDriver[i].flush(thread_state);
+		}
+	}
+
+	return;
+}
+
+
 /*
  * Print - print to results.txt, data*.txt, stats.txt for all iterations
  *
@@ -1216,20 +1284,38 @@ destroy(struct state *state)
 		free(state->workDir);
 		state->workDir = NULL;
 	}
+	if (state->wisdomPath != NULL) {
+		free(state->wisdomPath);
+		state->wisdomPath = NULL;
+	}
+	if (state->scratchDir != NULL) {
+		free(state->scratchDir);
+		state->scratchDir = NULL;
+	}
 	if (state->tmpepsilon != NULL) {
 		free(state->tmpepsilon);
 		state->tmpepsilon = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->epsilon[i] != NULL) {
-			free(state->epsilon[i]);
-			state->epsilon[i] = NULL;
-		}
-	}
 	if (state->epsilon != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			if (state->epsilon[i] != NULL) {
+				free(state->epsilon[i]);
+				state->epsilon[i] = NULL;
+			}
+		}
 		free(state->epsilon);
 		state->epsilon = NULL;
 	}
+	if (state->packedEpsilon != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			if (state->packedEpsilon[i] != NULL) {
+				free(state->packedEpsilon[i]);
+				state->packedEpsilon[i] = NULL;
+			}
+		}
+		free(state->packedEpsilon);
+		state->packedEpsilon = NULL;
+	}
 	if (state->freqFilePath != NULL) {
 		free(state->freqFilePath);
 		state->freqFilePath = NULL;
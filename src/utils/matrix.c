@@ -30,9 +30,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../utils/externs.h"
 #include "matrix.h"
 #include "debug.h"
+#include "bitstream.h"
 
 
 #define	MATRIX_FORWARD_ELIMINATION	0
@@ -43,6 +45,11 @@ static void perform_elementary_row_operations(int flag, int i, int M, int Q, Bit
 static int find_unit_element_and_swap(int flag, int i, int M, int Q, BitSequence ** A);
 static int swap_rows(int index_first_row, int index_second_row, int Q, BitSequence ** A);
 static int determine_rank(int m, int M, int Q, BitSequence ** A);
+static int compute_rectangular_rank(int M, int Q, BitSequence ** A);
+static void load_word_rows(const WORD64 *w, long int pos, int M, int Q, DBLWORD *rows, int stride);
+static void rank_batch(int M, int Q, DBLWORD rows[][RANK_BATCH], int *rank);
+static void xor_words(WORD64 *x, const WORD64 *y, long int len);
+static void swap_words(WORD64 *x, WORD64 *y, long int len);
 
 
 int
@@ -52,6 +59,13 @@ computeRank(int M, int Q, BitSequence **matrix)
 	int rank;
 	int m = MIN(M, Q);
 
+	/*
+	 * The elimination below only looks for pivots on the diagonal, which finds the rank of square matrices only
+	 */
+	if (M != Q) {
+		return compute_rectangular_rank(M, Q, matrix);
+	}
+
 	/*
 	 * Forward application of elementary row operations
 	 */
@@ -184,6 +198,112 @@ determine_rank(int m, int M, int Q, BitSequence ** A)
 }
 
 
+/*
+ * compute_rectangular_rank - compute the rank of a M by Q matrix of BitSequence values, M != Q
+ *
+ * Each column is searched for a pivot in the rows below the pivots found so far, so a column without
+ * a pivot does not use up a row.
+ */
+static int
+compute_rectangular_rank(int M, int Q, BitSequence ** A)
+{
+	BitSequence *row;
+	int rank;
+	int i;
+	int j;
+	int k;
+
+	rank = 0;
+	for (j = 0; j < Q && rank < M; j++) {
+		for (i = rank; i < M && A[i][j] == 0; i++) {
+		}
+		if (i == M) {
+			continue;
+		}
+		row = A[i];
+		A[i] = A[rank];
+		A[rank] = row;
+		for (i = rank + 1; i < M; i++) {
+			if (A[i][j] == 1) {
+				for (k = j; k < Q; k++) {
+					A[i][k] = (BitSequence) ((A[i][k] + row[k]) % 2);
+				}
+			}
+		}
+		rank++;
+	}
+
+	return rank;
+}
+
+
+/*
+ * computeWordRank - compute the rank over GF(2) of a matrix held as one DBLWORD per row
+ *
+ * given:
+ *      M       // Number of rows in the matrix
+ *      Q       // Number of columns in each matrix row, 1 <= Q <= 32
+ *      rows    // M rows, column j of a row being bit 31 - j of its DBLWORD
+ *
+ * returns:
+ *      The rank of the matrix.
+ *
+ * The rows are reduced in place: a row operation is a single XOR and a pivot is found with a mask test.
+ *
+ * NOTE: This function does NOT return on error.
+ */
+int
+computeWordRank(int M, int Q, DBLWORD *rows)
+{
+	DBLWORD column;		// mask of the column being eliminated
+	DBLWORD pivot;		// pivot row of that column
+	int rank;
+	int i;
+	int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (rows == NULL) {
+		err(123, __func__, "rows arg is NULL");
+	}
+	if (M < 0) {
+		err(123, __func__, "number of rows: %d must be >= 0", M);
+	}
+	if (Q < 1 || Q > BITS_N_DBLWORD) {
+		err(123, __func__, "number of columns per rows: %d must be > 0 and <= %d", Q, BITS_N_DBLWORD);
+	}
+
+	rank = 0;
+	for (j = 0, column = (DBLWORD) 1 << (BITS_N_DBLWORD - 1); j < Q && rank < M; j++, column >>= 1) {
+
+		/*
+		 * Find a row below the pivots found so far that has a 1 in this column
+		 */
+		for (i = rank; i < M && (rows[i] & column) == 0; i++) {
+		}
+		if (i == M) {
+			continue;
+		}
+
+		/*
+		 * Make it the next pivot row and clear this column in the rows below it
+		 */
+		pivot = rows[i];
+		rows[i] = rows[rank];
+		rows[rank] = pivot;
+		for (i = rank + 1; i < M; i++) {
+			if ((rows[i] & column) != 0) {
+				rows[i] ^= pivot;
+			}
+		}
+		rank++;
+	}
+
+	return rank;
+}
+
+
 /*
  * create_matrix - allocate a 2D matrix of BitSequence values
  *
@@ -265,11 +385,14 @@ def_matrix(struct thread_state *thread_state, int M, int Q, BitSequence ** m, lo
 	if (state == NULL) {
 		err(121, __func__, "state arg is NULL");
 	}
-	if (state->epsilon == NULL) {
-		err(121, __func__, "state->epsilon is NULL");
+	if (state->packedEpsilon == NULL) {
+		err(121, __func__, "state->packedEpsilon is NULL");
 	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(151, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	if (state->packedEpsilon[thread_state->thread_id] == NULL) {
+		err(151, __func__, "state->packedEpsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->byteEpsilon == true && (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL)) {
+		err(121, __func__, "-B was given but state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 	if (M < 0) {
 		err(121, __func__, "number of rows: %d must be > 0", M);
@@ -281,9 +404,425 @@ def_matrix(struct thread_state *thread_state, int M, int Q, BitSequence ** m, lo
 		err(121, __func__, "offset for the values to copy from the sequence to to m: %d must be > 0", Q);
 	}
 
-	for (i = 0; i < M; i++) {
-		for (j = 0; j < Q; j++) {
-			m[i][j] = state->epsilon[thread_state->thread_id][k * (M * Q) + j + i * M];
+	if (state->byteEpsilon == true) {
+		for (i = 0; i < M; i++) {
+			for (j = 0; j < Q; j++) {
+				m[i][j] = state->epsilon[thread_state->thread_id][k * (M * Q) + j + i * Q];
+			}
 		}
+	} else {
+		for (i = 0; i < M; i++) {
+			unpackBits(state->packedEpsilon[thread_state->thread_id], k * (M * Q) + i * Q, Q, m[i]);
+		}
+	}
+}
+
+
+
+/*
+ * load_word_rows - load the rows of a matrix from consecutive bits of a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit of the matrix
+ *      M       // Number of rows in the matrix
+ *      Q       // Number of columns in each row of the matrix, 1 <= Q <= 32
+ *      rows    // where to store row i of the matrix, see computeWordRank()
+ *      stride  // number of DBLWORDs between two rows
+ */
+static void
+load_word_rows(const WORD64 *w, long int pos, int M, int Q, DBLWORD *rows, int stride)
+{
+	int i;
+
+	for (i = 0; i < M; i++, pos += Q) {
+		rows[i * stride] = (DBLWORD) (packedBits(w, pos, Q) << (BITS_N_DBLWORD - Q));
+	}
+}
+
+
+/*
+ * rank_batch - compute the ranks of RANK_BATCH matrices at once
+ *
+ * given:
+ *      M       // Number of rows in each matrix, M <= 32
+ *      Q       // Number of columns in each row, 1 <= Q <= 32
+ *      rows    // row i of matrix l is rows[i][l]
+ *      rank    // where to store the rank of matrix l
+ *
+ * The same operations are done on every matrix, one matrix per lane, so that the inner loops over the
+ * lanes have no branches and are vectorized by the compiler.  For each column, the pivot is the last
+ * row with a 1 in that column.  The pivot is XORed into every row with a 1 in that column, itself
+ * included, which clears the column and leaves the rank of the remaining rows one less.
+ */
+static void
+rank_batch(int M, int Q, DBLWORD rows[][RANK_BATCH], int *rank)
+{
+	DBLWORD pivot[RANK_BATCH];	// pivot row of each matrix, 0 if none
+	DBLWORD has;			// all 1 bits if the row has a 1 in the column, else 0
+	int shift;			// shift of the column bit to the least significant bit
+	int i;
+	int l;
+
+	for (l = 0; l < RANK_BATCH; l++) {
+		rank[l] = 0;
+	}
+	for (shift = BITS_N_DBLWORD - 1; shift >= BITS_N_DBLWORD - Q; shift--) {
+		for (l = 0; l < RANK_BATCH; l++) {
+			pivot[l] = 0;
+		}
+		for (i = 0; i < M; i++) {
+			for (l = 0; l < RANK_BATCH; l++) {
+				has = (DBLWORD) 0 - ((rows[i][l] >> shift) & 1);
+				pivot[l] = (pivot[l] & ~has) | (rows[i][l] & has);
+			}
+		}
+		for (i = 0; i < M; i++) {
+			for (l = 0; l < RANK_BATCH; l++) {
+				has = (DBLWORD) 0 - ((rows[i][l] >> shift) & 1);
+				rows[i][l] ^= pivot[l] & has;
+			}
+		}
+		for (l = 0; l < RANK_BATCH; l++) {
+			rank[l] += (int) ((pivot[l] >> shift) & 1);
+		}
+	}
+}
+
+
+/*
+ * countWordRanks - count the ranks of consecutive matrices of a packed bit stream
+ *
+ * given:
+ *      w               // packed bit stream
+ *      count           // number of consecutive M by Q matrices, starting at bit 0
+ *      M               // Number of rows in each matrix, M <= 32
+ *      Q               // Number of columns in each row, 1 <= Q <= 32
+ *      F_M             // where to store the number of matrices of full rank MIN(M, Q)
+ *      F_M_minus_one   // where to store the number of matrices of rank MIN(M, Q) - 1
+ *      F_remaining     // where to store the number of matrices of smaller rank
+ *
+ * The matrices are done RANK_BATCH at a time by rank_batch(), the matrices left over are done
+ * one at a time by computeWordRank().
+ *
+ * NOTE: This function does NOT return on error.
+ */
+void
+countWordRanks(const WORD64 *w, long int count, int M, int Q,
+	       long int *F_M, long int *F_M_minus_one, long int *F_remaining)
+{
+	DBLWORD rows[BITS_N_DBLWORD][RANK_BATCH];	// row i of the l-th matrix of a batch is rows[i][l]
+	DBLWORD row[BITS_N_DBLWORD];	// rows of a matrix left over after the last full batch
+	int rank[RANK_BATCH];		// ranks of the matrices of a batch
+	long int pos;			// index of the first bit of a matrix
+	long int k;
+	int full;			// rank of a full rank matrix
+	int lanes;			// number of matrices in this batch
+	int l;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(124, __func__, "w arg is NULL");
+	}
+	if (F_M == NULL || F_M_minus_one == NULL || F_remaining == NULL) {
+		err(124, __func__, "F_M, F_M_minus_one and F_remaining args must not be NULL");
+	}
+	if (count < 0) {
+		err(124, __func__, "number of matrices: %ld must be >= 0", count);
+	}
+	if (M < 1 || M > BITS_N_DBLWORD) {
+		err(124, __func__, "number of rows: %d must be > 0 and <= %d", M, BITS_N_DBLWORD);
+	}
+	if (Q < 1 || Q > BITS_N_DBLWORD) {
+		err(124, __func__, "number of columns per rows: %d must be > 0 and <= %d", Q, BITS_N_DBLWORD);
 	}
+
+	full = MIN(M, Q);
+	*F_M = 0;
+	*F_M_minus_one = 0;
+	*F_remaining = 0;
+	for (k = 0; k < count; k += lanes) {
+		lanes = (int) MIN((long int) RANK_BATCH, count - k);
+		pos = k * (M * Q);
+
+		if (lanes == RANK_BATCH) {
+			for (l = 0; l < RANK_BATCH; l++, pos += M * Q) {
+				load_word_rows(w, pos, M, Q, &rows[0][l], RANK_BATCH);
+			}
+			rank_batch(M, Q, rows, rank);
+		} else {
+			for (l = 0; l < lanes; l++, pos += M * Q) {
+				load_word_rows(w, pos, M, Q, row, 1);
+				rank[l] = computeWordRank(M, Q, row);
+			}
+		}
+
+		for (l = 0; l < lanes; l++) {
+			if (rank[l] == full) {
+				++*F_M;
+			} else if (rank[l] == full - 1) {
+				++*F_M_minus_one;
+			} else {
+				++*F_remaining;
+			}
+		}
+	}
+}
+
+
+/*
+ * create_packed_matrix - allocate an M by Q matrix of packed rows for computePackedRank()
+ *
+ * given:
+ *      M       // Number of rows in the matrix
+ *      Q       // Number of columns in each matrix row
+ *
+ * returns:
+ *      M rows of WORD64_COUNT(Q) words each, followed by the 2^M4RI_K rows of the table used
+ *      by computePackedRank().  The matrix is freed with free().
+ *
+ * NOTE: This function does NOT return on error.
+ */
+WORD64 *
+create_packed_matrix(int M, int Q)
+{
+	WORD64 *rows;		// matrix to return
+	size_t words;		// number of words to allocate
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (M < 1) {
+		err(125, __func__, "number of rows: %d must be > 0", M);
+	}
+	if (Q < 1) {
+		err(125, __func__, "number of columns per rows: %d must be > 0", Q);
+	}
+
+	words = ((size_t) M + ((size_t) 1 << M4RI_K)) * (size_t) WORD64_COUNT(Q);
+	rows = malloc(words * sizeof(rows[0]));
+	if (rows == NULL) {
+		errp(125, __func__, "cannot malloc of %lu elements of %lu bytes each for a %d by %d packed matrix",
+		     (unsigned long) words, (unsigned long) sizeof(rows[0]), M, Q);
+	}
+
+	return rows;
+}
+
+
+/*
+ * def_packed_matrix - fills the given packed matrix with consecutive bits from a packed bit stream
+ *
+ * given:
+ *      w       // packed bit stream
+ *      pos     // index of the first bit of the matrix
+ *      M       // Number of rows in the matrix
+ *      Q       // Number of columns in each row of the matrix
+ *      rows    // matrix allocated by create_packed_matrix()
+ *
+ * Column j of a row is bit 63 - j % 64 of its word j / 64, the same layout as a packed bit stream,
+ * and the bits after column Q - 1 are 0.
+ */
+void
+def_packed_matrix(const WORD64 *w, long int pos, int M, int Q, WORD64 *rows)
+{
+	long int words;		// words per row
+	int len;		// columns in the last word of a row
+	int i;
+	int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (w == NULL) {
+		err(126, __func__, "w arg is NULL");
+	}
+	if (rows == NULL) {
+		err(126, __func__, "rows arg is NULL");
+	}
+	if (pos < 0) {
+		err(126, __func__, "pos: %ld must be >= 0", pos);
+	}
+	if (M < 1 || Q < 1) {
+		err(126, __func__, "number of rows: %d and columns per rows: %d must be > 0", M, Q);
+	}
+
+	words = WORD64_COUNT(Q);
+	len = Q - (int) (words - 1) * BITS_N_WORD64;
+	for (i = 0; i < M; i++, rows += words) {
+		for (j = 0; j < words - 1; j++, pos += BITS_N_WORD64) {
+			rows[j] = packedBits(w, pos, BITS_N_WORD64);
+		}
+		rows[j] = packedBits(w, pos, len) << (BITS_N_WORD64 - len);
+		pos += len;
+	}
+}
+
+
+/*
+ * xor_words - XOR len words of y into x
+ */
+static void
+xor_words(WORD64 *x, const WORD64 *y, long int len)
+{
+	long int i;
+
+	for (i = 0; i < len; i++) {
+		x[i] ^= y[i];
+	}
+}
+
+
+/*
+ * swap_words - exchange len words of x and y
+ */
+static void
+swap_words(WORD64 *x, WORD64 *y, long int len)
+{
+	WORD64 tmp;
+	long int i;
+
+	for (i = 0; i < len; i++) {
+		tmp = x[i];
+		x[i] = y[i];
+		y[i] = tmp;
+	}
+}
+
+
+/*
+ * computePackedRank - compute the rank over GF(2) of a matrix of packed rows
+ *
+ * given:
+ *      M       // Number of rows in the matrix
+ *      Q       // Number of columns in each matrix row
+ *      rows    // matrix allocated by create_packed_matrix() and filled by def_packed_matrix()
+ *
+ * returns:
+ *      The rank of the matrix.
+ *
+ * This is the elimination of the Method of Four Russians (M4RI).  The columns are taken M4RI_K at a time.
+ * Up to M4RI_K pivot rows are found for those columns, reducing only the rows that are searched, and the
+ * pivots are reduced so that each has a single 1 in the pivot columns.  A table of the XOR of every subset
+ * of the pivots is then built with one row XOR per entry.  Each of the other rows is cleared in all of the
+ * pivot columns at once by XORing the table entry selected by its bits in those columns, instead of by one
+ * row XOR per pivot.  A column without a pivot was found to be 0 in every row that was searched, and the
+ * table XORs keep it 0, so the rows below the pivots are 0 in all the columns done so far.
+ *
+ * The rows are reduced in place.
+ *
+ * NOTE: This function does NOT return on error.
+ */
+int
+computePackedRank(int M, int Q, WORD64 *rows)
+{
+	WORD64 *table;		// XOR of every subset of the pivot rows, after the matrix rows
+	WORD64 *pivot[M4RI_K];	// pivot rows of the current columns
+	WORD64 *row;		// a row of the matrix
+	long int words;		// words per row
+	long int first;		// first word of a row holding one of the current columns
+	long int len;		// words of a row from word first onward
+	long int idx;		// subset of the pivots, bit t for pivot t
+	int column[M4RI_K];	// column of each pivot
+	int pivots;		// number of pivots found for the current columns
+	int shift;		// shift of a pivot column bit to the least significant bit
+	int rank;
+	int c;
+	int i;
+	int j;
+	int t;
+	int u;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (rows == NULL) {
+		err(127, __func__, "rows arg is NULL");
+	}
+	if (M < 1 || Q < 1) {
+		err(127, __func__, "number of rows: %d and columns per rows: %d must be > 0", M, Q);
+	}
+
+	words = WORD64_COUNT(Q);
+	table = rows + (long int) M * words;
+	rank = 0;
+	for (c = 0; c < Q && rank < M; c += M4RI_K) {
+		first = c / BITS_N_WORD64;
+		len = words - first;
+
+		/*
+		 * Find the pivot rows of columns c thru c + M4RI_K - 1
+		 */
+		pivots = 0;
+		for (j = c; j < MIN(c + M4RI_K, Q) && rank + pivots < M; j++) {
+			for (i = rank + pivots; i < M; i++) {
+				row = rows + i * words;
+				for (t = 0; t < pivots; t++) {
+					if (PACKED_BIT(row, column[t]) != 0) {
+						xor_words(row + first, pivot[t] + first, len);
+					}
+				}
+				if (PACKED_BIT(row, j) != 0) {
+					break;
+				}
+			}
+			if (i == M) {
+				continue;	// no pivot for this column
+			}
+			pivot[pivots] = rows + (rank + pivots) * words;
+			if (i != rank + pivots) {
+				swap_words(pivot[pivots] + first, rows + i * words + first, len);
+			}
+			column[pivots] = j;
+			pivots++;
+		}
+		if (pivots == 0) {
+			continue;
+		}
+
+		/*
+		 * Leave a single 1 in the pivot columns of each pivot
+		 *
+		 * A pivot is already 0 in the columns of the pivots found before it.
+		 */
+		for (t = pivots - 1; t > 0; t--) {
+			for (u = 0; u < t; u++) {
+				if (PACKED_BIT(pivot[u], column[t]) != 0) {
+					xor_words(pivot[u] + first, pivot[t] + first, len);
+				}
+			}
+		}
+
+		/*
+		 * Build the table of the XOR of every subset of the pivots
+		 */
+		memset(table + first, 0, (size_t) len * sizeof(table[0]));
+		for (idx = 1; idx < (1L << pivots); idx++) {
+			for (t = 0; (idx & (1L << t)) == 0; t++) {
+			}
+			memcpy(table + idx * words + first, table + (idx & (idx - 1)) * words + first,
+			       (size_t) len * sizeof(table[0]));
+			xor_words(table + idx * words + first, pivot[t] + first, len);
+		}
+
+		/*
+		 * Clear the pivot columns of the rows below the pivots
+		 */
+		for (i = rank + pivots; i < M; i++) {
+			row = rows + i * words;
+			idx = 0;
+			for (t = 0; t < pivots; t++) {
+				shift = BITS_N_WORD64 - 1 - column[t] % BITS_N_WORD64;
+				idx |= (long int) ((row[first] >> shift) & 1) << t;
+			}
+			if (idx != 0) {
+				xor_words(row + first, table + idx * words + first, len);
+			}
+		}
+		rank += pivots;
+	}
+
+	return rank;
 }
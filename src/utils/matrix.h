@@ -30,8 +30,22 @@
 
 #include "../utils/defs.h"
 
+#   define BITS_N_DBLWORD (32)			// Number of bits in a DBLWORD row of computeWordRank()
+#   define RANK_BATCH (8)				// Number of matrices whose ranks countWordRanks() computes at once
+#   define M4RI_K (8)				// Number of columns computePackedRank() eliminates at once
+#   if M4RI_K < 1 || M4RI_K > 8 || 64 % M4RI_K != 0
+// force syntax error if the columns eliminated at once do not all fall into the same WORD64
+      -=*#@#*=- M4RI_K must be 1, 2, 4 or 8 -=*#@#*=-
+#   endif
+
 extern int computeRank(int M, int Q, BitSequence ** matrix);
+extern int computeWordRank(int M, int Q, DBLWORD *rows);
 extern BitSequence **create_matrix(int M, int Q);
 extern void def_matrix(struct thread_state *thread_state, int M, int Q, BitSequence ** m, long int k);
+extern WORD64 *create_packed_matrix(int M, int Q);
+extern void def_packed_matrix(const WORD64 *w, long int pos, int M, int Q, WORD64 *rows);
+extern int computePackedRank(int M, int Q, WORD64 *rows);
+extern void countWordRanks(const WORD64 *w, long int count, int M, int Q,
+			   long int *F_M, long int *F_M_minus_one, long int *F_remaining);
 
 #endif				/* MATRIX_H */
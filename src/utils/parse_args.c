@@ -97,16 +97,55 @@ static struct state const defaultstate = {
 	false,				// -F format was not given
 	FORMAT_RAW_BINARY,		// Read data as raw binary
 
-	// numberOfThreads
+	// readerFlag, reader, mapAddr, mapLength, mapData, mapDataLength
+	false,				// -R reader was not given
+	READER_PREAD,			// Read raw binary data with pread(), unless it is not a regular file
+	NULL,				// randdata is not mapped
+	0,
+	NULL,
+	0,
+
+	// readerThreadsFlag, readerThreads
+	false,				// -r readers was not given
+	1,				// One reader thread when the stdio reader is used, else test threads read
+
+	// asciiCursor, asciiIndexFlag, asciiIndex
+	{NULL,				// No ASCII randdata has been read ahead
+	 0,
+	 0,
+	 0,
+	 -1,				// Position in ASCII randdata is not yet known
+	},
+	false,				// -x was not given
+	NULL,				// No ASCII index has been loaded
+
+	// decompressor
+	NULL,				// randdata is not being decompressed
+
+	// fftEffortFlag, fftEffort, wisdomPath, inPlaceFFT, singleFFT, scratchDir
+	false,				// -E effort was not given
+	FFT_ESTIMATE,			// Plan the DFT test transform with FFTW_ESTIMATE
+	NULL,				// No -W wisdom was given
+	false,				// -H was not given, transform the DFT test out of place
+	false,				// -D was not given, transform the DFT test in double precision
+	NULL,				// No -X scratchdir was given, transform the DFT test in memory
+
+	// numberOfThreads, iterationsMissing, iterationsDone, fftThreads
 	false,
 	0,
 	0,
+	0,
+	1,				// Each DFT test transform is done by one thread
 
 	// jobnumFlag, jobnum & base_seek
 	false,				// No -j jobnum was given
 	0,				// Begin at start of randdata (-j 0)
 	0,				// Default seek to 0
 
+	// carryBytes & carryBits
+	{0},
+	0,				// No partly tested word of stdin
+
 	// pvalues_dir & filenames
 	NULL,				// Directory where to look for the .pvalues binary files
 	NULL,				// Names of the .pvalues files
@@ -123,6 +162,8 @@ static struct state const defaultstate = {
 	 DEFAULT_BITCOUNT,		// -P 9=bitcount, Length of a single bit stream
 	 DEFAULT_UNIFORMITY_LEVEL,	// -P 10=uni_level, uniformity errors have values below this
 	 DEFAULT_ALPHA,			// -P 11=alpha, p_value significance level
+	 DEFAULT_RANK_ROWS,		// -P 12=M, Rank Test - rows per matrix
+	 DEFAULT_RANK_COLS,		// -P 13=Q, Rank Test - columns per matrix
 	},
 	false,				// Do not prompt for change of parameters
 	false,				// No -P 8 was given with custom uniformity bins
@@ -202,7 +243,9 @@ static struct state const defaultstate = {
 	 false, false, false, false, true, true, false, false,
 	},
 
-	// epsilon, tmpepsilon
+	// byteEpsilon, epsilon, tmpepsilon, packedEpsilon
+	false,				// No -B, tests use the packed bit stream only
+	NULL,
 	NULL,
 	NULL,
 
@@ -238,20 +281,31 @@ static struct state const defaultstate = {
 	// nonovTemplates
 	NULL,
 
-	// fft_m, fft_X
+	// fft_X, fft_scratch, fft_roots
+	NULL,
 	NULL,
 	NULL,
 
 # if defined(LEGACY_FFT)
-	// fft_wsave
+	// fft_plan, fft_work, fft_row_plan and fft_col_plan
+	NULL,
+	NULL,
+	NULL,
 	NULL,
 #else /* LEGACY_FFT */
-	// fftw_p and fftw_out
+	// fftw_p, fftw_out, fftw_row_p, fftw_col_p, fftwf_p, fftw_batch_p, fft_batched and fft_iteration
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
 	NULL,
 	NULL,
 #endif /* LEGACY_FFT */
 
-	// rank_matrix
+	// rank_matrix, rank_rows
+	NULL,
 	NULL,
 
 	// rnd_excursion_var_stateX, ex_var_partial_sums
@@ -271,7 +325,9 @@ static struct state const defaultstate = {
 	NULL,
 	0,
 
-	// nonper_seq
+	// nonper_seq, nonper_index, nonper_next
+	NULL,
+	NULL,
 	NULL,
 
 	// universal_L, universal_T
@@ -297,8 +353,8 @@ static struct state const defaultstate = {
 static const char * const usage =
 "[-v level] [-A] [-t test1[,test2]..]\n"
 "             [-P num=value[,num=value]..] [-i iterations] [-I reportCycle] [-O]\n"
-"             [-w workDir] [-c] [-s] [-F format] [-j jobnum] [-S bitcount]\n"
-"             [-m mode] [-T numOfThreads] [-d pvaluesdir] [-h] [randdata]\n"
+"             [-w workDir] [-c] [-s] [-F format] [-R reader] [-r readers] [-x] [-B] [-E effort] [-W wisdom] [-H] [-D]\n"
+"             [-X scratchdir] [-j jobnum] [-S bitcount] [-m mode] [-T numOfThreads] [-d pvaluesdir] [-h] [randdata]\n"
 "\n"
 "    -v  debuglevel     debug level (def: 0 -> no debug messages)\n"
 "    -A                 ask a human what to do, use obsolete interactive mode (def: batch mode)\n"
@@ -328,6 +384,8 @@ static const char * const usage =
 "       9: Bits to process per iteration (same as -S bitcount):	1048576 (== 1024*1024)\n"
 "      10: Uniformity Cutoff Level:				0.0001\n"
 "      11: Alpha Confidence Level:				0.01\n"
+"      12: Rank Test - rows per matrix(M):			32\n"
+"      13: Rank Test - columns per matrix(Q):			32\n"
 "      Warning: Change the above parameters only if you really know what you are doing!\n";
 static const char * const usage2 =
 "\n"
@@ -340,6 +398,33 @@ static const char * const usage2 =
 "    -c                 don't create any directories needed for creating files (def: do create)\n"
 "    -s                 create result.txt, data*.txt, and stats.txt (def: don't create)\n"
 "    -F format          randdata format: 'r': raw binary, 'a': ASCII '0'/'1' chars (def: 'r')\n"
+"                       'l': raw binary, least significant bit of each byte first\n"
+"                       'w': 32 bit little endian words, 'q': 64 bit little endian words\n"
+"                       'W': 32 bit big endian words, 'Q': 64 bit big endian words (same as 'r')\n"
+"                       The bits of a word are tested most significant bit first\n"
+"    -R reader          how to read randdata (def: 'p' for a regular file, 's' otherwise)\n"
+"                       's': fseek() and fread() on a shared stream, one thread at a time\n"
+"                       'p': each thread reads its own bitstreams with pread(), without locking\n"
+"                       'm': mmap() randdata and let each thread convert its bitstreams without locking\n"
+"                       -R p and -R m require a randdata file that is not -, -R m requires -F r, -R p requires -x with -F a\n"
+"    -r readers         number of threads that read bitstreams ahead of the test threads (def: 1 with -R s, else 0)\n"
+"                       0: each test thread reads its own bitstreams, -r is ignored with -R m\n"
+"    -x                 use the ASCII offset index randdata.idx, build it first if it is missing or out of date\n"
+"                       This lets -j and each thread seek to their bitstreams in ASCII randdata with whitespace.\n"
+"                       Requires -F a and a randdata file that is not -\n"
+"    -B                 also keep one byte per bit of each bitstream and use the byte-wise test code (def: packed bits only)\n"
+"                       This uses 8 times the memory for the bitstreams and is mainly useful to cross-check results.\n"
+"    -E effort          how hard FFTW plans the DFT test transform (def: 'e')\n"
+"                       'e': estimate, 'm': measure, 'p': patient, 'x': exhaustive\n"
+"                       Plans other than 'e' are saved as FFTW wisdom, so later runs at the same bitcount plan at once.\n"
+"    -W wisdom          FFTW wisdom file read before and written after planning (def: workDir/fftw.wisdom if -E is not 'e')\n"
+"    -H                 transform the DFT test in place, which halves its memory (def: into a separate output array)\n"
+"    -D                 transform the DFT test in single precision first, for bitcounts up to 4096 (def: double precision)\n"
+"                       Bins too close to the threshold for the single precision error bound are decided in double precision.\n"
+"                       -E, -W, -H and -D are ignored when sts is built with the legacy FFT (make legacy).\n"
+"    -X scratchdir      transform the DFT test out of core, in scratch files under scratchdir (def: in memory)\n"
+"                       This lets bitcounts whose transform does not fit in memory run the DFT test.\n";
+static const char * const usage3 =
 "    -S bitcount        Number of bits to process in a single iteration (def: 1048576 == 1024*1024) (same as -P 9=bitcount)\n"
 "    -j jobnum          seek into randdata, jobnum * bitcount * iterations bits (def: 0)\n"
 "                       Seeking is disabled if randdata is - and data for all jobs is read from beginning of standard input.\n"
@@ -394,6 +479,7 @@ parse_args(struct state *state, int argc, char **argv)
 	double d_value;		// Parsed parameter floating point
 	bool success = false;	// true if str2longint was successful
 	int test_cnt = 0;
+	long int cores;		// Threads -T asked for, else the number of cores
 	long int i;
 
 	/*
@@ -423,7 +509,7 @@ parse_args(struct state *state, int argc, char **argv)
 	 */
 	opterr = 0;
 	brkt = NULL;
-	while ((option = getopt(argc, argv, "v:Abt:g:pP:S:i:I:Ow:csf:F:j:m:T:d:h")) != -1) {
+	while ((option = getopt(argc, argv, "v:Abt:g:pP:S:i:I:Ow:csf:F:R:r:xBE:W:HDX:j:m:T:d:h")) != -1) {
 		switch (option) {
 
 		case 'v':	// -v debuglevel
@@ -510,7 +596,7 @@ parse_args(struct state *state, int argc, char **argv)
 				/*
 				 * Parse parameter value
 				 */
-				if (num <= MAX_INT_PARAM) {
+				if (num <= MAX_INT_PARAM || num > MAX_DOUBLE_PARAM) {
 
 					// Parse parameter number as an integer
 					scan_cnt = sscanf(phrase, "%ld=%ld", &num, &value);
@@ -607,7 +693,7 @@ parse_args(struct state *state, int argc, char **argv)
 			state->resultstxtFlag = true;
 			break;
 
-		case 'F':	// -F format: 'r' or '1': raw binary, 'a' or '0': ASCII '0'/'1' chars
+		case 'F':	// -F format: 'r' or '1': raw binary, 'a' or '0': ASCII '0'/'1' chars, 'l', 'w', 'W', 'q', 'Q'
 			state->dataFormatFlag = true;
 			state->dataFormat = (enum format) (optarg[0]);
 			switch (state->dataFormat) {
@@ -615,16 +701,101 @@ parse_args(struct state *state, int argc, char **argv)
 				state->dataFormat = FORMAT_ASCII_01;
 				break;
 			case FORMAT_1:
+			case FORMAT_WORD32_BE:
+			case FORMAT_WORD64_BE:
 				state->dataFormat = FORMAT_RAW_BINARY;
 				break;
 			case FORMAT_ASCII_01:
 			case FORMAT_RAW_BINARY:
+			case FORMAT_RAW_LSB:
+			case FORMAT_WORD32_LE:
+			case FORMAT_WORD64_LE:
 				break;
 			default:
-				err(1, __func__, "-F format: %s must be r or a", optarg);
+				err(1, __func__, "-F format: %s must be r, a, l, w, W, q or Q", optarg);
 			}
 			if (optarg[1] != '\0') {
-				err(1, __func__, "-F format: %s must be a single character: r or a", optarg);
+				err(1, __func__, "-F format: %s must be a single character: r, a, l, w, W, q or Q", optarg);
+			}
+			break;
+
+		case 'R':	// -R reader: 's': stdio, 'p': pread, 'm': mmap
+			state->readerFlag = true;
+			if (optarg[0] == '\0' || optarg[1] != '\0') {
+				usage_err(1, __func__, "-R reader must be a single character: %s", optarg);
+			}
+			switch (optarg[0]) {
+			case READER_STDIO:
+				state->reader = READER_STDIO;
+				break;
+			case READER_MMAP:
+				state->reader = READER_MMAP;
+				break;
+			case READER_PREAD:
+				state->reader = READER_PREAD;
+				break;
+			default:
+				usage_err(1, __func__, "-R reader must be one of s, p or m: %c", optarg[0]);
+				break;
+			}
+			break;
+
+		case 'r':	// -r readers
+			state->readerThreadsFlag = true;
+			state->readerThreads = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -r readers: %s", optarg);
+			}
+			if (state->readerThreads < 0) {
+				usage_err(1, __func__, "-r readers: %ld must be >= 0", state->readerThreads);
+			}
+			break;
+
+		case 'x':	// -x (use an ASCII offset index)
+			state->asciiIndexFlag = true;
+			break;
+
+		case 'B':	// -B (also keep a one byte per bit view of each bitstream)
+			state->byteEpsilon = true;
+			break;
+
+		case 'E':	// -E effort: how hard FFTW plans the DFT test transform
+			state->fftEffortFlag = true;
+			if (optarg[0] == '\0' || optarg[1] != '\0') {
+				usage_err(1, __func__, "-E effort must be a single character: %s", optarg);
+			}
+			switch (optarg[0]) {
+			case FFT_ESTIMATE:
+			case FFT_MEASURE:
+			case FFT_PATIENT:
+			case FFT_EXHAUSTIVE:
+				state->fftEffort = (enum fft_effort) optarg[0];
+				break;
+			default:
+				usage_err(1, __func__, "-E effort must be one of e, m, p or x: %c", optarg[0]);
+				break;
+			}
+			break;
+
+		case 'W':	// -W wisdom: FFTW wisdom file
+			state->wisdomPath = strdup(optarg);
+			if (state->wisdomPath == NULL) {
+				errp(1, __func__, "strdup of %lu bytes for -W wisdom failed", strlen(optarg));
+			}
+			break;
+
+		case 'H':	// -H (transform the DFT test in place)
+			state->inPlaceFFT = true;
+			break;
+
+		case 'D':	// -D (transform the DFT test in single precision first)
+			state->singleFFT = true;
+			break;
+
+		case 'X':	// -X scratchdir: transform the DFT test out of core
+			state->scratchDir = strdup(optarg);
+			if (state->scratchDir == NULL) {
+				errp(1, __func__, "strdup of %lu bytes for -X scratchdir failed", strlen(optarg));
 			}
 			break;
 
@@ -684,9 +855,9 @@ parse_args(struct state *state, int argc, char **argv)
 
 		case 'h':	// -h (print out help)
 			if (program == NULL) {
-				fprintf(stderr, "usage: sts %s%s", usage, usage2);
+				fprintf(stderr, "usage: sts %s%s%s", usage, usage2, usage3);
 			} else {
-				fprintf(stderr, "usage: %s %s%s", program, usage, usage2);
+				fprintf(stderr, "usage: %s %s%s%s", program, usage, usage2, usage3);
 			}
 			fprintf(stderr, "\nVersion: %s\n", version);
 			exit(0);
@@ -809,6 +980,7 @@ parse_args(struct state *state, int argc, char **argv)
 	else if (state->numberOfThreadsFlag == false) {
 		state->numberOfThreads = MIN(sysconf(_SC_NPROCESSORS_ONLN), state->tp.numOfBitStreams);
 	}
+	cores = (state->numberOfThreadsFlag == true) ? state->numberOfThreads : sysconf(_SC_NPROCESSORS_ONLN);
 
 	/*
 	 * If a custom number of threads was set and this number is greater than the number of processors
@@ -831,6 +1003,17 @@ parse_args(struct state *state, int argc, char **argv)
 		state->numberOfThreads = state->tp.numOfBitStreams;
 	}
 
+	/*
+	 * When fewer iterations are left than threads (or cores), the threads left without a bitstream
+	 * share the transforms of the DFT test instead of sitting idle.  A transform may use up to all
+	 * of them, when it is the last iteration left.
+	 */
+	if (cores > 1) {
+		state->fftThreads = cores;
+	} else {
+		state->fftThreads = 1;
+	}
+
 	/*
 	 * Look for the matching .pvalues files in the folder given with -d
 	 */
@@ -921,6 +1104,65 @@ parse_args(struct state *state, int argc, char **argv)
 		}
 	}
 
+	/*
+	 * The pread and mmap readers need binary data from a file, the mmap reader needs it in the -F r format
+	 *
+	 * When no -R reader was given, the default pread reader silently falls back to the stdio reader.
+	 */
+	if (state->readerFlag == true && (state->reader == READER_MMAP || state->reader == READER_PREAD)) {
+		if (state->stdinData == true) {
+			usage_err(1, __func__, "-R %c not allowed when randdata is - (reading data from standard input)",
+				  (char) state->reader);
+		}
+		if (state->reader == READER_MMAP && state->dataFormat != FORMAT_RAW_BINARY) {
+			usage_err(1, __func__, "-R m requires -F r (raw binary randdata)");
+		}
+		if (state->reader == READER_PREAD && state->dataFormat == FORMAT_ASCII_01 && state->asciiIndexFlag == false) {
+			usage_err(1, __func__, "-R p requires binary randdata, or -F a with -x");
+		}
+	}
+
+	/*
+	 * The ASCII index is for ASCII data from a file
+	 */
+	if (state->asciiIndexFlag == true) {
+		if (state->stdinData == true) {
+			usage_err(1, __func__, "-x not allowed when randdata is - (reading data from standard input)");
+		}
+		if (state->dataFormat != FORMAT_ASCII_01) {
+			usage_err(1, __func__, "-x requires -F a (ASCII '0'/'1' randdata)");
+		}
+	}
+
+	/*
+	 * FFTW planning options do not apply to the legacy FFT
+	 */
+#if defined(LEGACY_FFT)
+	if (state->fftEffortFlag == true || state->wisdomPath != NULL) {
+		warn(__func__, "-E effort and -W wisdom are ignored, this sts was built with the legacy FFT");
+	}
+	if (state->inPlaceFFT == true) {
+		warn(__func__, "-H is ignored, this sts was built with the legacy FFT");
+		state->inPlaceFFT = false;
+	}
+	if (state->singleFFT == true) {
+		warn(__func__, "-D is ignored, this sts was built with the legacy FFT");
+		state->singleFFT = false;
+	}
+#endif /* LEGACY_FFT */
+
+	/*
+	 * The out-of-core DFT test transform has its own buffers
+	 */
+	if (state->scratchDir != NULL && state->inPlaceFFT == true) {
+		warn(__func__, "-H is ignored with -X scratchdir");
+		state->inPlaceFFT = false;
+	}
+	if (state->scratchDir != NULL && state->singleFFT == true) {
+		warn(__func__, "-D is ignored with -X scratchdir");
+		state->singleFFT = false;
+	}
+
 	/*
 	 * When running in ASSESS_ONLY MODE
 	 */
@@ -936,12 +1178,6 @@ parse_args(struct state *state, int argc, char **argv)
 	/*
 	 * verify that bitcount is OK
 	 */
-	if ((state->tp.n % 8) != 0) {
-		usage_err(1, __func__,
-			  "bitcount(n): %ld must be a multiple of 8. The added complexity of supporting "
-					  "a sequence that starts or ends on a non-byte boundary outweighs the "
-					  "convenience of permitting arbitrary bit lengths", state->tp.n);
-	}
 	if (state->tp.n < GLOBAL_MIN_BITCOUNT) {
 		usage_err(1, __func__, "bitcount(n): %ld must >= %d", state->tp.n, GLOBAL_MIN_BITCOUNT);
 	}
@@ -1005,6 +1241,12 @@ change_params(struct state *state, long int parameter, long int value, double d_
 	case PARAM_alpha:
 		state->tp.alpha = d_value;
 		break;
+	case PARAM_rankRows:
+		state->tp.rankRows = value;
+		break;
+	case PARAM_rankCols:
+		state->tp.rankCols = value;
+		break;
 	default:
 		err(2, __func__, "invalid parameter option: %ld", parameter);
 		break;
@@ -1175,10 +1417,87 @@ print_option_summary(struct state *state, char *where)
 	case FORMAT_1:
 		dbg(DBG_MED, "\t  read as raw binary 8 bits per byte");
 		break;
+	case FORMAT_RAW_LSB:
+		dbg(DBG_MED, "\t  read as raw binary 8 bits per byte, least significant bit first");
+		break;
+	case FORMAT_WORD32_LE:
+		dbg(DBG_MED, "\t  read as 32 bit little endian words, most significant bit first");
+		break;
+	case FORMAT_WORD64_LE:
+		dbg(DBG_MED, "\t  read as 64 bit little endian words, most significant bit first");
+		break;
 	default:
 		dbg(DBG_MED, "\t  unknown format: %c", (char) state->dataFormat);
 		break;
 	}
+	if (state->readerFlag == true) {
+		dbg(DBG_MED, "\t-R reader was given");
+	} else {
+		dbg(DBG_MED, "\tno -R reader was given");
+	}
+	switch (state->reader) {
+	case READER_STDIO:
+		dbg(DBG_MED, "\t  fseek() and fread() on a shared stream, one thread at a time");
+		break;
+	case READER_MMAP:
+		dbg(DBG_MED, "\t  mmap() raw binary data and convert it without locking");
+		break;
+	case READER_PREAD:
+		dbg(DBG_MED, "\t  read raw binary data with pread() without locking, if randdata is a regular file");
+		break;
+	default:
+		dbg(DBG_MED, "\t  unknown reader: %c", (char) state->reader);
+		break;
+	}
+	if (state->readerThreadsFlag == true) {
+		dbg(DBG_MED, "\t-r readers was given");
+		dbg(DBG_MED, "\t  will use %ld reader threads, unless -R m is used", state->readerThreads);
+	} else {
+		dbg(DBG_MED, "\tno -r readers was given");
+		dbg(DBG_MED, "\t  will use 1 reader thread with the stdio reader, else test threads will read");
+	}
+	if (state->asciiIndexFlag == true) {
+		dbg(DBG_MED, "\t-x was given");
+		dbg(DBG_MED, "\t  will use an ASCII offset index to seek in randdata");
+	} else {
+		dbg(DBG_MED, "\tno -x was given");
+		dbg(DBG_MED, "\t  will seek in ASCII randdata as if it had no whitespace");
+	}
+	if (state->byteEpsilon == true) {
+		dbg(DBG_MED, "\t-B was given");
+		dbg(DBG_MED, "\t  keep one byte per bit of each bitstream and use the byte-wise test code");
+	} else {
+		dbg(DBG_MED, "\tno -B was given");
+		dbg(DBG_MED, "\t  keep bitstreams packed 64 bits per word");
+	}
+	if (state->fftEffortFlag == true) {
+		dbg(DBG_MED, "\t-E %c was given", (char) state->fftEffort);
+	} else {
+		dbg(DBG_MED, "\tno -E effort was given");
+	}
+	if (state->wisdomPath != NULL) {
+		dbg(DBG_MED, "\t-W %s was given", state->wisdomPath);
+	} else {
+		dbg(DBG_MED, "\tno -W wisdom was given");
+	}
+	if (state->inPlaceFFT == true) {
+		dbg(DBG_MED, "\t-H was given");
+		dbg(DBG_MED, "\t  transform the DFT test in place, in half the memory");
+	} else {
+		dbg(DBG_MED, "\tno -H was given");
+	}
+	if (state->singleFFT == true) {
+		dbg(DBG_MED, "\t-D was given");
+		dbg(DBG_MED, "\t  transform the DFT test in single precision, in double only where single is not certain");
+	} else {
+		dbg(DBG_MED, "\tno -D was given");
+	}
+	if (state->scratchDir != NULL) {
+		dbg(DBG_MED, "\t-X %s was given", state->scratchDir);
+		dbg(DBG_MED, "\t  transform the DFT test out of core, in scratch files under %s", state->scratchDir);
+	} else {
+		dbg(DBG_MED, "\tno -X scratchdir was given");
+	}
 	dbg(DBG_MED, "\tjobnum: -j %ld", state->jobnum);
 	if (state->jobnumFlag == true) {
 		dbg(DBG_MED, "\t-j jobnum was set to %ld", state->jobnum);
@@ -1200,7 +1519,8 @@ print_option_summary(struct state *state, char *where)
 	} else {
 		dbg(DBG_MED, "\tno -T numOfThreads was given");
 	}
-	dbg(DBG_MED, "\t  will use %ld threads\n", state->numberOfThreads);
+	dbg(DBG_MED, "\t  will use %ld threads", state->numberOfThreads);
+	dbg(DBG_MED, "\t  each DFT test transform will use up to %ld threads\n", state->fftThreads);
 
 	/*
 	 * Report on test parameters
@@ -1215,6 +1535,8 @@ print_option_summary(struct state *state, char *where)
 	dbg(DBG_MED, "\toverlappingTemplateBlockLength = %ld", state->tp.overlappingTemplateLength);
 	dbg(DBG_MED, "\tserialBlockLength = %ld", state->tp.serialBlockLength);
 	dbg(DBG_MED, "\tlinearComplexitySequenceLength = %ld", state->tp.linearComplexitySequenceLength);
+	dbg(DBG_MED, "\trankRows = %ld", state->tp.rankRows);
+	dbg(DBG_MED, "\trankCols = %ld", state->tp.rankCols);
 	dbg(DBG_MED, "\tapproximateEntropyBlockLength = %ld", state->tp.approximateEntropyBlockLength);
 	dbg(DBG_MED, "\tnumOfBitStreams = %ld", state->tp.numOfBitStreams);
 	dbg(DBG_MED, "\tbins = %ld", state->tp.uniformity_bins);
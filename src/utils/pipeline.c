@@ -0,0 +1,346 @@
+/*****************************************************************************
+	  B I T S T R E A M   R E A D E R   P I P E L I N E
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 90 thru 99
+
+// for posix_memalign()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "pipeline.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static void init_bitstream_queue(struct bitstream_queue *queue, long int size, long int producers);
+static void destroy_bitstream_queue(struct bitstream_queue *queue);
+
+
+/*
+ * init_bitstream_queue - initialize an empty bounded queue of slots
+ *
+ * given:
+ *      queue           // queue to initialize
+ *      size            // maximum number of slots the queue can hold
+ *      producers       // number of producers that will close the queue
+ *
+ * NOTE: This function does NOT return on error.
+ */
+static void
+init_bitstream_queue(struct bitstream_queue *queue, long int size, long int producers)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (queue == NULL) {
+		err(90, __func__, "queue arg is NULL");
+	}
+	if (size <= 0) {
+		err(90, __func__, "size: %ld must be > 0", size);
+	}
+
+	/*
+	 * Initialize the queue
+	 */
+	queue->slot = malloc((size_t) size * sizeof(queue->slot[0]));
+	if (queue->slot == NULL) {
+		errp(90, __func__, "cannot malloc of %ld elements of %ld bytes each for queue->slot",
+		     size, sizeof(queue->slot[0]));
+	}
+	queue->size = size;
+	queue->head = 0;
+	queue->count = 0;
+	queue->producers = producers;
+	errno = pthread_mutex_init(&queue->mutex, NULL);
+	if (errno != 0) {
+		errp(90, __func__, "error on pthread_mutex_init()");
+	}
+	errno = pthread_cond_init(&queue->notEmpty, NULL);
+	if (errno != 0) {
+		errp(90, __func__, "error on pthread_cond_init()");
+	}
+	errno = pthread_cond_init(&queue->notFull, NULL);
+	if (errno != 0) {
+		errp(90, __func__, "error on pthread_cond_init()");
+	}
+
+	return;
+}
+
+
+/*
+ * destroy_bitstream_queue - free the resources of a queue
+ *
+ * given:
+ *      queue           // queue to destroy
+ */
+static void
+destroy_bitstream_queue(struct bitstream_queue *queue)
+{
+	if (queue == NULL) {
+		return;
+	}
+
+	pthread_cond_destroy(&queue->notFull);
+	pthread_cond_destroy(&queue->notEmpty);
+	pthread_mutex_destroy(&queue->mutex);
+	if (queue->slot != NULL) {
+		free(queue->slot);
+		queue->slot = NULL;
+	}
+	queue->size = 0;
+	queue->count = 0;
+
+	return;
+}
+
+
+/*
+ * init_bitstream_pipeline - allocate the slots of a pipeline and queue them as empty
+ *
+ * given:
+ *      pipeline        // pipeline to initialize
+ *      slotCount       // number of slots, i.e., the most iterations held at once
+ *      readers         // number of reader threads, they close the ready queue when done
+ *      testers         // number of test threads, they close the empty queue when done
+ *      n               // number of bits in an iteration
+ *
+ * NOTE: This function does NOT return on error.
+ */
+void
+init_bitstream_pipeline(struct bitstream_pipeline *pipeline, long int slotCount, long int readers, long int testers,
+			long int n)
+{
+	long int page_size;	// Size of a page of memory
+	size_t length;		// Bytes allocated for the data of a slot
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (pipeline == NULL) {
+		err(91, __func__, "pipeline arg is NULL");
+	}
+	if (slotCount <= 0) {
+		err(91, __func__, "slotCount: %ld must be > 0", slotCount);
+	}
+	if (readers <= 0) {
+		err(91, __func__, "readers: %ld must be > 0", readers);
+	}
+	if (testers <= 0) {
+		err(91, __func__, "testers: %ld must be > 0", testers);
+	}
+	if (n <= 0) {
+		err(91, __func__, "n: %ld must be > 0", n);
+	}
+
+	/*
+	 * Round the data of each slot up to whole pages
+	 */
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0) {
+		page_size = BUFSIZ;
+	}
+	length = (size_t) ((ITERATION_BYTES(n) + page_size - 1) / page_size * page_size);
+
+	/*
+	 * Allocate the slots
+	 */
+	pipeline->slots = malloc((size_t) slotCount * sizeof(pipeline->slots[0]));
+	if (pipeline->slots == NULL) {
+		errp(91, __func__, "cannot malloc of %ld elements of %ld bytes each for pipeline->slots",
+		     slotCount, sizeof(pipeline->slots[0]));
+	}
+	pipeline->slotCount = slotCount;
+	for (i = 0; i < slotCount; i++) {
+		pipeline->slots[i].iteration = -1;
+		pipeline->slots[i].bitCount = 0;
+		pipeline->slots[i].bitOffset = 0;
+		errno = posix_memalign((void **) &pipeline->slots[i].data, (size_t) page_size, length);
+		if (errno != 0) {
+			errp(91, __func__, "cannot allocate %ld page aligned bytes for slot %ld", (long int) length, i);
+		}
+	}
+
+	/*
+	 * All slots start out empty
+	 */
+	init_bitstream_queue(&pipeline->empty, slotCount, testers);
+	init_bitstream_queue(&pipeline->ready, slotCount, readers);
+	for (i = 0; i < slotCount; i++) {
+		put_bitstream_slot(&pipeline->empty, &pipeline->slots[i]);
+	}
+
+	return;
+}
+
+
+/*
+ * destroy_bitstream_pipeline - free the slots and queues of a pipeline
+ *
+ * given:
+ *      pipeline        // pipeline to destroy
+ */
+void
+destroy_bitstream_pipeline(struct bitstream_pipeline *pipeline)
+{
+	long int i;
+
+	if (pipeline == NULL) {
+		return;
+	}
+
+	destroy_bitstream_queue(&pipeline->ready);
+	destroy_bitstream_queue(&pipeline->empty);
+	if (pipeline->slots != NULL) {
+		for (i = 0; i < pipeline->slotCount; i++) {
+			free(pipeline->slots[i].data);
+			pipeline->slots[i].data = NULL;
+		}
+		free(pipeline->slots);
+		pipeline->slots = NULL;
+	}
+	pipeline->slotCount = 0;
+
+	return;
+}
+
+
+/*
+ * put_bitstream_slot - add a slot to the end of a queue
+ *
+ * given:
+ *      queue           // queue to add to
+ *      slot            // slot to add
+ *
+ * Waits while the queue is full.
+ */
+void
+put_bitstream_slot(struct bitstream_queue *queue, struct bitstream_slot *slot)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (queue == NULL) {
+		err(92, __func__, "queue arg is NULL");
+	}
+	if (slot == NULL) {
+		err(92, __func__, "slot arg is NULL");
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->count == queue->size) {
+		pthread_cond_wait(&queue->notFull, &queue->mutex);
+	}
+	queue->slot[(queue->head + queue->count) % queue->size] = slot;
+	queue->count++;
+	pthread_cond_signal(&queue->notEmpty);
+	pthread_mutex_unlock(&queue->mutex);
+
+	return;
+}
+
+
+/*
+ * get_bitstream_slot - remove the oldest slot from a queue
+ *
+ * given:
+ *      queue           // queue to remove from
+ *
+ * returns:
+ *      The oldest slot in the queue, or
+ *      NULL if the queue is empty and all of its producers have closed it.
+ *
+ * Waits while the queue is empty and not closed.
+ */
+struct bitstream_slot *
+get_bitstream_slot(struct bitstream_queue *queue)
+{
+	struct bitstream_slot *slot;	// Slot removed from the queue
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (queue == NULL) {
+		err(93, __func__, "queue arg is NULL");
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->count == 0 && queue->producers > 0) {
+		pthread_cond_wait(&queue->notEmpty, &queue->mutex);
+	}
+	if (queue->count == 0) {
+		slot = NULL;
+	} else {
+		slot = queue->slot[queue->head];
+		queue->head = (queue->head + 1) % queue->size;
+		queue->count--;
+		pthread_cond_signal(&queue->notFull);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	return slot;
+}
+
+
+/*
+ * close_bitstream_queue - note that a producer will add no more slots to a queue
+ *
+ * given:
+ *      queue           // queue to close
+ *
+ * Once all producers have closed the queue, get_bitstream_slot() returns NULL when the queue is empty.
+ */
+void
+close_bitstream_queue(struct bitstream_queue *queue)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (queue == NULL) {
+		err(94, __func__, "queue arg is NULL");
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->producers > 0) {
+		queue->producers--;
+	}
+	if (queue->producers == 0) {
+		pthread_cond_broadcast(&queue->notEmpty);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	return;
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************
+	  B I T S T R E A M   R E A D E R   P I P E L I N E
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef PIPELINE_H
+#   define PIPELINE_H
+
+#include <pthread.h>
+#include "../utils/defs.h"
+
+/*
+ * Bitstream pipeline
+ *
+ * Reader threads fill slots with the raw binary data of an iteration and queue them as ready.
+ * Test threads take a ready slot, unpack its data into their own epsilon, return the slot to the
+ * empty queue and then test the iteration.  Both queues are bounded by the number of slots, so
+ * readers wait for an empty slot (backpressure) instead of reading ahead without limit.
+ */
+struct bitstream_slot {
+	long int iteration;		// Iteration whose data is held in the slot
+	long int bitCount;		// Number of bits of the iteration held in data
+	int bitOffset;			// Bit of data where the iteration starts, counted from the first bit of data[0]
+	BYTE *data;			// Page aligned buffer of ITERATION_BYTES(n) bytes
+};
+
+struct bitstream_queue {
+	struct bitstream_slot **slot;	// Ring of queued slots
+	long int size;			// Number of slots the ring can hold
+	long int head;			// Index of the oldest queued slot
+	long int count;			// Number of queued slots
+	long int producers;		// Number of producers that have not closed the queue
+	pthread_mutex_t mutex;		// Protects the queue
+	pthread_cond_t notEmpty;	// Signaled when a slot is queued or the queue is closed
+	pthread_cond_t notFull;		// Signaled when a slot is removed
+};
+
+struct bitstream_pipeline {
+	struct bitstream_slot *slots;	// Slots holding the data of iterations
+	long int slotCount;		// Number of slots
+	struct bitstream_queue empty;	// Slots to be filled by the reader threads
+	struct bitstream_queue ready;	// Slots holding an iteration ready to be unpacked and tested
+};
+
+extern void init_bitstream_pipeline(struct bitstream_pipeline *pipeline, long int slotCount, long int readers,
+				    long int testers, long int n);
+extern void destroy_bitstream_pipeline(struct bitstream_pipeline *pipeline);
+extern void put_bitstream_slot(struct bitstream_queue *queue, struct bitstream_slot *slot);
+extern struct bitstream_slot *get_bitstream_slot(struct bitstream_queue *queue);
+extern void close_bitstream_queue(struct bitstream_queue *queue);
+
+#endif				/* PIPELINE_H */
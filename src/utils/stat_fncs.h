@@ -66,6 +66,11 @@ extern void RandomExcursionsVariant_iterate(struct thread_state *thread_state);
 extern void LinearComplexity_iterate(struct thread_state *thread_state);
 extern void Serial_iterate(struct thread_state *thread_state);
 
+/*
+ * Flush functions, for tests that defer iterations
+ */
+extern void DiscreteFourierTransform_flush(struct thread_state *thread_state);
+
 /*
  * Print functions
  */
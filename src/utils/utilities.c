@@ -45,14 +45,24 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
+// for mmap() of randdata
+#include <sys/mman.h>
+
 // for stpncpy() and getline()
 #include <string.h>
 #include <stdio.h>
 
+// for isspace()
+#include <ctype.h>
+
 // sts includes
 #include "../utils/externs.h"
 #include "utilities.h"
 #include "debug.h"
+#include "bitstream.h"
+#include "pipeline.h"
+#include "ascii_index.h"
+#include "decompress.h"
 
 
 /*
@@ -63,8 +73,28 @@ static char * getString(FILE * stream);
 static bool checkReadPermissions(char *path);
 static void handleFileBasedBitStreams(struct state *state);
 static void *testBits(void *thread_args);
-static void parseBitsASCIIInput(struct thread_state *thread_state);
-static void parseBitsBinaryInput(struct thread_state *thread_state);
+static void *readBits(void *thread_args);
+static long int parseBitsASCII(struct state *state, struct ascii_cursor *cursor, BYTE *buf, long int bits);
+static long int readBitsASCII(struct thread_state *thread_state, BYTE *buf);
+static void freeASCIICursor(struct ascii_cursor *cursor);
+static long int readBytesStdio(struct thread_state *thread_state, BYTE *buf, int *bitOffset);
+static long int readBytesPread(struct thread_state *thread_state, BYTE *buf, int *bitOffset);
+static long int readIteration(struct thread_state *thread_state, BYTE *buf, int *bitOffset);
+static void convertBits(struct thread_state *thread_state, BYTE *buf, int bitOffset, long int bitCount);
+static bool mapRandomData(struct state *state);
+static void unmapRandomData(struct state *state);
+static void parseBitsMmapInput(struct thread_state *thread_state);
+static void writeBitsRead(struct thread_state *thread_state, long int bitsRead, long int num_0s, long int num_1s);
+static bool isRegularStream(FILE *stream);
+static bool claimIteration(struct thread_state *thread_state);
+
+
+#if !defined(__GNUC__) && !defined(__clang__)
+/*
+ * Serializes claimIteration(), finishIteration() and iterationsLeft() when atomic builtins are not available
+ */
+static pthread_mutex_t claim_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 
 /*
@@ -959,7 +989,9 @@ generatorOptions(struct state *state)
 				// Ask for input file format
 				printf("   Input File Format:\n");
 				printf("    [0] or [a] ASCII - A sequence of ASCII 0's and 1's\n");
-				printf("    [1] or [r] Raw binary - Each byte in data file contains 8 bits of data\n\n");
+				printf("    [1] or [r] Raw binary - Each byte in data file contains 8 bits of data\n");
+				printf("    [l] Raw binary - Least significant bit of each byte first\n");
+				printf("    [w] or [q] 32 or 64 bit little endian words - Most significant bit of each word first\n\n");
 				printf("   Select input mode:  ");
 				fflush(stdout);
 
@@ -979,12 +1011,16 @@ generatorOptions(struct state *state)
 					break;
 				case FORMAT_RAW_BINARY:
 				case FORMAT_ASCII_01:
+				case FORMAT_RAW_LSB:
+				case FORMAT_WORD32_LE:
+				case FORMAT_WORD64_LE:
 					format_success = true;
 					state->dataFormat = (enum format) line[0];
 					break;
 				default:
-					printf("\ninput must be %d of %c, %d or %c\n\n", 0, (char) FORMAT_ASCII_01, 1,
-					       (char) FORMAT_RAW_BINARY);
+					printf("\ninput must be %d of %c, %d or %c, %c, %c or %c\n\n", 0, (char) FORMAT_ASCII_01, 1,
+					       (char) FORMAT_RAW_BINARY, (char) FORMAT_RAW_LSB, (char) FORMAT_WORD32_LE,
+					       (char) FORMAT_WORD64_LE);
 					fflush(stdout);
 					break;
 				}
@@ -1184,6 +1220,12 @@ fixParameters(struct state *state)
 			printf("    [%d] Linear Complexity Test - block length(M):       %ld\n",
 			       PARAM_linearComplexitySequenceLength, state->tp.linearComplexitySequenceLength);
 		}
+		if (state->testVector[TEST_RANK] == true) {
+			printf("    [%d] Rank Test - rows per matrix(M):                 %ld\n",
+			       PARAM_rankRows, state->tp.rankRows);
+			printf("    [%d] Rank Test - columns per matrix(Q):              %ld\n",
+			       PARAM_rankCols, state->tp.rankCols);
+		}
 		printf("    [%d] bitstream iterations:				%ld\n", PARAM_numOfBitStreams,
 		       state->tp.numOfBitStreams);
 		printf("    [%d] Uniformity bins:				%ld\n", PARAM_uniformity_bins,
@@ -1420,6 +1462,42 @@ fixParameters(struct state *state)
 			} while (state->tp.alpha <= 0.0 || state->tp.alpha > 0.1);
 			break;
 
+		case PARAM_rankRows:
+			do {
+				// Ask for new value
+				printf("   Enter Rank Test rows per matrix (try: %d): ", DEFAULT_RANK_ROWS);
+				fflush(stdout);
+
+				// Read numeric answer
+				state->tp.rankRows = getNumber(stdin, stdout);
+				putchar('\n');
+
+				// Check error range
+				if (state->tp.rankRows < MIN_ROWS_RANK) {
+					printf("    Rows per matrix %ld must be >= %d, try again\n\n",
+					       state->tp.rankRows, MIN_ROWS_RANK);
+				}
+			} while (state->tp.rankRows < MIN_ROWS_RANK);
+			break;
+
+		case PARAM_rankCols:
+			do {
+				// Ask for new value
+				printf("   Enter Rank Test columns per matrix (try: %d): ", DEFAULT_RANK_COLS);
+				fflush(stdout);
+
+				// Read numeric answer
+				state->tp.rankCols = getNumber(stdin, stdout);
+				putchar('\n');
+
+				// Check error range
+				if (state->tp.rankCols < MIN_ROWS_RANK) {
+					printf("    Columns per matrix %ld must be >= %d, try again\n\n",
+					       state->tp.rankCols, MIN_ROWS_RANK);
+				}
+			} while (state->tp.rankCols < MIN_ROWS_RANK);
+			break;
+
 		default:
 			printf("   parameter number must be between 0 and %d, try again\n", MAX_PARAM);
 			fflush(stdout);
@@ -1481,10 +1559,12 @@ handleFileBasedBitStreams(struct state *state)
 {
 	int io_ret;		// I/O return status
 	long int i;
-	pthread_t thread[state->numberOfThreads];
+	pthread_t *thread;
 	pthread_attr_t attr;
 	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-	struct thread_state *thread_args = malloc(state->numberOfThreads * sizeof(struct thread_state));
+	struct thread_state *thread_args;
+	struct bitstream_pipeline pipeline;	// Slots and queues between reader and test threads
+	long int readers;	// Number of reader threads
 	void *status;
 
 	/*
@@ -1502,28 +1582,111 @@ handleFileBasedBitStreams(struct state *state)
 	}
 
 	/*
-	 * Compute seek position into the input file according to the jobnum parameter given.
+	 * Compute the bit of randdata where to start according to the jobnum parameter given.
 	 *
-	 * The position where to seek depends on the data format. If the input is made of
-	 * ASCII 0 and 1 characters then we can seek by counting 1 position as 1 bit.
+	 * The readers convert this bit into a file position: a byte and a bit within it for binary data,
+	 * a checkpoint of the ASCII index or, without one, one position per bit for ASCII data.
 	 */
-	else if (state->dataFormat == FORMAT_ASCII_01) {
+	else {
 		state->base_seek = state->jobnum * state->tp.n * state->tp.numOfBitStreams;
 	}
+	state->carryBits = 0;
+
+	/*
+	 * Decompress compressed randdata, from a file or from stdin, while it is tested, the readers then
+	 * read it in order as from stdin
+	 *
+	 * The decoder thread discards the data before the word that holds base_seek.  The readers start
+	 * within that word as they would start within a word carried over from the previous iteration.
+	 * Without an index, seeking into ASCII data assumes it holds no whitespace.
+	 */
+	{
+		int wordBytes = formatWordBytes(state->dataFormat);
+		int wordBits = wordBytes * BITS_N_BYTE;
+
+		if (state->dataFormat == FORMAT_ASCII_01 &&
+		    open_decompressor(state, state->base_seek) == true) {
+			if (state->asciiIndexFlag == true && state->stdinData == false) {
+				warn(__func__, "-x ignored, randdata read by the decoder thread has no ASCII index");
+			}
+		} else if (state->dataFormat != FORMAT_ASCII_01 &&
+			   open_decompressor(state, state->base_seek / wordBits * wordBytes) == true &&
+			   state->base_seek % wordBits != 0) {
+			if (fread(state->carryBytes, 1, (size_t) wordBytes, state->streamFile) != (size_t) wordBytes) {
+				err(224, __func__, "encounted EOF (end of file) while seeking %ld bits into file: %s",
+				    state->base_seek, state->randomDataPath);
+			}
+			state->carryBits = (int) (wordBits - state->base_seek % wordBits);
+		}
+	}
 
 	/*
-	 * If the input is made of binary data we need to get count that each position is 8 bits.
+	 * Load the ASCII index if requested
 	 */
-	else if (state->dataFormat == FORMAT_RAW_BINARY) {
+	if (state->asciiIndexFlag == true && state->dataFormat == FORMAT_ASCII_01 && state->stdinData == false &&
+	    state->decompressor == NULL) {
+		load_ascii_index(state);
+	}
 
-		/*
-		 * Get number of bytes that hold a given set of consecutive bits.
-		 *
-		 * We need to round up the byte count to the next whole byte.
-		 * However if the bit count is a multiple of 8, then we do not increase it.
-		 * We only increase by one in the case of a final partial byte.
-		 */
-		state->base_seek = ((state->jobnum * state->tp.n * state->tp.numOfBitStreams) + BITS_N_BYTE - 1) / BITS_N_BYTE;
+	/*
+	 * The pread and mmap readers need binary data from a regular file, otherwise use the stdio reader.
+	 * The mmap reader converts straight from the mapping, so it needs data in the -F r format.
+	 * The pread reader may also read ASCII data from a regular file when there is an ASCII index.
+	 * The default pread reader falls back silently, a reader given by -R reader with a warning.
+	 */
+	if (state->reader != READER_STDIO) {
+		if ((state->reader == READER_MMAP && state->dataFormat != FORMAT_RAW_BINARY) ||
+		    (state->dataFormat == FORMAT_ASCII_01 && state->asciiIndex == NULL) ||
+		    state->stdinData == true || isRegularStream(state->streamFile) == false) {
+			if (state->readerFlag == true) {
+				warn(__func__, "-R %c requires binary data, or ASCII data with -x, from an uncompressed regular file, "
+				     "will use -R s instead", (char) state->reader);
+			}
+			state->reader = READER_STDIO;
+		} else if (state->reader == READER_MMAP && mapRandomData(state) == false) {
+			state->reader = READER_STDIO;
+		}
+	}
+	dbg(DBG_MED, "will read randdata using the -R %c reader", (char) state->reader);
+
+	/*
+	 * Determine the number of reader threads
+	 *
+	 * By default, only the stdio reader, which reads one iteration at a time, uses a reader thread so that
+	 * reading overlaps with testing.  The mmap reader has nothing to read ahead.
+	 */
+	if (state->reader == READER_MMAP) {
+		if (state->readerThreadsFlag == true && state->readerThreads > 0) {
+			warn(__func__, "-r %ld ignored with -R m", state->readerThreads);
+		}
+		readers = 0;
+	} else if (state->readerThreadsFlag == true) {
+		readers = state->readerThreads;
+	} else {
+		readers = (state->reader == READER_STDIO) ? 1 : 0;
+	}
+	dbg(DBG_MED, "will use %ld reader threads", readers);
+
+	/*
+	 * Allocate the threads and their state
+	 */
+	thread = malloc((size_t) (state->numberOfThreads + readers) * sizeof(thread[0]));
+	if (thread == NULL) {
+		errp(224, __func__, "cannot malloc of %ld elements of %ld bytes each for thread",
+		     state->numberOfThreads + readers, sizeof(thread[0]));
+	}
+	thread_args = malloc((size_t) (state->numberOfThreads + readers) * sizeof(thread_args[0]));
+	if (thread_args == NULL) {
+		errp(224, __func__, "cannot malloc of %ld elements of %ld bytes each for thread_args",
+		     state->numberOfThreads + readers, sizeof(thread_args[0]));
+	}
+
+	/*
+	 * Each test thread can have one iteration read ahead for it while each reader reads another
+	 */
+	if (readers > 0) {
+		init_bitstream_pipeline(&pipeline, state->numberOfThreads + readers, readers, state->numberOfThreads,
+					state->tp.n);
 	}
 
 	/*
@@ -1535,14 +1698,26 @@ handleFileBasedBitStreams(struct state *state)
 	dbg(DBG_LOW, "Start of iterate phase");
 
 	/*
-	 * Run numberOfThreads threads
+	 * Run numberOfThreads test threads followed by the reader threads
 	 */
-	for (i = 0; i < state->numberOfThreads; i++) {
+	for (i = 0; i < state->numberOfThreads + readers; i++) {
 		thread_args[i].global_state = state;
-		thread_args[i].thread_id = i;
 		thread_args[i].mutex = &mutex;
-
-		io_ret = pthread_create(&thread[i], &attr, testBits, &thread_args[i]);
+		thread_args[i].pipeline = (readers > 0) ? &pipeline : NULL;
+		thread_args[i].asciiCursor.buf = NULL;
+		thread_args[i].asciiCursor.length = 0;
+		thread_args[i].asciiCursor.pos = 0;
+		thread_args[i].asciiCursor.offset = 0;
+		thread_args[i].asciiCursor.nextBit = -1;
+		thread_args[i].deferred = false;
+
+		if (i < state->numberOfThreads) {
+			thread_args[i].thread_id = i;
+			io_ret = pthread_create(&thread[i], &attr, testBits, &thread_args[i]);
+		} else {
+			thread_args[i].thread_id = i - state->numberOfThreads;
+			io_ret = pthread_create(&thread[i], &attr, readBits, &thread_args[i]);
+		}
 		if (io_ret != 0) {
 			errp(224, __func__, "error on pthread_create()");
 		}
@@ -1554,16 +1729,34 @@ handleFileBasedBitStreams(struct state *state)
 	 * Free attribute and wait for the threads to finish
 	 */
 	pthread_attr_destroy(&attr);
-	for (i = 0; i < state->numberOfThreads; i++) {
+	for (i = 0; i < state->numberOfThreads + readers; i++) {
 		io_ret = pthread_join(thread[i], &status);
 		if (io_ret != 0) {
 			errp(224, __func__, "error on pthread_join()");
 		}
 	}
 	pthread_mutex_destroy(&mutex);
+	if (readers > 0) {
+		destroy_bitstream_pipeline(&pipeline);
+	}
+	free(thread);
+	free(thread_args);
 
 	dbg(DBG_LOW, "End of iterate phase\n");
 
+	/*
+	 * Unmap randdata if it was mapped
+	 */
+	if (state->mapAddr != NULL) {
+		unmapRandomData(state);
+	}
+
+	/*
+	 * Free the ASCII cursor and index
+	 */
+	freeASCIICursor(&state->asciiCursor);
+	free_ascii_index(state);
+
 	/*
 	 * Close the input file
 	 */
@@ -1574,89 +1767,143 @@ handleFileBasedBitStreams(struct state *state)
 	}
 	state->streamFile = NULL;
 
+	/*
+	 * Stop decompressing randdata, the read end of its pipe is now closed
+	 */
+	close_decompressor(state);
+
 	return;
 }
 
 
-static void
-*testBits(void *thread_args)
+/*
+ * isRegularStream - determine if an open stream is a regular file
+ *
+ * given:
+ *      stream          // open FILE stream
+ *
+ * returns:
+ *      true ==> stream is a regular file that may be read with pread() or mmap()
+ *      false ==> stream is a pipe, device, etc. or fstat() failed
+ */
+static bool
+isRegularStream(FILE *stream)
 {
-	struct thread_state *thread_state = (struct thread_state *) thread_args;
-	char buf[BUFSIZ + 1];	// time string buffer
+	struct stat statbuf;	// Status of the open stream
 
-	/*
-	 * Check preconditions (firewall)
-	 */
-	if (thread_state == NULL) {
-		err(225, __func__, "thread_state arg is NULL");
-	}
-	struct state *state = thread_state->global_state;
-	if (state == NULL) {
-		err(225, __func__, "state arg is NULL");
+	if (stream == NULL || fstat(fileno(stream), &statbuf) != 0) {
+		return false;
 	}
+	return S_ISREG(statbuf.st_mode) ? true : false;
+}
 
-	dbg(DBG_HIGH, "Thread %ld started.", thread_state->thread_id);
-
-	while (1) {
-		pthread_mutex_lock(thread_state->mutex);
 
-		if (state->iterationsMissing == 0) {
-			pthread_mutex_unlock(thread_state->mutex);
-			break;
-		}
+/*
+ * claimIteration - claim the next iteration to be done by a thread
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *
+ * returns:
+ *      true ==> thread_state->iteration_being_done is the iteration claimed by this thread
+ *      false ==> all iterations have been claimed, the thread is done
+ *
+ * Iterations are claimed with an atomic decrement of state->iterationsMissing, so
+ * readers that do not share FILE state need no lock to claim their next iteration.
+ */
+static bool
+claimIteration(struct thread_state *thread_state)
+{
+	struct state *state = thread_state->global_state;
+	long int missing;	// Number of iterations missing before this claim
+
+#if defined(__GNUC__) || defined(__clang__)
+	missing = __atomic_fetch_sub(&state->iterationsMissing, 1, __ATOMIC_RELAXED);
+#else
+	pthread_mutex_lock(&claim_mutex);
+	missing = state->iterationsMissing--;
+	pthread_mutex_unlock(&claim_mutex);
+#endif
+	if (missing <= 0) {
+		return false;
+	}
+	thread_state->iteration_being_done = state->tp.numOfBitStreams - missing;
 
-		thread_state->iteration_being_done = state->tp.numOfBitStreams - state->iterationsMissing;
-		state->iterationsMissing -= 1;
+	return true;
+}
 
-		/*
-		 * Parse and data for this iteration
-		 */
-		if (state->dataFormat == FORMAT_ASCII_01) {
-			parseBitsASCIIInput(thread_state);
-		} else {
-			parseBitsBinaryInput(thread_state);
-		}
 
-		pthread_mutex_unlock(thread_state->mutex);
+/*
+ * finishIteration - count an iteration completed by a thread and report it (if requested)
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      iteration       // iteration whose results have all been recorded
+ *
+ * An iteration is completed once every test recorded its result.  A test that holds the result of
+ * an iteration for later, such as the DFT test with a batch of transforms, calls this when it does.
+ */
+void
+finishIteration(struct thread_state *thread_state, long int iteration)
+{
+	struct state *state = thread_state->global_state;
+	char buf[BUFSIZ + 1];	// time string buffer
 
-		/*
-		 * Perform one iteration on the bitstreams read from the streamFile
-		 */
-		iterate(thread_state);
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_fetch_add(&state->iterationsDone, 1, __ATOMIC_RELAXED);
+#else
+	pthread_mutex_lock(&claim_mutex);
+	state->iterationsDone++;
+	pthread_mutex_unlock(&claim_mutex);
+#endif
 
-		/*
-		 * Report iteration done (if requested)
-		 */
-		if (state->reportCycle > 0 && (((thread_state->iteration_being_done % state->reportCycle) == 0) ||
-					       (thread_state->iteration_being_done == state->tp.numOfBitStreams))) {
-			getTimestamp(buf, BUFSIZ);
-			msg("Completed iteration %ld of %ld at %s", thread_state->iteration_being_done + 1,
-			    state->tp.numOfBitStreams, buf);
-		}
+	/*
+	 * Report iteration done (if requested)
+	 */
+	if (state->reportCycle > 0 && (((iteration % state->reportCycle) == 0) ||
+				       (iteration == state->tp.numOfBitStreams))) {
+		getTimestamp(buf, BUFSIZ);
+		msg("Completed iteration %ld of %ld at %s", iteration + 1, state->tp.numOfBitStreams, buf);
 	}
-
-	pthread_exit((void *) thread_state->thread_id);
 }
 
 
 /*
- * parseBitsASCIIInput - read bits from the streamFile and save them into epsilon bit array
+ * iterationsLeft - number of iterations not completed yet
  *
  * given:
  *      state           // pointer to run state
  *
- * Given the open steam streamFile, from file state->randomDataPath, convert its ASCII characters
- * into 'bits' for the epsilon bit array.
+ * returns:
+ *      number of iterations that are being done, read ahead or not yet claimed
+ *
+ * Iterations being done count as left, so a thread calling this during an iteration gets at least 1.
  */
+long int
+iterationsLeft(struct state *state)
+{
+	long int done;		// Number of iterations completed
+
+#if defined(__GNUC__) || defined(__clang__)
+	done = __atomic_load_n(&state->iterationsDone, __ATOMIC_RELAXED);
+#else
+	pthread_mutex_lock(&claim_mutex);
+	done = state->iterationsDone;
+	pthread_mutex_unlock(&claim_mutex);
+#endif
+
+	return state->tp.numOfBitStreams - done;
+}
+
+
 static void
-parseBitsASCIIInput(struct thread_state *thread_state)
+*testBits(void *thread_args)
 {
-	long int i;
-	long int num_0s;
-	long int num_1s;
-	long int bitsRead;
-	int bit;
-	int io_ret;		// I/O return status
+	struct thread_state *thread_state = (struct thread_state *) thread_args;
+	BYTE *readBuf = NULL;	// Bytes of an iteration read by this thread
+	struct bitstream_slot *slot;	// Slot holding an iteration read by a reader thread
+	long int bitCount;	// Number of bits read for an iteration
+	int bitOffset;		// Bit of readBuf[0] where the iteration starts
 
 	/*
 	 * Check preconditions (firewall)
@@ -1668,181 +1915,888 @@ parseBitsASCIIInput(struct thread_state *thread_state)
 	if (state == NULL) {
 		err(225, __func__, "state arg is NULL");
 	}
-	if (state->streamFile == NULL) {
-		err(225, __func__, "streamFile arg is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(227, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
+
+	dbg(DBG_HIGH, "Thread %ld started.", thread_state->thread_id);
 
 	/*
-	 * If not reading randdata from stdin,
-	 * Seek to the position of the first bit which has not been copied into the stream yet
+	 * Allocate the buffer for reading iterations, unless reader threads or mmap() provide the data
 	 */
-	if (state->stdinData == false &&
-	    fseek(state->streamFile, state->base_seek + thread_state->iteration_being_done * state->tp.n, SEEK_SET) != 0) {
-		errp(226, __func__, "could not seek %ld further into file: %s",
-		     (thread_state->iteration_being_done * state->tp.n), state->randomDataPath);
+	if (thread_state->pipeline == NULL && state->reader != READER_MMAP) {
+		readBuf = malloc((size_t) ITERATION_BYTES(state->tp.n));
+		if (readBuf == NULL) {
+			errp(225, __func__, "cannot malloc read buffer of %ld bytes for thread %ld",
+			     ITERATION_BYTES(state->tp.n), thread_state->thread_id);
+		}
 	}
 
-	/*
-	 * Copy the next n bits from the streamFile to epsilon
-	 */
-	num_0s = 0;
-	num_1s = 0;
-	bitsRead = 0;
-	clearerr(state->streamFile);
-	for (i = 0; i < state->tp.n; i++) {
-		io_ret = fscanf(state->streamFile, "%1d", &bit);
-		if (io_ret == EOF) {
-			warn(__func__, "Insufficient data in file %s: %ld bits were read", state->randomDataPath,
-			     bitsRead);
-			return;
+	while (1) {
+
+		/*
+		 * Obtain and convert the data for this iteration
+		 *
+		 * With reader threads, take the next ready slot, convert it and give the slot back
+		 * to the readers before testing, so they can read ahead while this thread tests.
+		 *
+		 * Otherwise the stdio reader shares streamFile, and when reading from stdin the data must be read
+		 * in the order the iterations are claimed, so it claims and reads while holding the mutex.
+		 * The pread and mmap readers share no FILE state and do not lock.
+		 */
+		if (thread_state->pipeline != NULL) {
+			slot = get_bitstream_slot(&thread_state->pipeline->ready);
+			if (slot == NULL) {
+				break;
+			}
+			thread_state->iteration_being_done = slot->iteration;
+			bitCount = slot->bitCount;
+			convertBits(thread_state, slot->data, slot->bitOffset, bitCount);
+			put_bitstream_slot(&thread_state->pipeline->empty, slot);
+		} else if (state->reader == READER_MMAP) {
+			if (claimIteration(thread_state) == false) {
+				break;
+			}
+			parseBitsMmapInput(thread_state);
 		} else {
-			bitsRead++;
-			if (bit == 0) {
-				num_0s++;
-			} else {
-				num_1s++;
+			if (state->reader == READER_STDIO) {
+				pthread_mutex_lock(thread_state->mutex);
+			}
+			if (claimIteration(thread_state) == false) {
+				if (state->reader == READER_STDIO) {
+					pthread_mutex_unlock(thread_state->mutex);
+				}
+				break;
 			}
-			state->epsilon[thread_state->thread_id][i] = (BitSequence) bit;
+			bitCount = readIteration(thread_state, readBuf, &bitOffset);
+			if (state->reader == READER_STDIO) {
+				pthread_mutex_unlock(thread_state->mutex);
+			}
+			convertBits(thread_state, readBuf, bitOffset, bitCount);
+		}
+
+		/*
+		 * Perform one iteration on the bitstreams read from the streamFile
+		 */
+		thread_state->deferred = false;
+		iterate(thread_state);
+		if (thread_state->deferred == false) {
+			finishIteration(thread_state, thread_state->iteration_being_done);
 		}
 	}
 
 	/*
-	 * Write stats to freq.txt if in legacy_output mode
+	 * Finish the iterations that tests deferred, such as a partial batch of DFT test transforms
 	 */
-	if (state->legacy_output == true) {
-		io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", bitsRead, num_0s, num_1s);
-		if (io_ret <= 0) {
-			errp(225, __func__, "error in writing to %s", state->freqFilePath);
-		}
-		io_ret = fflush(state->freqFile);
-		if (io_ret != 0) {
-			errp(225, __func__, "error flushing to %s", state->freqFilePath);
-		}
+	flush(thread_state);
+
+	if (readBuf != NULL) {
+		free(readBuf);
+	}
+	if (thread_state->pipeline != NULL) {
+		close_bitstream_queue(&thread_state->pipeline->empty);
 	}
+	freeASCIICursor(&thread_state->asciiCursor);
 
-	return;
+	pthread_exit((void *) thread_state->thread_id);
 }
 
 
 /*
- * parseBitsBinaryInput - read bits from the streamFile and convert them into epsilon bit array
+ * readBits - reader thread that reads iterations into the slots of the pipeline
  *
  * given:
- *      state           // pointer to run state
+ *      thread_args     // pointer to the thread state of this reader thread
  *
- * Given the open steam streamFile, from file state->randomDataPath, convert its bytes into 'bits'
- * found in the epsilon bit array.
+ * Each reader takes an empty slot, waiting for the test threads to return one when none is
+ * empty, claims the next iteration, reads its data into the slot and queues the slot as ready.
  */
 static void
-parseBitsBinaryInput(struct thread_state *thread_state)
+*readBits(void *thread_args)
 {
-	long int num_0s;	// Count of 0 bits processed
-	long int num_1s;	// Count of 1 bits processed
-	long int bitsRead;	// Number of bits to read and process
-	bool done;		// true ==> we have converted enough data
-	BYTE byte;		// single bite
-	int io_ret;		// I/O return status
+	struct thread_state *thread_state = (struct thread_state *) thread_args;
+	struct bitstream_slot *slot;	// Slot to read an iteration into
 
 	/*
 	 * Check preconditions (firewall)
 	 */
 	if (thread_state == NULL) {
-		err(225, __func__, "thread_state arg is NULL");
+		err(233, __func__, "thread_state arg is NULL");
 	}
 	struct state *state = thread_state->global_state;
 	if (state == NULL) {
-		err(226, __func__, "state arg is NULL");
+		err(233, __func__, "state arg is NULL");
 	}
-	if (state->streamFile == NULL) {
-		err(226, __func__, "streamFile arg is NULL");
+	if (thread_state->pipeline == NULL) {
+		err(233, __func__, "thread_state->pipeline is NULL");
 	}
 
-	/*
-	 * If not reading randdata from stdin,
-	 * Seek to the position of the first bit which has not been copied into the stream yet
-	 */
-	if (state->stdinData == false &&
-	    fseek(state->streamFile, state->base_seek + thread_state->iteration_being_done * state->tp.n /
-							BITS_N_BYTE, SEEK_SET) != 0) {
-
-		errp(226, __func__, "could not seek %ld further into file: %s",
-		     thread_state->iteration_being_done * state->tp.n / BITS_N_BYTE, state->randomDataPath);
-	}
+	dbg(DBG_HIGH, "Reader thread %ld started.", thread_state->thread_id);
 
-	/*
-	 * Copy the next n bits from the streamFile to epsilon
-	 */
-	num_0s = 0;
-	num_1s = 0;
-	bitsRead = 0;
-	clearerr(state->streamFile);
-	do {
-		/*
-		 * Read the next binary octet
-		 */
-		io_ret = fgetc(state->streamFile);
-		if (ferror(state->streamFile)) {
-			errp(226, __func__, "read error while reading file: %s", state->randomDataPath);
-		} else if (feof(state->streamFile) || io_ret == EOF) {
-			err(226, __func__, "encounted EOF (end of file) while reading file: %s: %ld bits were read before EOF",
-			    state->randomDataPath, bitsRead);
-		} else if (io_ret < 0) {
-			errp(226, __func__, "unexpected fgetc return while reading file: %s", state->randomDataPath);
+	while (1) {
+		slot = get_bitstream_slot(&thread_state->pipeline->empty);
+		if (slot == NULL) {
+			break;
 		}
-		byte = (BYTE) io_ret;
 
 		/*
-		 * Add bits of the octet to the epsilon bit stream
+		 * Claim and read the next iteration, see testBits() on locking
 		 */
-		done = copyBitsToEpsilon(state, thread_state->thread_id, &byte, BITS_N_BYTE, &num_0s, &num_1s, &bitsRead);
-	} while (done == false);
-
-	/*
-	 * Write stats to freq.txt if in legacy_output mode
-	 */
-	if (state->legacy_output == true) {
-		io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", bitsRead, num_0s, num_1s);
-		if (io_ret <= 0) {
-			errp(226, __func__, "error in writing to %s", state->freqFilePath);
+		if (state->reader == READER_STDIO) {
+			pthread_mutex_lock(thread_state->mutex);
 		}
-		io_ret = fflush(state->freqFile);
-		if (io_ret != 0) {
-			errp(226, __func__, "error flushing to %s", state->freqFilePath);
+		if (claimIteration(thread_state) == false) {
+			if (state->reader == READER_STDIO) {
+				pthread_mutex_unlock(thread_state->mutex);
+			}
+			put_bitstream_slot(&thread_state->pipeline->empty, slot);
+			break;
+		}
+		slot->iteration = thread_state->iteration_being_done;
+		slot->bitCount = readIteration(thread_state, slot->data, &slot->bitOffset);
+		if (state->reader == READER_STDIO) {
+			pthread_mutex_unlock(thread_state->mutex);
 		}
+
+		put_bitstream_slot(&thread_state->pipeline->ready, slot);
 	}
 
-	return;
+	close_bitstream_queue(&thread_state->pipeline->ready);
+	freeASCIICursor(&thread_state->asciiCursor);
+
+	pthread_exit((void *) thread_state->thread_id);
 }
 
 
 /*
- * copyBitsToEpsilon - convert binary bytes into the end of an epsilon bit array
+ * appendByteBits - store 8 bits at any bit position of a buffer that is filled in order
  *
  * given:
- *      state           // pointer to run state
- *      x               // pointer to an array (even just 1) binary bytes
- *      xBitLength      // Number of bits to convert
- *      bitsNeeded      // Total number of bits we want to convert this run
- *      num_0s          // pointer to number of 0 bits converted so far
- *      num_1s          // pointer to number of 1 bits converted so far
- *      bitsRead        // pointer to number of bits converted so far
- *
- * returns:
- *      true ==> we have converted enough bits
- *      false ==> we have NOT converted enough bits, yet
+ *      buf             // buffer holding bits 8 per byte, most significant bit first
+ *      pos             // index of the first bit to store, all bits before pos have been stored already
+ *      byte            // the 8 bits to store, the first one being the most significant bit
  */
-bool
-copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, long int xBitLength, long int *num_0s, long int *num_1s,
-		  long int *bitsRead)
+static inline void
+appendByteBits(BYTE *buf, long int pos, BYTE byte)
 {
-	long int i;
-	long int j;
-	long int count;
+	int shift = (int) (pos % BITS_N_BYTE);
+
+	if (shift == 0) {
+		buf[pos / BITS_N_BYTE] = byte;
+	} else {
+		buf[pos / BITS_N_BYTE] |= (BYTE) (byte >> shift);
+		buf[pos / BITS_N_BYTE + 1] = (BYTE) (byte << (BITS_N_BYTE - shift));
+	}
+}
+
+
+/*
+ * parseBitsASCII - parse ASCII '0'/'1' characters at a cursor into bits
+ *
+ * given:
+ *      state           // pointer to run state
+ *      cursor          // cursor into ASCII randdata
+ *      buf             // NULL or buffer of at least (bits + 7) / 8 bytes
+ *      bits            // number of bits to parse
+ *
+ * returns:
+ *      Number of bits parsed, less than bits if the end of randdata was reached
+ *
+ * The bits are stored in buf 8 per byte, most significant bit first, as in raw binary randdata.
+ * When buf is NULL, the bits are parsed and discarded.  Whitespace, such as newlines, between the
+ * '0' and '1' characters is skipped.
+ *
+ * ASCII randdata is read ASCII_CHUNK_SIZE bytes at a time into the cursor, with fread() from the
+ * shared streamFile when using the stdio reader, else with pread() at the cursor offset.  Characters
+ * read beyond the parsed bits stay in the cursor for the next call, which matters when reading
+ * from stdin.  Runs of 8 '0'/'1' characters are checked and converted into a byte with a few
+ * 64-bit operations, any other character is handled one at a time.
+ */
+static long int
+parseBitsASCII(struct state *state, struct ascii_cursor *cursor, BYTE *buf, long int bits)
+{
+	long int bitsRead;	// Number of bits parsed
+	long int pos;		// Index of the next unparsed byte in the cursor
+	long int len;		// Number of bytes held in the cursor
+	const unsigned char *c;	// Next unparsed character
+	WORD64 v;		// 8 characters, the first one in the least significant byte
+	ssize_t io_ret;		// I/O return status
+	int ch;
+
+	bitsRead = 0;
+	pos = cursor->pos;
+	len = cursor->length;
+	while (bitsRead < bits) {
+
+		/*
+		 * Read the next chunk when all read ahead characters have been parsed
+		 */
+		if (pos >= len) {
+			if (state->reader == READER_PREAD) {
+				do {
+					io_ret = pread(fileno(state->streamFile), cursor->buf, ASCII_CHUNK_SIZE, (off_t) cursor->offset);
+				} while (io_ret < 0 && errno == EINTR);
+				if (io_ret < 0) {
+					errp(225, __func__, "read error while reading file: %s", state->randomDataPath);
+				}
+				cursor->offset += (long int) io_ret;
+			} else {
+				clearerr(state->streamFile);
+				io_ret = (ssize_t) fread(cursor->buf, 1, ASCII_CHUNK_SIZE, state->streamFile);
+				if (io_ret == 0 && ferror(state->streamFile)) {
+					errp(225, __func__, "read error while reading file: %s", state->randomDataPath);
+				}
+			}
+			pos = 0;
+			len = (long int) io_ret;
+			if (len == 0) {
+				warn(__func__, "Insufficient data in file %s: %ld bits were read", state->randomDataPath,
+				     bitsRead);
+				break;
+			}
+		}
+		c = (const unsigned char *) cursor->buf + pos;
+
+		/*
+		 * Convert runs of 8 '0'/'1' characters at a time
+		 *
+		 * Each character is '0' (0x30) or '1' (0x31) when it equals 0x30 once its low bit is ignored.
+		 * The low bits of the 8 characters are then gathered into the top byte with one multiply.
+		 */
+		while (len - pos >= BITS_N_BYTE && bits - bitsRead >= BITS_N_BYTE) {
+			v = (WORD64) c[0] | ((WORD64) c[1] << 8) | ((WORD64) c[2] << 16) | ((WORD64) c[3] << 24) |
+			    ((WORD64) c[4] << 32) | ((WORD64) c[5] << 40) | ((WORD64) c[6] << 48) | ((WORD64) c[7] << 56);
+			if ((v & 0xfefefefefefefefeULL) != 0x3030303030303030ULL) {
+				break;
+			}
+			if (buf != NULL) {
+				appendByteBits(buf, bitsRead, (BYTE) (((v & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56));
+			}
+			bitsRead += BITS_N_BYTE;
+			pos += BITS_N_BYTE;
+			c += BITS_N_BYTE;
+		}
+
+		/*
+		 * Handle one character that did not fit a run of 8
+		 */
+		if (pos < len && bitsRead < bits) {
+			ch = *c;
+			pos++;
+			if (ch == '0' || ch == '1') {
+				if (buf != NULL) {
+					if (bitsRead % BITS_N_BYTE == 0) {
+						buf[bitsRead / BITS_N_BYTE] = 0;
+					}
+					buf[bitsRead / BITS_N_BYTE] |= (BYTE) ((ch - '0') << (BITS_N_BYTE - 1 - bitsRead % BITS_N_BYTE));
+				}
+				bitsRead++;
+			} else if (!isspace(ch)) {
+				err(225, __func__, "character 0x%02x found in file %s after %ld bits were read: ASCII data must be 0 or 1",
+				    ch, state->randomDataPath, bitsRead);
+			}
+		}
+	}
+	cursor->pos = pos;
+	cursor->length = len;
+
+	return bitsRead;
+}
+
+
+/*
+ * readBitsASCII - read the ASCII '0'/'1' characters of an iteration
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      buf             // buffer of at least (n + 7) / 8 bytes
+ *
+ * returns:
+ *      Number of bits read into buf, less than n if the end of randdata was reached
+ *
+ * The stdio reader uses the cursor in state shared by all threads, and the caller must hold the mutex.
+ * The pread reader, only used with an ASCII index, uses the cursor of this thread and needs no lock.
+ *
+ * Unless reading from stdin, the cursor is moved to the first bit of this iteration when it is not
+ * already there.  With an ASCII index this is a seek to the checkpoint before the bit followed by
+ * parsing up to the bit, otherwise the data is assumed to hold no whitespace.
+ */
+static long int
+readBitsASCII(struct thread_state *thread_state, BYTE *buf)
+{
+	struct ascii_cursor *cursor;	// Cursor into ASCII randdata
+	long int bit;		// randdata bit number of the first bit of this iteration
+	long int offset;	// File offset to seek to
+	long int skip;		// Number of bits to parse from offset to reach bit
+	long int bitsRead;	// Number of bits read into buf
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(225, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(225, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(225, __func__, "streamFile arg is NULL");
+	}
+	if (buf == NULL) {
+		err(225, __func__, "buf arg is NULL");
+	}
+	cursor = (state->reader == READER_PREAD) ? &thread_state->asciiCursor : &state->asciiCursor;
+
+	/*
+	 * Allocate the read ahead buffer on first use
+	 */
+	if (cursor->buf == NULL) {
+		cursor->buf = malloc(ASCII_CHUNK_SIZE);
+		if (cursor->buf == NULL) {
+			errp(225, __func__, "cannot malloc of %d bytes for ASCII cursor", ASCII_CHUNK_SIZE);
+		}
+		cursor->length = 0;
+		cursor->pos = 0;
+		cursor->nextBit = -1;
+	}
+
+	/*
+	 * If not reading randdata in order, from stdin or from its decoder thread,
+	 * Move the cursor to the first bit of this iteration, discarding what was read ahead
+	 *
+	 * For ASCII data base_seek is a number of bits, which without an index is also the file offset.
+	 */
+	bit = state->base_seek + thread_state->iteration_being_done * state->tp.n;
+	if (state->stdinData == false && state->decompressor == NULL && cursor->nextBit != bit) {
+		if (state->asciiIndex != NULL) {
+			offset = ascii_index_seek(state->asciiIndex, bit, &skip);
+		} else {
+			offset = bit;
+			skip = 0;
+		}
+		if (state->reader == READER_PREAD) {
+			cursor->offset = offset;
+		} else if (fseek(state->streamFile, offset, SEEK_SET) != 0) {
+			errp(226, __func__, "could not seek %ld further into file: %s", offset, state->randomDataPath);
+		}
+		cursor->length = 0;
+		cursor->pos = 0;
+		cursor->nextBit = -1;
+		if (skip > 0 && parseBitsASCII(state, cursor, NULL, skip) < skip) {
+			return 0;
+		}
+	}
+
+	/*
+	 * Parse the next n bits into buf
+	 */
+	bitsRead = parseBitsASCII(state, cursor, buf, state->tp.n);
+	cursor->nextBit = bit + bitsRead;
+
+	return bitsRead;
+}
+
+
+/*
+ * freeASCIICursor - free the read ahead buffer of an ASCII cursor
+ *
+ * given:
+ *      cursor          // cursor into ASCII randdata
+ */
+static void
+freeASCIICursor(struct ascii_cursor *cursor)
+{
+	if (cursor->buf != NULL) {
+		free(cursor->buf);
+		cursor->buf = NULL;
+	}
+	cursor->length = 0;
+	cursor->pos = 0;
+	cursor->nextBit = -1;
+
+	return;
+}
+
+
+/*
+ * readBytesStdio - read the raw binary bytes of an iteration from the streamFile
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      buf             // buffer of at least ITERATION_BYTES(n) bytes
+ *      bitOffset       // where to store the bit of buf[0] where the iteration starts
+ *
+ * returns:
+ *      Number of bits read into buf, i.e., n
+ *
+ * An iteration starts at bit base_seek + iteration * n, which need not be the first bit of a word,
+ * where a word is a byte or, for a -F word format, formatWordBytes() bytes.  Whole words are read.
+ * When reading from stdin or compressed randdata, the iterations are read in order and the last
+ * word of an iteration that ends within a word is kept in carryBytes, as the next iteration starts
+ * with its remaining bits.
+ *
+ * The caller must hold the mutex as the streamFile is shared.
+ */
+static long int
+readBytesStdio(struct thread_state *thread_state, BYTE *buf, int *bitOffset)
+{
+	long int bit;		// randdata bit number of the first bit of this iteration
+	size_t length;		// Number of bytes that hold the bits of an iteration
+	size_t done;		// Number of bytes already in buf
+	int shift;		// Bit of buf[0] where the iteration starts
+	int wordBytes;		// Number of bytes in a word of the randdata format
+	int wordBits;		// Number of bits in a word of the randdata format
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(226, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(226, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(226, __func__, "streamFile arg is NULL");
+	}
+	if (buf == NULL || bitOffset == NULL) {
+		err(226, __func__, "buf or bitOffset arg is NULL");
+	}
+
+	/*
+	 * If not reading randdata in order, from stdin or from its decoder thread,
+	 * Seek to the word holding the first bit which has not been copied into the stream yet,
+	 * otherwise start with the untested bits of the last word read, if any
+	 */
+	wordBytes = formatWordBytes(state->dataFormat);
+	wordBits = wordBytes * BITS_N_BYTE;
+	bit = state->base_seek + thread_state->iteration_being_done * state->tp.n;
+	done = 0;
+	if (state->stdinData == false && state->decompressor == NULL) {
+		shift = (int) (bit % wordBits);
+		if (fseek(state->streamFile, bit / wordBits * wordBytes, SEEK_SET) != 0) {
+			errp(226, __func__, "could not seek %ld further into file: %s", bit / wordBits * wordBytes,
+			     state->randomDataPath);
+		}
+	} else if (state->carryBits > 0) {
+		shift = wordBits - state->carryBits;
+		memcpy(buf, state->carryBytes, (size_t) wordBytes);
+		done = (size_t) wordBytes;
+	} else {
+		shift = 0;
+	}
+
+	/*
+	 * Read the words that hold the next n bits
+	 */
+	length = (size_t) ((shift + state->tp.n + wordBits - 1) / wordBits * wordBytes);
+	clearerr(state->streamFile);
+	done += fread(buf + done, 1, length - done, state->streamFile);
+	if (done != length) {
+		if (ferror(state->streamFile)) {
+			errp(226, __func__, "read error while reading file: %s", state->randomDataPath);
+		}
+		err(226, __func__, "encounted EOF (end of file) while reading file: %s: %ld bits were read before EOF",
+		    state->randomDataPath, MAX((long int) done * BITS_N_BYTE - shift, 0));
+	}
+
+	/*
+	 * Keep the last word when the next iteration read in order starts within it
+	 */
+	if (state->stdinData == true || state->decompressor != NULL) {
+		state->carryBits = (int) ((wordBits - (shift + state->tp.n) % wordBits) % wordBits);
+		memcpy(state->carryBytes, buf + length - wordBytes, (size_t) wordBytes);
+	}
+	*bitOffset = shift;
+
+	return state->tp.n;
+}
+
+
+/*
+ * readBytesPread - read the raw binary bytes of an iteration with pread()
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      buf             // buffer of at least ITERATION_BYTES(n) bytes
+ *      bitOffset       // where to store the bit of buf[0] where the iteration starts
+ *
+ * returns:
+ *      Number of bits read into buf, i.e., n
+ *
+ * The whole words that hold bits base_seek + iteration * n thru base_seek + (iteration + 1) * n - 1
+ * of the randdata file are read, see readBytesStdio().  No FILE state is shared with other threads, so this function
+ * is called without holding the mutex.
+ */
+static long int
+readBytesPread(struct thread_state *thread_state, BYTE *buf, int *bitOffset)
+{
+	long int bit;		// randdata bit number of the first bit of this iteration
+	off_t offset;		// Offset of this iteration in randdata
+	size_t length;		// Number of bytes that hold the bits of an iteration
+	size_t done;		// Number of bytes read so far
+	ssize_t ret;		// pread() return value
+	int fd;			// File descriptor of streamFile
+	int wordBytes;		// Number of bytes in a word of the randdata format
+	int wordBits;		// Number of bits in a word of the randdata format
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(231, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(231, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(231, __func__, "streamFile arg is NULL");
+	}
+	if (buf == NULL || bitOffset == NULL) {
+		err(231, __func__, "buf or bitOffset arg is NULL");
+	}
+
+	/*
+	 * Read all the bytes of this iteration, pread() may return less than asked for
+	 */
+	fd = fileno(state->streamFile);
+	wordBytes = formatWordBytes(state->dataFormat);
+	wordBits = wordBytes * BITS_N_BYTE;
+	bit = state->base_seek + thread_state->iteration_being_done * state->tp.n;
+	*bitOffset = (int) (bit % wordBits);
+	offset = (off_t) (bit / wordBits * wordBytes);
+	length = (size_t) ((*bitOffset + state->tp.n + wordBits - 1) / wordBits * wordBytes);
+	for (done = 0; done < length; done += (size_t) ret) {
+		ret = pread(fd, buf + done, length - done, offset + (off_t) done);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				ret = 0;
+				continue;
+			}
+			errp(231, __func__, "read error while reading file: %s", state->randomDataPath);
+		} else if (ret == 0) {
+			err(231, __func__, "encounted EOF (end of file) while reading file: %s: %ld bits were read before EOF",
+			    state->randomDataPath, MAX((long int) done * BITS_N_BYTE - *bitOffset, 0));
+		}
+	}
+
+	return state->tp.n;
+}
+
+
+/*
+ * readIteration - read the data of the iteration claimed by a thread
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      buf             // buffer of at least ITERATION_BYTES(n) bytes
+ *      bitOffset       // where to store the bit of buf[0] where the iteration starts
+ *
+ * returns:
+ *      Number of bits read into buf
+ *
+ * With the stdio reader, the caller must hold the mutex.
+ */
+static long int
+readIteration(struct thread_state *thread_state, BYTE *buf, int *bitOffset)
+{
+	struct state *state = thread_state->global_state;
+
+	if (state->dataFormat == FORMAT_ASCII_01) {
+		*bitOffset = 0;
+		return readBitsASCII(thread_state, buf);
+	} else if (state->reader == READER_PREAD) {
+		return readBytesPread(thread_state, buf, bitOffset);
+	}
+	return readBytesStdio(thread_state, buf, bitOffset);
+}
+
+
+/*
+ * convertBits - convert the data of an iteration into the epsilon bit array of a thread
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      buf             // bits of the iteration, 8 per byte, in the -F format of randdata
+ *      bitOffset       // bit of buf where the iteration starts
+ *      bitCount        // number of bits of the iteration in buf
+ *
+ * Binary data of a format other than -F r is first reordered in place into stream order,
+ * most significant bit of each byte first.
+ *
+ * The caller must not hold the mutex.
+ */
+static void
+convertBits(struct thread_state *thread_state, BYTE *buf, int bitOffset, long int bitCount)
+{
+	struct state *state = thread_state->global_state;
+	long int num_0s;	// Count of 0 bits processed
+	long int num_1s;	// Count of 1 bits processed
+	long int bitsRead;	// Number of bits processed
+
+	if (state->dataFormat != FORMAT_ASCII_01 && state->dataFormat != FORMAT_RAW_BINARY) {
+		int wordBits = formatWordBytes(state->dataFormat) * BITS_N_BYTE;
+
+		reorderBytes(buf, (bitOffset + bitCount + wordBits - 1) / wordBits * (wordBits / BITS_N_BYTE),
+			     state->dataFormat);
+	}
+	buf += bitOffset / BITS_N_BYTE;
+	bitOffset %= BITS_N_BYTE;
+
+	num_0s = 0;
+	num_1s = 0;
+	bitsRead = 0;
+	(void) copyBitsToEpsilon(state, thread_state->thread_id, buf, bitOffset, bitCount, &num_0s, &num_1s, &bitsRead);
+
+	/*
+	 * Write stats to freq.txt if in legacy_output mode
+	 */
+	if (state->legacy_output == true && bitCount == state->tp.n) {
+		writeBitsRead(thread_state, bitsRead, num_0s, num_1s);
+	}
+
+	return;
+}
+
+
+/*
+ * mapRandomData - mmap() randdata from the position of the first bit to test to its end
+ *
+ * given:
+ *      state           // pointer to run state
+ *
+ * returns:
+ *      true ==> randdata was mapped, state->mapData points to the data at base_seek
+ *      false ==> randdata cannot be mapped, it must be read using the streamFile instead
+ *
+ * The mapping starts at base_seek rounded down to a page boundary.  When the file holds no
+ * data beyond base_seek nothing is mapped and each iteration will report the missing data.
+ */
+static bool
+mapRandomData(struct state *state)
+{
+	struct stat statbuf;	// Status of the open randdata file
+	long int page_size;	// Size of a page of memory, mmap() offsets must be a multiple of it
+	off_t offset;		// File offset of the start of the mapping
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(230, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(230, __func__, "streamFile arg is NULL");
+	}
+
+	/*
+	 * Determine the size of randdata
+	 */
+	if (fstat(fileno(state->streamFile), &statbuf) != 0) {
+		errp(230, __func__, "cannot fstat: %s", state->randomDataPath);
+	}
+
+	/*
+	 * Nothing to map if there is no data after base_seek
+	 */
+	state->mapAddr = NULL;
+	state->mapLength = 0;
+	state->mapData = NULL;
+	state->mapDataLength = 0;
+	if (statbuf.st_size <= state->base_seek / BITS_N_BYTE) {
+		dbg(DBG_MED, "no data in %s after byte %ld, nothing to mmap", state->randomDataPath,
+		    state->base_seek / BITS_N_BYTE);
+		return true;
+	}
+
+	/*
+	 * Map the rest of the file starting at the page that holds base_seek
+	 */
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0) {
+		errp(230, __func__, "cannot determine the page size");
+	}
+	offset = (off_t) ((state->base_seek / BITS_N_BYTE / page_size) * page_size);
+	state->mapLength = (size_t) (statbuf.st_size - offset);
+	state->mapAddr = mmap(NULL, state->mapLength, PROT_READ, MAP_PRIVATE, fileno(state->streamFile), offset);
+	if (state->mapAddr == MAP_FAILED) {
+		warnp(__func__, "cannot mmap %lu bytes of %s, will use -R s instead", state->mapLength, state->randomDataPath);
+		state->mapAddr = NULL;
+		state->mapLength = 0;
+		return false;
+	}
+	if (madvise(state->mapAddr, state->mapLength, MADV_SEQUENTIAL) != 0) {
+		dbg(DBG_MED, "madvise MADV_SEQUENTIAL failed for the mmap of %s", state->randomDataPath);
+	}
+	state->mapData = (BYTE *) state->mapAddr + (state->base_seek / BITS_N_BYTE - offset);
+	state->mapDataLength = (long int) (statbuf.st_size - state->base_seek / BITS_N_BYTE);
+	dbg(DBG_MED, "mapped %ld bytes of %s starting at byte %ld", state->mapDataLength, state->randomDataPath,
+	    state->base_seek / BITS_N_BYTE);
+
+	return true;
+}
+
+
+/*
+ * unmapRandomData - undo the mmap() of randdata done by mapRandomData()
+ *
+ * given:
+ *      state           // pointer to run state
+ */
+static void
+unmapRandomData(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(230, __func__, "state arg is NULL");
+	}
+
+	/*
+	 * Remove the mapping
+	 */
+	if (state->mapAddr != NULL && munmap(state->mapAddr, state->mapLength) != 0) {
+		errp(230, __func__, "cannot munmap %s", state->randomDataPath);
+	}
+	state->mapAddr = NULL;
+	state->mapLength = 0;
+	state->mapData = NULL;
+	state->mapDataLength = 0;
+
+	return;
+}
+
+
+/*
+ * parseBitsMmapInput - convert the bits of an iteration from the mapped randdata into epsilon bit array
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *
+ * Unlike readBytesStdio(), this function does not use the shared streamFile,
+ * so it is called without holding the mutex.
+ */
+static void
+parseBitsMmapInput(struct thread_state *thread_state)
+{
+	long int num_0s;	// Count of 0 bits processed
+	long int num_1s;	// Count of 1 bits processed
+	long int bitsRead;	// Number of bits to read and process
+	long int bit;		// Bit of this iteration counted from the first mapped bit
+	long int offset;	// Offset of this iteration in the mapped randdata
+	long int length;	// Number of bytes that hold the bits of an iteration
+	int shift;		// Bit of the byte at offset where the iteration starts
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(231, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(231, __func__, "state arg is NULL");
+	}
+
+	/*
+	 * Locate the bytes of this iteration in the mapped randdata
+	 */
+	bit = state->base_seek % BITS_N_BYTE + thread_state->iteration_being_done * state->tp.n;
+	offset = bit / BITS_N_BYTE;
+	shift = (int) (bit % BITS_N_BYTE);
+	length = (shift + state->tp.n + BITS_N_BYTE - 1) / BITS_N_BYTE;
+	if (offset + length > state->mapDataLength) {
+		err(231, __func__, "encounted EOF (end of file) while reading file: %s: %ld bits were read before EOF",
+		    state->randomDataPath, MAX((state->mapDataLength - offset) * BITS_N_BYTE - shift, 0));
+	}
+
+	/*
+	 * Convert the bits of this iteration to epsilon
+	 */
+	num_0s = 0;
+	num_1s = 0;
+	bitsRead = 0;
+	(void) copyBitsToEpsilon(state, thread_state->thread_id, state->mapData + offset, shift, state->tp.n, &num_0s,
+				 &num_1s, &bitsRead);
+
+	/*
+	 * Write stats to freq.txt if in legacy_output mode
+	 */
+	if (state->legacy_output == true) {
+		writeBitsRead(thread_state, bitsRead, num_0s, num_1s);
+	}
+
+	return;
+}
+
+
+/*
+ * writeBitsRead - write the count of bits of an iteration to freq.txt under the mutex
+ *
+ * given:
+ *      thread_state    // pointer to thread state
+ *      bitsRead        // number of bits converted
+ *      num_0s          // number of 0 bits converted
+ *      num_1s          // number of 1 bits converted
+ *
+ * This is used by readers that do not hold the mutex while they convert an iteration.
+ */
+static void
+writeBitsRead(struct thread_state *thread_state, long int bitsRead, long int num_0s, long int num_1s)
+{
+	struct state *state = thread_state->global_state;
+	int io_ret;		// I/O return status
+
+	if (thread_state->mutex != NULL) {
+		pthread_mutex_lock(thread_state->mutex);
+	}
+	io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", bitsRead, num_0s, num_1s);
+	if (io_ret <= 0) {
+		errp(231, __func__, "error in writing to %s", state->freqFilePath);
+	}
+	io_ret = fflush(state->freqFile);
+	if (io_ret != 0) {
+		errp(231, __func__, "error flushing to %s", state->freqFilePath);
+	}
+	if (thread_state->mutex != NULL) {
+		pthread_mutex_unlock(thread_state->mutex);
+	}
+
+	return;
+}
+
+
+/*
+ * copyBitsToEpsilon - convert binary bytes into the end of the packed epsilon bit array
+ *
+ * given:
+ *      state           // pointer to run state
+ *      x               // pointer to an array (even just 1) binary bytes
+ *      xBitOffset      // Bit of x[0] where the bits to convert start, 0 thru 7 from its most significant bit
+ *      xBitLength      // Number of bits to convert
+ *      bitsNeeded      // Total number of bits we want to convert this run
+ *      num_0s          // pointer to number of 0 bits converted so far
+ *      num_1s          // pointer to number of 1 bits converted so far
+ *      bitsRead        // pointer to number of bits converted so far
+ *
+ * returns:
+ *      true ==> we have converted enough bits
+ *      false ==> we have NOT converted enough bits, yet
+ *
+ * NOTE: If -B was given, the bits are also stored one byte per bit into the epsilon bit array.
+ * NOTE: Bits beyond bitsNeeded are neither converted nor counted.
+ */
+bool
+copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, int xBitOffset, long int xBitLength, long int *num_0s,
+		  long int *num_1s, long int *bitsRead)
+{
+	long int i;
+	long int count;		// Number of bits of x to convert
+	long int done;		// Number of bits of x converted so far
+	long int words;		// Number of whole words converted at once
+	long int ones;		// Number of 1 bits in the whole words
 	int bit;
-	BYTE mask;
 	long int bitsNeeded;
 
 	/*
@@ -1851,36 +2805,57 @@ copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, long int xBi
 	if (state == NULL) {
 		err(227, __func__, "state arg is NULL");
 	}
-	if (state->epsilon[thread_id] == NULL) {
+	if (state->packedEpsilon[thread_id] == NULL) {
+		err(227, __func__, "state->packedEpsilon[%ld] is NULL", thread_id);
+	}
+	if (state->byteEpsilon == true && state->epsilon[thread_id] == NULL) {
 		err(227, __func__, "state->epsilon[%ld] is NULL", thread_id);
 	}
+	if (xBitOffset < 0 || xBitOffset >= BITS_N_BYTE) {
+		err(227, __func__, "xBitOffset: %d must be >= 0 and < %d", xBitOffset, BITS_N_BYTE);
+	}
 
 	bitsNeeded = state->tp.n;
+	count = MIN(xBitLength, bitsNeeded - *bitsRead);
+	done = 0;
 
-	count = 0;
-	for (i = 0; i < (xBitLength + BITS_N_BYTE - 1) / BITS_N_BYTE; i++) {
-		mask = 0x80;
-		for (j = 0; j < 8; j++) {
-			if (*(x + i) & mask) {
-				bit = 1;
-				(*num_1s)++;
-			} else {
-				bit = 0;
-				(*num_0s)++;
-			}
-			mask >>= 1;
+	/*
+	 * When the packed bit stream is at a word boundary, convert whole words at a time, funnel shifting
+	 * the bytes when the bits do not start at a byte boundary, and count their 1 bits with popcount
+	 */
+	if (*bitsRead % BITS_N_WORD64 == 0) {
+		words = count / BITS_N_WORD64;
+		ones = packBytes(x, xBitOffset, words, state->packedEpsilon[thread_id] + *bitsRead / BITS_N_WORD64);
+		if (state->byteEpsilon == true && xBitOffset == 0) {
+			expandBytes(x, words * (BITS_N_WORD64 / BITS_N_BYTE), state->epsilon[thread_id] + *bitsRead);
+		} else if (state->byteEpsilon == true) {
+			unpackBits(state->packedEpsilon[thread_id], *bitsRead, words * BITS_N_WORD64,
+				   state->epsilon[thread_id] + *bitsRead);
+		}
+		done = words * BITS_N_WORD64;
+		*num_1s += ones;
+		*num_0s += done - ones;
+		*bitsRead += done;
+	}
+
+	/*
+	 * Convert any remaining bits one at a time
+	 */
+	for (i = done + xBitOffset; i < count + xBitOffset; i++) {
+		bit = (x[i / BITS_N_BYTE] >> (BITS_N_BYTE - 1 - i % BITS_N_BYTE)) & 1;
+		if (bit == 1) {
+			(*num_1s)++;
+		} else {
+			(*num_0s)++;
+		}
+		appendPackedBit(state->packedEpsilon[thread_id], *bitsRead, bit);
+		if (state->byteEpsilon == true) {
 			state->epsilon[thread_id][*bitsRead] = (BitSequence) bit;
-			(*bitsRead)++;
-			if (*bitsRead == bitsNeeded) {
-				return true;
-			}
-			if (++count == xBitLength) {
-				return false;
-			}
 		}
+		(*bitsRead)++;
 	}
 
-	return false;
+	return (*bitsRead == bitsNeeded) ? true : false;
 }
 
 
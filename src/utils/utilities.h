@@ -40,9 +40,11 @@ extern long int str2longint(bool * success_p, char *string);
 extern void generatorOptions(struct state *state);
 extern void chooseTests(struct state *state);
 extern void fixParameters(struct state *state);
-extern bool copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, long int xBitLength, long int *num_0s,
-			      long int *num_1s, long int *bitsRead);
+extern bool copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, int xBitOffset, long int xBitLength,
+			      long int *num_0s, long int *num_1s, long int *bitsRead);
 extern void invokeTestSuite(struct state *state);
+extern void finishIteration(struct thread_state *thread_state, long int iteration);
+extern long int iterationsLeft(struct state *state);
 extern void read_from_p_val_file(struct state *state);
 extern void write_p_val_to_file(struct state *state);
 extern void print_option_summary(struct state *state, char *where);